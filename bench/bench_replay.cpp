@@ -0,0 +1,246 @@
+/**
+ * @file bench_replay.cpp
+ * @brief scan strategies against recorded traces, on a simulated clock
+ *
+ * every trace (a `uidscan --trace` file) is scanned again with each
+ * strategy through a ReplayLink (see replay.h): probes, round trips and
+ * the time the scan would have taken on the recorded bus, without the
+ * bus. all of it is deterministic, so a golden file can hold the
+ * figures of the last accepted run and any strategy that needs more
+ * probes or more time than that fails the run:
+ *
+ *    bench_replay [--golden <file> [--update]] [--timeout <msec>]
+ *        <trace> ...
+ *
+ * the golden file has one line per trace and strategy, `<trace>
+ * <strategy> <probes> <us>` (the trace by its file name, without
+ * `.trace`); `--update` rewrites it from this run. `--timeout` is what
+ * a probe without answer costs where the trace has nothing to go by
+ * (default 20 ms, uidresp's scans are recorded with `-t 20`)
+ */
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bisectscan.h"
+#include "replay.h"
+#include "scanengine.h"
+#include "symbolplan.h"
+
+namespace {
+
+struct Strategy {
+    const char *name;
+    bool pipelined;
+    ScanEngine::Confirm confirm;
+    ScanEngine::CollisionHints hints;
+    bool learn;
+    bool bisect;
+};
+
+const Strategy STRATEGIES[] = {
+    {"serial", false, ScanEngine::Confirm::Echo,
+        ScanEngine::CollisionHints::None, false, false},
+    {"pipeline", true, ScanEngine::Confirm::Echo,
+        ScanEngine::CollisionHints::None, false, false},
+    {"deferred", true, ScanEngine::Confirm::Deferred,
+        ScanEngine::CollisionHints::None, false, false},
+    {"hints", true, ScanEngine::Confirm::Echo,
+        ScanEngine::CollisionHints::Mixed, false, false},
+    {"learn", true, ScanEngine::Confirm::Echo,
+        ScanEngine::CollisionHints::None, true, false},
+    {"bisect", false, ScanEngine::Confirm::Echo,
+        ScanEngine::CollisionHints::None, false, true},
+};
+
+struct Result {
+    size_t found = 0;
+    uint64_t probes = 0;
+    uint64_t trips = 0;
+    long us = 0;
+    size_t replayed = 0;
+};
+
+/**
+ * @brief one strategy over one recording
+ */
+Result run(const Recording &rec, const Strategy &s, long timeout_us)
+{
+    ReplayLink link(rec);
+    link.setPipelined(s.pipelined);
+    link.setTimeoutUs(timeout_us);
+    SymbolPlan plan;
+    plan.setLearning(s.learn);
+
+    std::set<std::string> found;
+    ScanEngine engine(link, found);
+    engine.setSymbolPlan(&plan);
+    engine.setConfirm(s.confirm);
+    engine.setCollisionHints(s.hints);
+    BisectScan bisect(link, found);
+    bisect.setSymbolPlan(&plan);
+    bisect.setConfirm(s.confirm);
+    link.resetAll();
+    for (const auto &pfx : rec.prefixes()) {
+        if (s.bisect)
+            bisect.scan(pfx);
+        else
+            engine.scan(pfx);
+    }
+    link.resetAll();
+
+    Result r;
+    r.found = found.size();
+    r.probes = link.probes();
+    r.trips = link.roundTrips();
+    r.us = link.elapsedUs();
+    r.replayed = link.replayed();
+    return r;
+}
+
+std::string trace_name(const std::string &path)
+{
+    std::string name = path.substr(path.rfind('/') + 1);
+    const std::string ext = ".trace";
+    if (name.size() > ext.size() &&
+        name.compare(name.size() - ext.size(), ext.size(), ext) == 0)
+        name.resize(name.size() - ext.size());
+    return name;
+}
+
+/**
+ * @brief golden figures by `<trace> <strategy>`, none if the file does
+ *        not exist
+ */
+std::map<std::string, Result> read_golden(const std::string &path)
+{
+    std::map<std::string, Result> golden;
+    std::ifstream in(path);
+    for (std::string line; std::getline(in, line);) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream fields(line);
+        std::string trace, strategy;
+        Result r;
+        if (fields >> trace >> strategy >> r.probes >> r.us)
+            golden[trace + " " + strategy] = r;
+    }
+    return golden;
+}
+
+void usage(const char *progname)
+{
+    std::cerr << "Usage: " << progname
+        << " [--golden <file> [--update]] [--timeout <msec>]"
+        << " <trace> ...\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const struct option long_opts[] = {
+        {"golden", required_argument, nullptr, 'g'},
+        {"update", no_argument, nullptr, 'u'},
+        {"timeout", required_argument, nullptr, 't'},
+        {nullptr, 0, nullptr, 0}
+    };
+
+    std::string golden_path;
+    bool update = false;
+    long timeout_ms = 20;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "g:ut:", long_opts,
+        nullptr)) != -1) {
+        switch (opt) {
+        case 'g':
+            golden_path = optarg;
+            break;
+        case 'u':
+            update = true;
+            break;
+        case 't':
+            timeout_ms = std::atol(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind >= argc || (update && golden_path.empty())) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const std::map<std::string, Result> golden = golden_path.empty()
+        ? std::map<std::string, Result>() : read_golden(golden_path);
+    std::ostringstream out; // the new golden file
+    out << "# trace strategy probes us, see bench_replay.cpp\n";
+    bool failed = false;
+
+    std::cout << std::left << std::setw(16) << "trace" << std::setw(10)
+        << "strategy" << std::right << std::setw(7) << "found"
+        << std::setw(9) << "probes" << std::setw(8) << "trips"
+        << std::setw(12) << "sim ms" << std::setw(10) << "replayed"
+        << "\n";
+    for (int i = optind; i < argc; ++i) {
+        Recording rec;
+        if (!rec.load(argv[i])) {
+            std::cerr << "Can't read trace " << argv[i] << ": "
+                << std::strerror(errno) << std::endl;
+            return 1;
+        }
+        const std::string name = trace_name(argv[i]);
+        for (const Strategy &s : STRATEGIES) {
+            const Result r = run(rec, s, timeout_ms * 1000);
+            std::cout << std::left << std::setw(16) << name
+                << std::setw(10) << s.name << std::right << std::setw(7)
+                << r.found << std::setw(9) << r.probes << std::setw(8)
+                << r.trips << std::setw(12) << std::fixed
+                << std::setprecision(1) << r.us / 1000.0 << std::setw(9)
+                << 100 * r.replayed / std::max<size_t>(1,
+                    rec.exchanges().size()) << "%\n";
+            out << name << " " << s.name << " " << r.probes << " "
+                << r.us << "\n";
+
+            const std::string key = name + " " + s.name;
+            if (r.found != rec.uids().size()) {
+                std::cerr << key << ": found " << r.found << " of "
+                    << rec.uids().size() << " uids\n";
+                failed = true;
+            }
+            auto g = golden.find(key);
+            if (update || g == golden.end())
+                continue;
+            if (r.probes > g->second.probes || r.us > g->second.us) {
+                std::cerr << key << ": regression, " << r.probes
+                    << " probes and " << r.us << " us, golden "
+                    << g->second.probes << " and " << g->second.us
+                    << "\n";
+                failed = true;
+            }
+        }
+    }
+
+    if (update) {
+        std::ofstream file(golden_path);
+        file << out.str();
+        if (!file) {
+            std::cerr << "Can't write " << golden_path << std::endl;
+            return 1;
+        }
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,89 @@
+#include <benchmark/benchmark.h>
+#include <random>
+#include "population.h"
+#include "scanengine.h"
+#include "uidbus.h"
+
+namespace {
+
+// counts the traffic between the engine and an in-process responder
+class CountingLink : public ScanLink {
+public:
+    explicit CountingLink(ScanLink &link, bool pipelined) :
+        link_(link),
+        pipelined_(pipelined)
+    {
+    }
+
+    std::string probe(const std::string &pattern) override
+    {
+        ++probes;
+        ++roundTrips;
+        return link_.probe(pattern);
+    }
+
+    std::vector<std::string> probeWindow(
+        const std::vector<std::string> &patterns) override
+    {
+        ++roundTrips;
+        probes += patterns.size();
+        std::vector<std::string> resp;
+        for (const auto &p : patterns)
+            resp.push_back(link_.probe(p));
+        return resp;
+    }
+
+    bool pipelined() const override { return pipelined_; }
+
+    std::string assign(const std::string &uid) override
+    {
+        ++roundTrips;
+        return link_.assign(uid);
+    }
+
+    void resetAll() override { link_.resetAll(); }
+
+    size_t probes = 0;
+    size_t roundTrips = 0;
+
+private:
+    ScanLink &link_;
+    bool pipelined_;
+};
+
+} // namespace
+
+// full discovery of range(0) UIDs on two vendor prefixes; range(1)
+// selects the pipelined walk
+static void BM_Scan(benchmark::State &state)
+{
+    const std::vector<std::string> prefixes = {"CB", "HS"};
+    const auto uids = random_population(state.range(0), prefixes);
+    UidBus bus(uids);
+    bus.setLog(nullptr);
+    SimLink sim(bus);
+    CountingLink link(sim, state.range(1) != 0);
+    size_t found = 0;
+    for (auto _ : state) {
+        link.resetAll();
+        std::set<std::string> seen;
+        ScanEngine engine(link, seen);
+        for (const auto &pfx : prefixes)
+            engine.scan(pfx);
+        if (seen.size() != uids.size()) {
+            state.SkipWithError("not all uids found");
+            break;
+        }
+        found += seen.size();
+    }
+
+    using benchmark::Counter;
+    const double uidsFound = found ? static_cast<double>(found) : 1.0;
+    state.counters["probes/s"] =
+        Counter(static_cast<double>(link.probes), Counter::kIsRate);
+    state.counters["probes/uid"] = link.probes / uidsFound;
+    state.counters["trips/uid"] = link.roundTrips / uidsFound;
+}
+BENCHMARK(BM_Scan)
+    ->ArgsProduct({{10, 100, 1000, 10000}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,319 @@
+/**
+ * @file bench_stress.cpp
+ * @brief scaling stress test of the scan engine on synthetic buses
+ *
+ * scans populations of every shape in the table below (see
+ * PopulationGenerator) at 1k, 10k and 100k devices on an in-process
+ * bus and fails if
+ *
+ * - a uid is not found (or one is found that is not there)
+ * - the probes exceed the tree bound: every collided node of the
+ *   population's suffix tree probed with all 64 symbols, plus the
+ *   prefix itself. the walk stops a node early once its devices are
+ *   found, so it stays well below
+ * - the probes per uid exceed the ceiling of the shape, about 25% above
+ *   what the engine needs today
+ * - the probes grow faster than the population: more than 15 times as
+ *   many for 10 times the devices (small populations vary, a walk
+ *   gone quadratic does not)
+ *
+ *    bench_stress [--sizes <n,...>] [--seed <n>]
+ *    bench_stress --generate <n> [--shape <list>] [--vendors <pfx,...>]
+ *        [--seed <n>]
+ *
+ * `--generate` only writes a population to stdout, one uid per line,
+ * e.g. for `uidresp -f` or `uidscan --simulate-file`
+ */
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "popgen.h"
+#include "scanengine.h"
+#include "uidbus.h"
+
+namespace {
+
+struct Workload {
+    const char *name;
+    const char *shape; // PopulationGenerator::parse()
+    double ceiling;    // probes per uid
+};
+
+const Workload WORKLOADS[] = {
+    {"random", "", 13},
+    {"runs", "runs=0.9", 7},
+    {"suffixes", "suffixes=0.9,suffix-length=10", 20},
+    {"clusters", "clusters=0.1", 40},
+    {"head", "head=10", 13},
+    {"mixed", "runs=0.3,suffixes=0.3,clusters=0.02,head=4", 18},
+};
+
+const std::vector<std::string> VENDORS = {"AB", "CB", "ZL"};
+
+// counts what goes over the link
+class CountingLink : public ScanLink {
+public:
+    explicit CountingLink(ScanLink &link) : link_(link) {}
+
+    std::string probe(const std::string &pattern) override
+    {
+        ++probes;
+        return link_.probe(pattern);
+    }
+
+    std::string assign(const std::string &uid) override
+    {
+        return link_.assign(uid);
+    }
+
+    void resetAll() override { link_.resetAll(); }
+
+    size_t probes = 0;
+
+private:
+    ScanLink &link_;
+};
+
+/**
+ * @brief probes a walk that never stops a node early would send: one
+ *        per prefix plus 64 per node matching two uids or more
+ */
+size_t tree_bound(const std::vector<std::string> &uids)
+{
+    size_t bound = 0;
+    for (const auto &pfx : VENDORS) {
+        // the serial numbers reversed, the walk's view
+        std::vector<std::string> keys;
+        for (const auto &uid : uids) {
+            if (uid.compare(0, pfx.size(), pfx) == 0)
+                keys.emplace_back(uid.rbegin(),
+                    uid.rend() - static_cast<long>(pfx.size()));
+        }
+        if (keys.empty())
+            continue;
+        std::sort(keys.begin(), keys.end());
+        // common prefix of neighbours: a node of depth d collides once
+        // per run of neighbours sharing d characters
+        std::vector<size_t> lcp(keys.size(), 0);
+        for (size_t i = 1; i < keys.size(); ++i) {
+            const auto &a = keys[i - 1];
+            const auto &b = keys[i];
+            while (lcp[i] < a.size() && a[lcp[i]] == b[lcp[i]])
+                ++lcp[i];
+        }
+        ++bound;
+        for (size_t d = 0; d < static_cast<size_t>(MAXLEN); ++d) {
+            for (size_t i = 1; i < keys.size(); ++i) {
+                if (lcp[i] >= d && (i == 1 || lcp[i - 1] < d))
+                    bound += CHARSET.size();
+            }
+        }
+    }
+    return bound;
+}
+
+struct Result {
+    bool shaped = false; // the workload's shape parsed
+    size_t uids = 0;
+    bool recall = false;
+    size_t probes = 0;
+    size_t bound = 0;
+    double seconds = 0;
+};
+
+Result run(const Workload &w, size_t n, unsigned seed)
+{
+    Result r;
+    PopulationGenerator gen(VENDORS, seed);
+    r.shaped = gen.parse(w.shape);
+    if (!r.shaped)
+        return r;
+    const std::vector<std::string> uids = gen.generate(n);
+
+    UidBus bus(uids);
+    bus.setLog(nullptr);
+    SimLink sim(bus);
+    CountingLink link(sim);
+    std::set<std::string> found;
+    ScanEngine engine(link, found);
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto &pfx : VENDORS)
+        engine.scan(pfx);
+
+    r.seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    r.uids = uids.size();
+    r.recall = found == std::set<std::string>(uids.begin(), uids.end());
+    r.probes = link.probes;
+    r.bound = tree_bound(uids);
+    return r;
+}
+
+bool parse_sizes(const std::string &list, std::vector<size_t> &out)
+{
+    out.clear();
+    size_t at = 0;
+    while (at <= list.size()) {
+        size_t end = list.find(',', at);
+        if (end == std::string::npos)
+            end = list.size();
+        const long n = std::atol(list.substr(at, end - at).c_str());
+        if (n <= 0)
+            return false;
+        out.push_back(static_cast<size_t>(n));
+        at = end + 1;
+    }
+    return true;
+}
+
+int stress(const std::vector<size_t> &sizes, unsigned seed)
+{
+    bool failed = false;
+    std::cout << std::left << std::setw(10) << "shape" << std::right
+        << std::setw(8) << "uids" << std::setw(10) << "probes"
+        << std::setw(10) << "per uid" << std::setw(10) << "ceiling"
+        << std::setw(10) << "bound" << std::setw(10) << "seconds"
+        << "\n";
+    for (const Workload &w : WORKLOADS) {
+        size_t last_uids = 0;
+        size_t last_probes = 0;
+        for (size_t n : sizes) {
+            const Result r = run(w, n, seed);
+            if (!r.shaped) {
+                std::cerr << w.name << ": invalid shape " << w.shape
+                    << "\n";
+                failed = true;
+                break;
+            }
+            const double per_uid = double(r.probes) / double(r.uids);
+            std::cout << std::left << std::setw(10) << w.name
+                << std::right << std::setw(8) << r.uids << std::setw(10)
+                << r.probes << std::setw(10) << std::fixed
+                << std::setprecision(2) << per_uid << std::setw(10)
+                << w.ceiling << std::setw(10) << r.bound
+                << std::setw(10) << std::setprecision(3) << r.seconds
+                << "\n";
+
+            const std::string what = std::string(w.name) + " " +
+                std::to_string(r.uids) + ": ";
+            if (!r.recall) {
+                std::cerr << what << "found set differs\n";
+                failed = true;
+            }
+            if (r.probes > r.bound) {
+                std::cerr << what << r.probes << " probes, above the "
+                    << "tree bound " << r.bound << "\n";
+                failed = true;
+            }
+            if (per_uid > w.ceiling) {
+                std::cerr << what << per_uid << " probes per uid, "
+                    << "ceiling " << w.ceiling << "\n";
+                failed = true;
+            }
+            // growth against the last size
+            if (last_probes && r.uids > last_uids) {
+                const double grown = double(r.probes) / last_probes;
+                const double scale = double(r.uids) / last_uids;
+                if (grown > 1.5 * scale) {
+                    std::cerr << what << "probes grew " << grown
+                        << " times for " << scale << " times the uids\n";
+                    failed = true;
+                }
+            }
+            last_uids = r.uids;
+            last_probes = r.probes;
+        }
+    }
+    return failed ? 1 : 0;
+}
+
+void usage(const char *progname)
+{
+    std::cerr << "Usage: " << progname
+        << " [--sizes <n,...>] [--seed <n>]\n"
+        << "       " << progname
+        << " --generate <n> [--shape <list>] [--vendors <pfx,...>]"
+        << " [--seed <n>]\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const struct option long_opts[] = {
+        {"sizes", required_argument, nullptr, 'n'},
+        {"seed", required_argument, nullptr, 's'},
+        {"generate", required_argument, nullptr, 'g'},
+        {"shape", required_argument, nullptr, 'p'},
+        {"vendors", required_argument, nullptr, 'V'},
+        {nullptr, 0, nullptr, 0}
+    };
+
+    std::vector<size_t> sizes = {1000, 10000, 100000};
+    unsigned seed = 1;
+    long generate = -1;
+    std::string shape;
+    std::vector<std::string> vendors = VENDORS;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", long_opts, nullptr)) != -1) {
+        switch (opt) {
+        case 'n':
+            if (!parse_sizes(optarg, sizes)) {
+                std::cerr << "Invalid sizes: " << optarg << std::endl;
+                return 1;
+            }
+            break;
+        case 's':
+            seed = static_cast<unsigned>(std::atol(optarg));
+            break;
+        case 'g':
+            generate = std::atol(optarg);
+            break;
+        case 'p':
+            shape = optarg;
+            break;
+        case 'V': {
+            vendors.clear();
+            const std::string list = optarg;
+            for (size_t at = 0; at < list.size(); at += 3) {
+                vendors.push_back(list.substr(at, 3));
+                if (vendors.back().back() == ',')
+                    vendors.back().pop_back();
+                if (vendors.back().size() != AisgUid::PREFIX) {
+                    std::cerr << "Invalid vendors: " << list << std::endl;
+                    return 1;
+                }
+            }
+            break;
+        }
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (generate >= 0) {
+        PopulationGenerator gen(vendors, seed);
+        if (!gen.parse(shape)) {
+            std::cerr << "Invalid shape: " << shape << std::endl;
+            return 1;
+        }
+        for (const auto &uid : gen.generate(static_cast<size_t>(generate)))
+            std::cout << uid << "\n";
+        return 0;
+    }
+    return stress(sizes, seed);
+}
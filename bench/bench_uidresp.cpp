@@ -0,0 +1,109 @@
+#include <benchmark/benchmark.h>
+#include <random>
+#include "batchmatch.h"
+#include "population.h"
+#include "uidindex.h"
+#include "uidresp.h"
+
+namespace {
+
+// patterns the way a scan sends them: prefix and a short tail
+std::vector<std::string> patterns(const std::vector<std::string> &uids)
+{
+    std::mt19937 rng(2);
+    std::vector<std::string> out;
+    for (size_t i = 0; i < 256; ++i) {
+        const std::string &uid = uids[rng() % uids.size()];
+        size_t tail = 1 + i % 3;
+        out.push_back(uid.substr(0, 2) + uid.substr(uid.size() - tail));
+    }
+    return out;
+}
+
+} // namespace
+
+// linear scan over the population, what uidresp did per input line
+static void BM_Matches(benchmark::State &state)
+{
+    const auto uids = random_population(state.range(0));
+    const auto pats = patterns(uids);
+    size_t i = 0;
+    for (auto _ : state) {
+        const std::string &p = pats[i++ % pats.size()];
+        size_t hits = 0;
+        for (const auto &uid : uids)
+            hits += UidResponder::matches(p, uid);
+        benchmark::DoNotOptimize(hits);
+    }
+    state.SetItemsProcessed(state.iterations() * uids.size());
+}
+BENCHMARK(BM_Matches)->RangeMultiplier(10)->Range(10, 100000);
+
+static void BM_IndexMatch(benchmark::State &state)
+{
+    const auto uids = random_population(state.range(0));
+    const auto pats = patterns(uids);
+    UidIndex index(uids);
+    size_t i = 0;
+    for (auto _ : state) {
+        size_t hits = 0;
+        index.forEachMatch(pats[i++ % pats.size()],
+            [&](size_t) { ++hits; });
+        benchmark::DoNotOptimize(hits);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_IndexMatch)->RangeMultiplier(10)->Range(10, 100000);
+
+// the same query as a SIMD pass over the population; range(1) is the
+// BatchMatcher::Isa
+static void BM_BatchMatch(benchmark::State &state)
+{
+    const auto isa = static_cast<BatchMatcher::Isa>(state.range(1));
+    const auto uids = random_population(state.range(0));
+    const auto pats = patterns(uids);
+    BatchMatcher batch(uids);
+    if (!batch.setIsa(isa)) {
+        state.SkipWithError("not supported here");
+        return;
+    }
+    state.SetLabel(BatchMatcher::name(isa));
+    size_t i = 0;
+    for (auto _ : state) {
+        BatchMatcher::Result r = batch.match(pats[i++ % pats.size()]);
+        benchmark::DoNotOptimize(r);
+    }
+    state.SetItemsProcessed(state.iterations() * uids.size());
+}
+BENCHMARK(BM_BatchMatch)
+    ->ArgsProduct({benchmark::CreateRange(10, 100000, 10),
+        {static_cast<long>(BatchMatcher::Isa::Scalar),
+            static_cast<long>(BatchMatcher::Isa::Sse2),
+            static_cast<long>(BatchMatcher::Isa::Avx2),
+            static_cast<long>(BatchMatcher::Isa::Neon)}});
+
+static void BM_GenerateCollision(benchmark::State &state)
+{
+    const auto uids = random_population(state.range(0));
+    std::mt19937 rng(1);
+    std::string out;
+    for (auto _ : state) {
+        UidResponder::generateCollision(uids, rng, out);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * uids.size());
+}
+BENCHMARK(BM_GenerateCollision)->RangeMultiplier(10)->Range(10, 100000);
+
+static void BM_RandomizeFromFifthChar(benchmark::State &state)
+{
+    std::mt19937 rng(1);
+    const std::string uid = random_population(1)[0];
+    std::string s;
+    for (auto _ : state) {
+        s = uid;
+        UidResponder::randomizeFromFifthChar(s, rng);
+        benchmark::DoNotOptimize(s.data());
+    }
+}
+BENCHMARK(BM_RandomizeFromFifthChar);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "scanengine.h"
+
+/**
+ * @brief `n` distinct random UIDs, spread over `prefixes`; the same
+ *        seed gives the same population
+ */
+inline std::vector<std::string> random_population(size_t n,
+    const std::vector<std::string> &prefixes = {"CB"}, unsigned seed = 1)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<size_t> sym(0, CHARSET.size() - 1);
+    std::set<std::string> seen;
+    std::vector<std::string> uids;
+    while (uids.size() < n) {
+        std::string uid = prefixes[uids.size() % prefixes.size()];
+        for (int i = 0; i < MAXLEN; ++i)
+            uid.push_back(CHARSET[sym(rng)]);
+        if (seen.insert(uid).second)
+            uids.push_back(uid);
+    }
+    return uids;
+}
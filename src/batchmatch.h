@@ -0,0 +1,369 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BATCHMATCH_X86 1
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define BATCHMATCH_NEON 1
+#endif
+
+#include "uidarena.h"
+#include "uidformat.h"
+#include "uidresp.h"
+
+/**
+ * @class BatchMatcher
+ * @brief Matches one pattern against a whole UID population with SIMD
+ *        compares, 16 or 32 UIDs per instruction.
+ *
+ * UIDs of the AISG length (WIDTH, see AisgUid) are stored column by
+ * column in 32-byte aligned blocks of 32 UIDs each: column `c` of a
+ * block holds character `c` of its 32 UIDs. A pattern fixes a few
+ * columns (the two prefix characters and the last ones), so matching a
+ * block is one compare per fixed column against the broadcast pattern
+ * character, ANDed into a 32-bit lane mask. UIDs of any other length
+ * are checked with UidResponder::matches, so the result is always the
+ * one of the reference matcher.
+ *
+ * The instruction set is chosen at run time (best(), setIsa()): AVX2 or
+ * SSE2 on x86, NEON on AArch64, a portable scalar loop everywhere.
+ *
+ * Matching can exclude muted UIDs: `muted` points to a bitset with one
+ * bit per ordinal (UidIndex layout), a set bit hides the UID.
+ */
+class BatchMatcher {
+public:
+    enum class Isa { Scalar, Sse2, Avx2, Neon };
+
+    /**
+     * @brief count of matching UIDs and the smallest matching ordinal
+     */
+    struct Result {
+        size_t count = 0;
+        size_t first = 0; // valid if count > 0
+    };
+
+    static constexpr size_t WIDTH = AisgUid::LENGTH;
+    static constexpr size_t LANES = 32;
+
+    /**
+     * @param uids Population; ordinals are positions in it.
+     */
+    explicit BatchMatcher(const std::vector<std::string> &uids) :
+        BatchMatcher(UidArena(uids))
+    {
+    }
+
+    explicit BatchMatcher(const UidArena &uids) :
+        size_(uids.size()),
+        blocks_((uids.size() + LANES - 1) / LANES),
+        valid_(blocks_.size(), 0)
+    {
+        for (size_t i = 0; i < uids.size(); ++i) {
+            if (uids[i].size() != WIDTH) {
+                odd_.push_back({i, std::string(uids[i])});
+                continue;
+            }
+            Block &b = blocks_[i / LANES];
+            for (size_t c = 0; c < WIDTH; ++c)
+                b.col[c][i % LANES] = static_cast<uint8_t>(uids[i][c]);
+            valid_[i / LANES] |= uint32_t(1) << (i % LANES);
+        }
+        setIsa(best());
+    }
+
+    /**
+     * @return true if this machine can run `isa`
+     */
+    static bool supported(Isa isa)
+    {
+        switch (isa) {
+        case Isa::Scalar:
+            return true;
+#ifdef BATCHMATCH_X86
+        case Isa::Sse2:
+            return __builtin_cpu_supports("sse2");
+        case Isa::Avx2:
+            return __builtin_cpu_supports("avx2");
+#endif
+#ifdef BATCHMATCH_NEON
+        case Isa::Neon:
+            return true;
+#endif
+        default:
+            return false;
+        }
+    }
+
+    /**
+     * @return widest instruction set supported here
+     */
+    static Isa best()
+    {
+        for (Isa isa : {Isa::Avx2, Isa::Neon, Isa::Sse2}) {
+            if (supported(isa))
+                return isa;
+        }
+        return Isa::Scalar;
+    }
+
+    static const char *name(Isa isa)
+    {
+        switch (isa) {
+        case Isa::Sse2:
+            return "sse2";
+        case Isa::Avx2:
+            return "avx2";
+        case Isa::Neon:
+            return "neon";
+        default:
+            return "scalar";
+        }
+    }
+
+    /**
+     * @brief Parses `scalar`, `sse2`, `avx2`, `neon` or `auto` (best()).
+     */
+    static bool parseIsa(const std::string &s, Isa &out)
+    {
+        if (s == "auto") {
+            out = best();
+            return true;
+        }
+        for (Isa isa : {Isa::Scalar, Isa::Sse2, Isa::Avx2, Isa::Neon}) {
+            if (s == name(isa)) {
+                out = isa;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @return false (and nothing changes) if `isa` is not supported
+     */
+    bool setIsa(Isa isa)
+    {
+        if (!supported(isa))
+            return false;
+        isa_ = isa;
+        switch (isa) {
+#ifdef BATCHMATCH_X86
+        case Isa::Sse2:
+            kernel_ = &maskSse2;
+            break;
+        case Isa::Avx2:
+            kernel_ = &maskAvx2;
+            break;
+#endif
+#ifdef BATCHMATCH_NEON
+        case Isa::Neon:
+            kernel_ = &maskNeon;
+            break;
+#endif
+        default:
+            kernel_ = &maskScalar;
+            break;
+        }
+        return true;
+    }
+
+    Isa isa() const { return isa_; }
+
+    size_t size() const { return size_; }
+
+    /**
+     * @brief Counts the active UIDs matching `input`, stopping once
+     *        `limit` are found.
+     *
+     * @return the count, exact below `limit` and at least `limit`
+     *         otherwise, and the smallest matching ordinal
+     */
+    Result match(std::string_view input, const uint64_t *muted = nullptr,
+        size_t limit = SIZE_MAX) const
+    {
+        Result r;
+        Query q(input);
+        for (size_t b = 0; b < blocks_.size() && r.count < limit; ++b) {
+            uint32_t m = blockMask(b, q, input, muted);
+            if (m == 0)
+                continue;
+            if (r.count == 0)
+                r.first = b * LANES + static_cast<size_t>(
+                    __builtin_ctz(m));
+            r.count += static_cast<size_t>(__builtin_popcount(m));
+        }
+        return r;
+    }
+
+    /**
+     * @brief Calls `fn(ordinal)` for every active UID matching `input`,
+     *        in ordinal order.
+     */
+    template <typename Fn>
+    void forEachMatch(std::string_view input, const uint64_t *muted,
+        Fn &&fn) const
+    {
+        Query q(input);
+        for (size_t b = 0; b < blocks_.size(); ++b) {
+            for (uint32_t m = blockMask(b, q, input, muted); m != 0;
+                 m &= m - 1)
+                fn(b * LANES + static_cast<size_t>(__builtin_ctz(m)));
+        }
+    }
+
+private:
+    struct alignas(32) Block {
+        uint8_t col[WIDTH][LANES] = {};
+    };
+
+    /**
+     * columns a pattern fixes and the characters expected there
+     */
+    struct Query {
+        explicit Query(std::string_view input)
+        {
+            const size_t len = input.size();
+            if (len == 0 || len > WIDTH)
+                return; // no fixed-width UID can match
+            size_t left = std::min<size_t>(AisgUid::PREFIX, len);
+            for (size_t i = 0; i < left; ++i)
+                add(i, input[i]);
+            for (size_t i = left; i < len; ++i)
+                add(WIDTH - len + i, input[i]);
+            possible = true;
+        }
+
+        void add(size_t c, char ch)
+        {
+            cols[n] = static_cast<uint8_t>(c);
+            chars[n] = static_cast<uint8_t>(ch);
+            ++n;
+        }
+
+        bool possible = false;
+        size_t n = 0;
+        uint8_t cols[WIDTH];
+        uint8_t chars[WIDTH];
+    };
+
+    using Kernel = uint32_t (*)(const Block &, const Query &, uint32_t);
+
+    /**
+     * lanes of block `b` that match and are active
+     */
+    uint32_t blockMask(size_t b, const Query &q, std::string_view input,
+        const uint64_t *muted) const
+    {
+        uint32_t active = ~uint32_t(0);
+        if (muted)
+            active = ~static_cast<uint32_t>(
+                muted[b / 2] >> (b % 2 * LANES));
+        if (b == blocks_.size() - 1 && size_ % LANES)
+            active &= (uint32_t(1) << (size_ % LANES)) - 1;
+
+        uint32_t m = active & valid_[b];
+        m = (m && q.possible) ? kernel_(blocks_[b], q, m) : 0;
+
+        // the few UIDs that don't fit a slot
+        if (!odd_.empty() && (active & ~valid_[b])) {
+            auto it = std::lower_bound(odd_.begin(), odd_.end(), b * LANES,
+                [](const Odd &o, size_t i) { return o.ordinal < i; });
+            for (; it != odd_.end() && it->ordinal < (b + 1) * LANES;
+                 ++it) {
+                uint32_t bit = uint32_t(1) << (it->ordinal % LANES);
+                if ((active & bit) &&
+                    UidResponder::matches(input, it->uid))
+                    m |= bit;
+            }
+        }
+        return m;
+    }
+
+    static uint32_t maskScalar(const Block &blk, const Query &q,
+        uint32_t m)
+    {
+        for (size_t k = 0; k < q.n && m; ++k) {
+            const uint8_t *col = blk.col[q.cols[k]];
+            uint32_t eq = 0;
+            for (size_t i = 0; i < LANES; ++i)
+                eq |= uint32_t(col[i] == q.chars[k]) << i;
+            m &= eq;
+        }
+        return m;
+    }
+
+#ifdef BATCHMATCH_X86
+    __attribute__((target("sse2")))
+    static uint32_t maskSse2(const Block &blk, const Query &q, uint32_t m)
+    {
+        for (size_t k = 0; k < q.n && m; ++k) {
+            const __m128i *col =
+                reinterpret_cast<const __m128i *>(blk.col[q.cols[k]]);
+            __m128i ch = _mm_set1_epi8(static_cast<char>(q.chars[k]));
+            uint32_t lo = static_cast<uint32_t>(_mm_movemask_epi8(
+                _mm_cmpeq_epi8(_mm_load_si128(col), ch)));
+            uint32_t hi = static_cast<uint32_t>(_mm_movemask_epi8(
+                _mm_cmpeq_epi8(_mm_load_si128(col + 1), ch)));
+            m &= lo | (hi << 16);
+        }
+        return m;
+    }
+
+    __attribute__((target("avx2")))
+    static uint32_t maskAvx2(const Block &blk, const Query &q, uint32_t m)
+    {
+        for (size_t k = 0; k < q.n && m; ++k) {
+            const __m256i *col =
+                reinterpret_cast<const __m256i *>(blk.col[q.cols[k]]);
+            __m256i ch = _mm256_set1_epi8(static_cast<char>(q.chars[k]));
+            m &= static_cast<uint32_t>(_mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(_mm256_load_si256(col), ch)));
+        }
+        return m;
+    }
+#endif
+
+#ifdef BATCHMATCH_NEON
+    static uint32_t maskNeon(const Block &blk, const Query &q, uint32_t m)
+    {
+        static const uint8_t weights[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+            1, 2, 4, 8, 16, 32, 64, 128};
+        const uint8x16_t w = vld1q_u8(weights);
+        for (size_t k = 0; k < q.n && m; ++k) {
+            const uint8_t *col = blk.col[q.cols[k]];
+            uint8x16_t ch = vdupq_n_u8(q.chars[k]);
+            uint32_t eq = 0;
+            for (size_t h = 0; h < 2; ++h) {
+                uint8x16_t bits = vandq_u8(
+                    vceqq_u8(vld1q_u8(col + 16 * h), ch), w);
+                uint32_t lo = vaddv_u8(vget_low_u8(bits));
+                uint32_t hi = vaddv_u8(vget_high_u8(bits));
+                eq |= (lo | (hi << 8)) << (16 * h);
+            }
+            m &= eq;
+        }
+        return m;
+    }
+#endif
+
+    struct Odd {
+        size_t ordinal;
+        std::string uid;
+    };
+
+    size_t size_;
+    std::vector<Block> blocks_;
+    std::vector<uint32_t> valid_; // lanes holding a WIDTH-long UID
+    std::vector<Odd> odd_;        // all other UIDs, by ordinal
+    Isa isa_ = Isa::Scalar;
+    Kernel kernel_ = &maskScalar;
+};
@@ -0,0 +1,283 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "charclass.h"
+#include "scanengine.h"
+#include "symbolplan.h"
+#include "uidformat.h"
+
+/**
+ * @class BisectScan
+ * @brief The uidscan tree walk with character classes: the symbols of
+ *        a level are halved instead of tried one by one.
+ *
+ * ScanEngine probes every symbol below a collided node, so a node with
+ * a single branch costs up to 64 probes, nearly all of them timeouts.
+ * Here the node is probed with a class (see CharClass) of half of its
+ * symbols, then the other half; a half that collides is halved again,
+ * down to single symbols, which are the collided nodes of the next
+ * level. A half without answer says the other one holds the collision,
+ * so it is split without a probe of its own; a half answering with a
+ * UID is one device, confirmed and done. A level with one branch costs
+ * 6 to 12 probes (for 64 symbols) and at most 6 timeouts instead of up
+ * to 63, one with k branches about 2k log(64/k); only a level with
+ * nearly every branch taken costs more probes than the linear walk (up
+ * to 126 instead of 64, but all of them answered).
+ *
+ * The walk is recursive and serial: each probe depends on the last. A
+ * responder that does not know classes matches nothing with them;
+ * then, seen at the first class probe below the prefix, the prefix is
+ * scanned by a ScanEngine instead (classesKnown() tells).
+ *
+ * Confirmations go the ScanEngine::Confirm way. A UID retracted (not
+ * echoed, see ScanEngine::Confirm::Deferred) was a collision of the
+ * symbols it answered for; they are split once the walk is through.
+ */
+class BisectScan {
+public:
+    using Confirm = ScanEngine::Confirm;
+
+    /**
+     * @param link  Bus to scan.
+     * @param found Set that receives confirmed UIDs.
+     */
+    BisectScan(ScanLink &link, std::set<std::string> &found) :
+        link_(link),
+        found_(found)
+    {
+    }
+
+    void setObserver(ScanObserver *observer) { observer_ = observer; }
+
+    /**
+     * @brief Takes the symbols of every level from `plan` (their order
+     *        does not matter here) and teaches it every UID found.
+     */
+    void setSymbolPlan(SymbolPlan *plan) { plan_ = plan; }
+
+    void setConfirm(Confirm confirm) { confirm_ = confirm; }
+
+    /**
+     * @brief See ScanEngine::setDepthLimit().
+     */
+    void setDepthLimit(size_t depth)
+    {
+        depthLimit_ = std::min<size_t>(depth, MAXLEN);
+    }
+
+    /**
+     * @return false if the last prefix scanned had to do without
+     *         classes
+     */
+    bool classesKnown() const { return classesKnown_; }
+
+    /**
+     * @brief Scans one vendor prefix completely.
+     */
+    void scan(const std::string &pfx)
+    {
+        pfx_ = pfx;
+        for (size_t len = 0; len < symbols_.size(); ++len) {
+            symbols_[len] = plan_ ? plan_->symbols(pfx, len)
+                                  : std::string(CHARSET);
+            std::sort(symbols_[len].begin(), symbols_[len].end());
+        }
+
+        classesKnown_ = true;
+        node_.clear();
+        const std::string resp = link_.probe(pfx_);
+        if (!resp.empty() && !take(resp, pfx_, ""))
+            collided();
+        while (classesKnown_ && settle()) {
+            // walk below what the retracted uids answered for
+            while (!revisit_.empty() && classesKnown_) {
+                const Taken t = revisit_.back();
+                revisit_.pop_back();
+                node_ = t.node;
+                if (t.symbols.empty())
+                    collided();
+                else
+                    part(t.symbols, true);
+            }
+        }
+        taken_.clear();
+        revisit_.clear();
+        if (!classesKnown_) {
+            ScanEngine engine(link_, found_);
+            engine.setObserver(observer_);
+            engine.setSymbolPlan(plan_);
+            engine.setConfirm(confirm_);
+            engine.setDepthLimit(depthLimit_);
+            engine.scan(pfx);
+        }
+    }
+
+private:
+    /**
+     * what a set of symbols below the node held
+     */
+    enum class Held { None, One, Several };
+
+    /**
+     * a uid not confirmed on the spot: the node and symbols it
+     * answered for, none for the prefix alone
+     */
+    struct Taken {
+        std::string node;
+        std::string symbols;
+    };
+
+    /**
+     * walks below the prefix, which collided
+     */
+    void collided()
+    {
+        if (observer_)
+            observer_->collision(pfx_, 0);
+        // so must all of its symbols as a class
+        if (part(symbols_[0], false) == Held::None)
+            classesKnown_ = false;
+    }
+
+    /**
+     * probes the symbols `s` below node_ (unless `known` to collide)
+     * and walks what answers
+     */
+    Held part(const std::string &s, bool known)
+    {
+        if (!known) {
+            probe(s);
+            const std::string resp = link_.probe(wire_);
+            if (!taken_.empty())
+                retract(link_.settle(false));
+            if (resp.empty())
+                return Held::None;
+            if (take(resp, wire_, s))
+                return Held::One;
+            if (observer_)
+                observer_->collision(wire_, node_.size() + 1);
+        }
+        if (s.size() == 1) {
+            descend(s[0]);
+            return Held::Several;
+        }
+        const std::string a = s.substr(0, s.size() / 2);
+        const std::string b = s.substr(s.size() / 2);
+        part(b, part(a, false) == Held::None);
+        return Held::Several;
+    }
+
+    /**
+     * walks below the collided node node_ + `sym`
+     */
+    void descend(char sym)
+    {
+        node_.push_back(sym);
+        if (node_.size() >= depthLimit_) {
+            if (observer_)
+                observer_->depthLimit(pfx_ + reverse_string(node_));
+        } else {
+            part(symbols_[node_.size()], true);
+        }
+        node_.pop_back();
+    }
+
+    /**
+     * the pattern for the symbols `s` right below node_, in wire_
+     */
+    void probe(const std::string &s)
+    {
+        wire_.assign(pfx_);
+        wire_.append(CharClass::format(s));
+        wire_.append(node_.rbegin(), node_.rend());
+    }
+
+    /**
+     * takes `resp` to `pattern` (for the symbols `s` below node_) for
+     * a UID, the way ScanEngine does
+     *
+     * @return false if it is a collision
+     */
+    bool take(const std::string &resp, const std::string &pattern,
+        const std::string &s)
+    {
+        if (resp == "!" || !AisgUid::isUid(resp) ||
+            !AisgUid::matches(pattern, resp) || found_.count(resp))
+            return false;
+        switch (confirm_) {
+        case Confirm::Echo:
+            if (link_.assign(resp) != resp)
+                return false;
+            break;
+        case Confirm::Crc:
+            if (!AisgUid::isChecked(resp))
+                return false;
+            link_.assignLater(resp);
+            break;
+        case Confirm::None:
+        case Confirm::Deferred:
+            link_.assignLater(resp);
+            break;
+        }
+        found_.insert(resp);
+        if (confirm_ == Confirm::Crc || confirm_ == Confirm::Deferred)
+            taken_[resp] = {node_, s};
+        if (plan_)
+            plan_->learn(resp);
+        if (observer_)
+            observer_->found(resp);
+        return true;
+    }
+
+    /**
+     * waits for the confirmations still open
+     *
+     * @return true if there is something to walk again
+     */
+    bool settle()
+    {
+        if (confirm_ != Confirm::Echo)
+            retract(link_.settle(true));
+        return !revisit_.empty();
+    }
+
+    /**
+     * forgets the uids of `failed` again, their symbols are walked
+     * later
+     */
+    void retract(const std::vector<std::string> &failed)
+    {
+        for (const auto &uid : failed) {
+            if (confirm_ == Confirm::None || !found_.erase(uid))
+                continue;
+            if (observer_)
+                observer_->retracted(uid);
+            auto it = taken_.find(uid);
+            if (it != taken_.end()) {
+                revisit_.push_back(it->second);
+                taken_.erase(it);
+            }
+        }
+    }
+
+    ScanLink &link_;
+    std::set<std::string> &found_;
+    ScanObserver *observer_ = nullptr;
+    SymbolPlan *plan_ = nullptr;
+    Confirm confirm_ = Confirm::Echo;
+    size_t depthLimit_ = MAXLEN;
+    bool classesKnown_ = true;
+
+    std::string pfx_;
+    std::string node_; // scan order, i.e. reversed on the wire
+    std::string wire_; // the class pattern probed last
+    std::map<std::string, Taken> taken_; // by uid
+    std::vector<Taken> revisit_;
+    std::array<std::string, MAXLEN + 1> symbols_; // per level, sorted
+};
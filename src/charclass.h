@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * @class CharClass
+ * @brief One pattern position: a character, or a character class.
+ *
+ * A class is written `[...]` and takes the place of one character. It
+ * lists characters one by one or as ranges of byte values, `[0-9A-F]`,
+ * like SymbolPlan charsets; a `-` that can't start a range (first or
+ * last) is the character itself. So `AB[0-4]7` is a pattern of three
+ * positions and matches the UIDs of vendor `AB` ending in `07`, `17`,
+ * ... `47`. None of the UID symbols is `[` or `]`, and patterns
+ * without `[` never get here (hasClass()).
+ */
+class CharClass {
+public:
+    CharClass() = default;
+
+    explicit CharClass(unsigned char c) { add(c); }
+
+    /**
+     * @return true if `pattern` holds a class at all
+     */
+    static bool hasClass(std::string_view pattern)
+    {
+        return pattern.find(OPEN) != std::string_view::npos;
+    }
+
+    void add(unsigned char c)
+    {
+        bits_[c / 64] |= uint64_t(1) << (c % 64);
+    }
+
+    bool contains(unsigned char c) const
+    {
+        return (bits_[c / 64] >> (c % 64)) & 1;
+    }
+
+    size_t count() const
+    {
+        size_t n = 0;
+        for (uint64_t w : bits_)
+            n += static_cast<size_t>(__builtin_popcountll(w));
+        return n;
+    }
+
+    /**
+     * @return true if exactly one character is in, stored in `c`
+     */
+    bool single(unsigned char &c) const
+    {
+        if (count() != 1)
+            return false;
+        for (size_t w = 0; w < bits_.size(); ++w) {
+            if (bits_[w])
+                c = static_cast<unsigned char>(
+                    w * 64 + static_cast<size_t>(__builtin_ctzll(bits_[w])));
+        }
+        return true;
+    }
+
+    /**
+     * @brief Reads the position of `pattern` at `at`, which moves past
+     *        it: one character, or a whole class.
+     *
+     * @return false if a class is empty, not closed or has a range the
+     *         wrong way round
+     */
+    bool parse(std::string_view pattern, size_t &at)
+    {
+        bits_ = {};
+        if (pattern[at] != OPEN) {
+            add(static_cast<unsigned char>(pattern[at++]));
+            return true;
+        }
+        const size_t close = pattern.find(CLOSE, at + 1);
+        if (close == std::string_view::npos || close == at + 1)
+            return false;
+        for (size_t i = at + 1; i < close; ++i) {
+            auto lo = static_cast<unsigned char>(pattern[i]), hi = lo;
+            if (i + 2 < close && pattern[i + 1] == '-') {
+                hi = static_cast<unsigned char>(pattern[i + 2]);
+                i += 2;
+            }
+            if (lo > hi)
+                return false;
+            for (unsigned c = lo; c <= hi; ++c)
+                add(static_cast<unsigned char>(c));
+        }
+        at = close + 1;
+        return true;
+    }
+
+    /**
+     * @return number of positions of `pattern`, 0 if it is malformed
+     */
+    static size_t positions(std::string_view pattern)
+    {
+        CharClass c;
+        size_t n = 0;
+        for (size_t at = 0; at < pattern.size(); ++n) {
+            if (!c.parse(pattern, at))
+                return 0;
+        }
+        return n;
+    }
+
+    /**
+     * @brief The UidResponder match rule with classes: the first `left`
+     *        positions are the UID's start, the rest is its end.
+     */
+    static bool matches(std::string_view pattern, std::string_view uid,
+        size_t left)
+    {
+        const size_t n = positions(pattern);
+        if (n == 0 || n > uid.size())
+            return false;
+        CharClass c;
+        size_t at = 0;
+        for (size_t i = 0; i < n; ++i) {
+            c.parse(pattern, at);
+            const size_t j = i < left ? i : uid.size() - n + i;
+            if (!c.contains(static_cast<unsigned char>(uid[j])))
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief The shortest pattern position for a set of characters: a
+     *        single one as it is, several as a class with every run of
+     *        three or more consecutive byte values as a range.
+     */
+    static std::string format(std::string_view chars)
+    {
+        std::string sorted(chars);
+        std::sort(sorted.begin(), sorted.end(),
+            [](char a, char b) {
+                return static_cast<unsigned char>(a) <
+                    static_cast<unsigned char>(b);
+            });
+        sorted.erase(std::unique(sorted.begin(), sorted.end()),
+            sorted.end());
+        if (sorted.size() == 1)
+            return sorted;
+
+        std::string out(1, OPEN);
+        // `-` goes first, where it can't start a range
+        auto it = std::find(sorted.begin(), sorted.end(), '-');
+        if (it != sorted.end()) {
+            sorted.erase(it);
+            out.push_back('-');
+        }
+        for (size_t i = 0; i < sorted.size();) {
+            size_t j = i + 1;
+            while (j < sorted.size() && sorted[j] - sorted[j - 1] == 1)
+                ++j;
+            if (j - i >= 3) {
+                out.push_back(sorted[i]);
+                out.push_back('-');
+                out.push_back(sorted[j - 1]);
+            } else {
+                out.append(sorted, i, j - i);
+            }
+            i = j;
+        }
+        out.push_back(CLOSE);
+        return out;
+    }
+
+    static constexpr char OPEN = '[';
+    static constexpr char CLOSE = ']';
+
+private:
+    std::array<uint64_t, 4> bits_{};
+};
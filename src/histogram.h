@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+
+/**
+ * @class Histogram
+ * @brief Log-linear histogram of non-negative integer samples, e.g.
+ *        latencies in microseconds.
+ *
+ * Values below 8 have a bucket each, larger ones SUB buckets per power
+ * of two, so a percentile is off by less than 1/8 of its value. The
+ * table has a fixed size and record() is a few instructions, cheap
+ * enough for every probe. Not thread-safe; keep one per thread and
+ * merge().
+ */
+class Histogram {
+public:
+    static constexpr unsigned SUB_BITS = 3;
+    static constexpr unsigned SUB = 1u << SUB_BITS;
+
+    void record(uint64_t v)
+    {
+        ++buckets_[bucket(v)];
+        if (count_ == 0 || v < min_)
+            min_ = v;
+        max_ = std::max(max_, v);
+        sum_ += v;
+        ++count_;
+    }
+
+    void merge(const Histogram &o)
+    {
+        if (o.count_ == 0)
+            return;
+        for (size_t i = 0; i < buckets_.size(); ++i)
+            buckets_[i] += o.buckets_[i];
+        min_ = count_ == 0 ? o.min_ : std::min(min_, o.min_);
+        max_ = std::max(max_, o.max_);
+        sum_ += o.sum_;
+        count_ += o.count_;
+    }
+
+    uint64_t count() const { return count_; }
+    uint64_t min() const { return min_; }
+    uint64_t max() const { return max_; }
+    uint64_t sum() const { return sum_; }
+    double mean() const { return count_ ? double(sum_) / count_ : 0.0; }
+
+    /**
+     * @param p Percentile, 0 to 100.
+     * @return upper end of the bucket holding it, never above max();
+     *         0 when empty
+     */
+    uint64_t percentile(double p) const
+    {
+        if (count_ == 0)
+            return 0;
+        const double want = std::ceil(std::clamp(p, 0.0, 100.0) / 100.0 *
+            static_cast<double>(count_));
+        const uint64_t rank = std::max<uint64_t>(1,
+            static_cast<uint64_t>(want));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets_.size(); ++i) {
+            seen += buckets_[i];
+            if (seen >= rank)
+                return std::clamp(upper(i), min_, max_);
+        }
+        return max_;
+    }
+
+    /**
+     * @brief `{"count":..,"mean":..,"p50":..,"p90":..,"p99":..,"max":..}`
+     *
+     * @param unit Divisor of every value, e.g. 1000 for samples in ns
+     *             reported in us.
+     */
+    void writeJson(std::ostream &out, double unit = 1) const
+    {
+        out << "{\"count\":" << count_ << ",\"mean\":" << mean() / unit
+            << ",\"p50\":" << percentile(50) / unit << ",\"p90\":"
+            << percentile(90) / unit << ",\"p99\":"
+            << percentile(99) / unit << ",\"max\":" << max_ / unit
+            << "}";
+    }
+
+    /**
+     * @brief `p50 <n> p90 <n> p99 <n> max <n>`, see writeJson()
+     */
+    void writeText(std::ostream &out, double unit = 1) const
+    {
+        out << "p50 " << percentile(50) / unit << " p90 "
+            << percentile(90) / unit << " p99 " << percentile(99) / unit
+            << " max " << max_ / unit;
+    }
+
+private:
+    static constexpr size_t BUCKETS = (64 - SUB_BITS + 1) * SUB;
+
+    static size_t bucket(uint64_t v)
+    {
+        if (v < SUB)
+            return static_cast<size_t>(v);
+        const unsigned e = 63 - static_cast<unsigned>(__builtin_clzll(v));
+        const unsigned mant = static_cast<unsigned>(
+            (v >> (e - SUB_BITS)) & (SUB - 1));
+        return (e - SUB_BITS + 1) * SUB + mant;
+    }
+
+    static uint64_t upper(size_t i)
+    {
+        if (i < SUB)
+            return i;
+        const unsigned e = static_cast<unsigned>(i / SUB) + SUB_BITS - 1;
+        const uint64_t low = (SUB + i % SUB) << (e - SUB_BITS);
+        return low + (uint64_t(1) << (e - SUB_BITS)) - 1;
+    }
+
+    std::array<uint64_t, BUCKETS> buckets_{};
+    uint64_t count_ = 0;
+    uint64_t min_ = 0;
+    uint64_t max_ = 0;
+    uint64_t sum_ = 0;
+};
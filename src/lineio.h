@@ -0,0 +1,274 @@
+#pragma once
+
+#include <poll.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @class LineReader
+ * @brief Reads '\n'-terminated lines from a raw file descriptor.
+ *
+ * Input goes through a ring buffer owned by the reader, so unlike
+ * poll() next to std::getline() it never loses track of lines that have
+ * been read from the descriptor but not consumed yet: readLine() hands
+ * out buffered lines first and only polls when none is complete, and
+ * buffered() tells whether the next readLine() can return at once.
+ *
+ * A line longer than the buffer makes it grow. An unterminated last
+ * line is returned at end of input, like std::getline() does.
+ */
+class LineReader {
+public:
+    /**
+     * @param fd       Descriptor to read from; not closed by the reader.
+     * @param capacity Initial buffer size, rounded up to a power of two.
+     */
+    explicit LineReader(int fd, size_t capacity = 65536) :
+        fd_(fd)
+    {
+        size_t n = 64;
+        while (n < capacity)
+            n *= 2;
+        ring_.resize(n);
+    }
+
+    /**
+     * @brief Reads one line without its '\n'.
+     *
+     * @param timeout_ms How long to wait if no line is buffered, in ms;
+     *                   negative waits forever.
+     * @return false on timeout, end of input or error
+     */
+    bool readLine(std::string &line, int timeout_ms = -1)
+    {
+        using clock = std::chrono::steady_clock;
+        const auto deadline =
+            clock::now() + std::chrono::milliseconds(timeout_ms);
+
+        for (;;) {
+            if (takeLine(line))
+                return true;
+            if (eof_) {
+                if (size() == 0)
+                    return false;
+                take(size(), 0, line); // unterminated last line
+                return true;
+            }
+
+            int wait = -1;
+            if (timeout_ms >= 0) {
+                auto left = std::chrono::duration_cast<
+                    std::chrono::milliseconds>(deadline - clock::now());
+                wait = left.count() > 0 ? static_cast<int>(left.count())
+                                        : 0;
+            }
+            struct pollfd pfd;
+            pfd.fd = fd_;
+            pfd.events = POLLIN;
+            int ret = poll(&pfd, 1, wait);
+            if (ret < 0 && errno == EINTR)
+                continue;
+            if (ret <= 0)
+                return false;
+            if (!fill())
+                return false;
+        }
+    }
+
+    /**
+     * @return true if a complete line is buffered, i.e. readLine() won't
+     *         touch the descriptor
+     */
+    bool buffered()
+    {
+        return findNewline() || (eof_ && size() > 0);
+    }
+
+    /**
+     * @return true once the descriptor reported end of input
+     */
+    bool eof() const { return eof_; }
+
+private:
+    size_t size() const { return tail_ - head_; }
+    size_t mask() const { return ring_.size() - 1; }
+
+    /**
+     * looks for '\n' in the unread part, remembering how far it got so
+     * that a line arriving in pieces is scanned once
+     */
+    bool findNewline()
+    {
+        for (; scan_ < tail_; ++scan_) {
+            if (ring_[scan_ & mask()] == '\n')
+                return true;
+        }
+        return false;
+    }
+
+    bool takeLine(std::string &line)
+    {
+        if (!findNewline())
+            return false;
+        take(scan_ - head_, 1, line);
+        return true;
+    }
+
+    /**
+     * moves `n` bytes to `line` and drops `skip` more (the '\n')
+     */
+    void take(size_t n, size_t skip, std::string &line)
+    {
+        const size_t at = head_ & mask();
+        const size_t first = std::min(n, ring_.size() - at);
+        line.assign(ring_.data() + at, first);
+        line.append(ring_.data(), n - first);
+        head_ += n + skip;
+        scan_ = head_;
+    }
+
+    /**
+     * one read() into the free part of the ring
+     *
+     * @return false on error
+     */
+    bool fill()
+    {
+        if (size() == ring_.size())
+            grow();
+        const size_t at = tail_ & mask();
+        const size_t room = std::min(ring_.size() - size(),
+            ring_.size() - at);
+        ssize_t n;
+        do {
+            n = ::read(fd_, ring_.data() + at, room);
+        } while (n < 0 && errno == EINTR);
+        if (n < 0)
+            return false;
+        if (n == 0)
+            eof_ = true;
+        tail_ += static_cast<size_t>(n);
+        return true;
+    }
+
+    void grow()
+    {
+        std::vector<char> bigger(ring_.size() * 2);
+        for (size_t i = head_; i < tail_; ++i)
+            bigger[i & (bigger.size() - 1)] = ring_[i & mask()];
+        ring_.swap(bigger);
+    }
+
+    int fd_;
+    std::vector<char> ring_;
+    size_t head_ = 0; // positions grow forever, masked on access
+    size_t tail_ = 0;
+    size_t scan_ = 0; // [head_, scan_) holds no '\n'
+    bool eof_ = false;
+};
+
+/**
+ * @class LineWriter
+ * @brief Buffered output on a raw file descriptor.
+ *
+ * put() only appends to the buffer; nothing reaches the descriptor
+ * before flush(), so a burst of replies costs one system call. write()
+ * sends its data right away, together with anything still buffered, in
+ * a single writev().
+ */
+class LineWriter {
+public:
+    /**
+     * @param fd Descriptor to write to; not closed by the writer.
+     */
+    explicit LineWriter(int fd) :
+        fd_(fd)
+    {
+    }
+
+    ~LineWriter() { flush(); }
+
+    LineWriter(const LineWriter &) = delete;
+    LineWriter &operator=(const LineWriter &) = delete;
+
+    /**
+     * @brief Buffers `a` followed by `b` and a '\n'.
+     */
+    void put(std::string_view a, std::string_view b = {})
+    {
+        buf_.append(a);
+        buf_.append(b);
+        buf_.push_back('\n');
+        if (buf_.size() >= FLUSH_AT)
+            flush();
+    }
+
+    /**
+     * @brief Writes out everything buffered.
+     *
+     * @return false on a write error; the data is dropped then
+     */
+    bool flush() { return write({}); }
+
+    /**
+     * @brief Writes the buffer, then `data`, with one writev().
+     *
+     * @return false on a write error; the data is dropped then
+     */
+    bool write(std::string_view data)
+    {
+        struct iovec iov[2] = {
+            {const_cast<char *>(buf_.data()), buf_.size()},
+            {const_cast<char *>(data.data()), data.size()},
+        };
+        struct iovec *v = iov;
+        int cnt = 2;
+        bool ok = true;
+        while (cnt > 0) {
+            if (v->iov_len == 0) {
+                ++v;
+                --cnt;
+                continue;
+            }
+            ssize_t n = ::writev(fd_, v, cnt);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0) {
+                ok = false;
+                break;
+            }
+            // skip what went out, possibly part of an iovec
+            size_t done = static_cast<size_t>(n);
+            while (cnt > 0 && done >= v->iov_len) {
+                done -= v->iov_len;
+                ++v;
+                --cnt;
+            }
+            if (cnt > 0) {
+                v->iov_base = static_cast<char *>(v->iov_base) + done;
+                v->iov_len -= done;
+            }
+        }
+        buf_.clear();
+        return ok;
+    }
+
+    /**
+     * @return number of bytes waiting for flush()
+     */
+    size_t pending() const { return buf_.size(); }
+
+private:
+    static constexpr size_t FLUSH_AT = 65536;
+
+    int fd_;
+    std::string buf_;
+};
@@ -0,0 +1,338 @@
+#pragma once
+
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "lineio.h"
+#include "rtt.h"
+#include "scanengine.h"
+
+constexpr int POLL_TIMEOUT = 200;
+
+/**
+ * @class LineLink
+ * @brief ScanLink speaking the uidresp line protocol.
+ *
+ * Implements probes, pipelined windows and the SETADDR/RESETALL
+ * commands on top of two primitives a subclass provides: writing
+ * complete lines and reading one line with a timeout.
+ *
+ * In adaptive mode (setAdaptive()) the fixed timeout only is the upper
+ * bound: the actual wait follows the measured reply latency, see
+ * RttEstimator.
+ *
+ * assignLater() sends a tagged `@<tag>:SETADDR:<uid>` and moves on. Its
+ * echo is picked out of the replies read for later lines; as replies
+ * come in order, a reply to a later line without the echo before it
+ * tells that there is none. settle() waits for the rest behind one
+ * `SYNC:<n>`.
+ */
+class LineLink : public ScanLink {
+public:
+    /**
+     * @param timeout  How long to wait for a reply, in ms.
+     * @param pipeline Use the tagged framing for all probes.
+     */
+    explicit LineLink(int timeout = POLL_TIMEOUT, bool pipeline = false) :
+        timeout_(timeout),
+        pipeline_(pipeline)
+    {
+    }
+
+    void setTimeout(int timeout) { timeout_ = timeout; }
+    void setPipeline(bool on) { pipeline_ = on; }
+
+    /**
+     * @brief Derives the wait for replies from their observed latency,
+     *        never going below `floorMs` or above the fixed timeout.
+     */
+    void setAdaptive(int floorMs) { rtt_.emplace(floorMs, timeout_); }
+
+    /**
+     * @return current wait for a reply, in ms
+     */
+    int timeout() const { return rtt_ ? rtt_->timeout() : timeout_; }
+
+    /**
+     * @return latency estimator in adaptive mode, nullptr otherwise
+     */
+    const RttEstimator *rtt() const { return rtt_ ? &*rtt_ : nullptr; }
+
+    std::string probe(const std::string &pattern) override
+    {
+        if (pipeline_)
+            return sendWindow({pattern})[0];
+        return sendAndRecv(pattern);
+    }
+
+    std::vector<std::string> probeWindow(
+        const std::vector<std::string> &patterns) override
+    {
+        if (pipeline_)
+            return sendWindow(patterns);
+        return ScanLink::probeWindow(patterns);
+    }
+
+    bool pipelined() const override { return pipeline_; }
+
+    std::string assign(const std::string &uid) override
+    {
+        // see `src/uidresp.cpp` for additional commands
+        send("SETADDR:" + uid);
+        for (;;) {
+            std::string resp = readLine(rtt_ ? timeout() : POLL_TIMEOUT);
+            if (!takeEcho(resp, true))
+                return resp;
+        }
+    }
+
+    void assignLater(const std::string &uid) override
+    {
+        send("@" + std::to_string(++seq_) + ":SETADDR:" + uid);
+        assigns_.emplace(seq_, uid);
+    }
+
+    std::vector<std::string> settle(bool wait = true) override
+    {
+        if (wait && !assigns_.empty()) {
+            const std::string sync = "SYNC:" + std::to_string(++seq_);
+            send(sync);
+            for (;;) {
+                std::string line = readLine(timeout());
+                takeEcho(line, false);
+                if (line.empty() || line == sync)
+                    break;
+            }
+            passed(ULONG_MAX);
+        }
+        std::vector<std::string> failed;
+        failed.swap(unconfirmed_);
+        return failed;
+    }
+
+    void resetAll() override { send("RESETALL"); }
+
+    /**
+     * @brief split a pipelined reply `@<tag>:<payload>`
+     *
+     * @return false if the line carries no tag
+     */
+    static bool parseTagged(const std::string &line, unsigned long &tag,
+        std::string &payload)
+    {
+        if (line.size() < 3 || line[0] != '@')
+            return false;
+        char *endptr = nullptr;
+        tag = std::strtoul(line.c_str() + 1, &endptr, 10);
+        if (endptr == line.c_str() + 1 || *endptr != ':')
+            return false;
+        payload.assign(endptr + 1);
+        return true;
+    }
+
+protected:
+    /**
+     * @brief writes `data` (one or more '\n'-terminated lines) and
+     *        flushes it
+     */
+    virtual void writeLines(const std::string &data) = 0;
+
+    /**
+     * @brief reads one line without its '\n'
+     *
+     * @return false on timeout, end of input or error
+     */
+    virtual bool readRaw(std::string &line, int timeout_ms) = 0;
+
+    /**
+     * @brief read data, detect timeout and, partly, a collision (empty
+     * line with "\n" is the collision, too)
+     *
+     * @return 1. empty string if timeout
+     *         2. "!" if collision because "!" is not a valid symbol in
+     *            any response
+     *         3. response string
+     */
+    std::string readLine(int timeout_ms)
+    {
+        using clock = std::chrono::steady_clock;
+        const auto start = clock::now();
+        std::string line;
+        if (!readRaw(line, timeout_ms))
+            return ""; // timeout or error
+        if (rtt_)
+            rtt_->sample(std::chrono::duration<double, std::milli>(
+                clock::now() - start).count());
+        if (!line.empty())
+            return line; // normal response
+        return "!";      // collision
+    }
+
+    void send(const std::string &line)
+    {
+        out_.assign(line);
+        out_.push_back('\n');
+        writeLines(out_);
+    }
+
+    /**
+     * @brief checks `line` against the assignLater() calls waiting for
+     *        their echo. any other reply answers a line sent after
+     *        some of them, whose echo would have come first
+     *
+     * @param latest An untagged `line` answers the line sent last.
+     * @return false if it is no such echo
+     */
+    bool takeEcho(const std::string &line, bool latest)
+    {
+        if (assigns_.empty() || line.empty())
+            return false;
+        unsigned long tag;
+        std::string payload;
+        if (line.rfind("SYNC:", 0) == 0) {
+            passed(std::strtoul(line.c_str() + 5, nullptr, 10));
+            return false;
+        }
+        if (!parseTagged(line, tag, payload)) {
+            if (latest)
+                passed(ULONG_MAX);
+            return false;
+        }
+        auto it = assigns_.find(tag);
+        if (it == assigns_.end()) {
+            passed(tag);
+            return false;
+        }
+        if (payload != it->second)
+            unconfirmed_.push_back(it->second);
+        assigns_.erase(it);
+        return true;
+    }
+
+    /**
+     * @brief the responder got past the line tagged `tag`: every
+     *        assignLater() before it without echo is not confirmed
+     */
+    void passed(unsigned long tag)
+    {
+        auto end = assigns_.lower_bound(tag);
+        for (auto it = assigns_.begin(); it != end; ++it)
+            unconfirmed_.push_back(it->second);
+        assigns_.erase(assigns_.begin(), end);
+    }
+
+    std::string sendAndRecv(const std::string &line)
+    {
+        // whatever is already there answers an earlier, timed out line
+        std::string stale;
+        while ((rtt_ || !assigns_.empty()) && readRaw(stale, 0)) {
+            if (!takeEcho(stale, false) && rtt_)
+                rtt_->late();
+        }
+
+        send(line);
+        for (;;) {
+            std::string resp = readLine(timeout());
+            if (!takeEcho(resp, true))
+                return resp;
+        }
+    }
+
+    /**
+     * @brief pipelined sendAndRecv(): send a window of probes in a single
+     *        write and collect the replies
+     *
+     * every probe goes out as `@<tag>:<pattern>` with a fresh sequence
+     * tag, followed by a `SYNC:<tag>` barrier. the responder answers in
+     * order, so once the barrier comes back every probe without a reply
+     * is a miss. a timeout while waiting means the same. replies with
+     * tags of other windows (late ones) are dropped
+     *
+     * @return one response per pattern, encoded like readLine() does
+     */
+    std::vector<std::string> sendWindow(
+        const std::vector<std::string> &patterns)
+    {
+        const unsigned long first = seq_ + 1;
+        out_.clear();
+        for (const auto &p : patterns) {
+            out_.push_back('@');
+            out_.append(std::to_string(++seq_));
+            out_.push_back(':');
+            out_.append(p);
+            out_.push_back('\n');
+        }
+        const std::string sync = "SYNC:" + std::to_string(seq_);
+        out_.append(sync);
+        out_.push_back('\n');
+        writeLines(out_);
+
+        std::vector<std::string> resp(patterns.size());
+        for (;;) {
+            std::string line = readLine(timeout());
+            const bool echo = takeEcho(line, false);
+            if (line.empty() || line == sync)
+                break;
+
+            unsigned long tag;
+            std::string payload;
+            if (echo || !parseTagged(line, tag, payload) ||
+                tag > seq_)
+                continue;
+            if (tag < first) {
+                if (rtt_)
+                    rtt_->late();
+                continue;
+            }
+            resp[tag - first] = payload.empty() ? "!" : payload;
+        }
+        return resp;
+    }
+
+private:
+    int timeout_;
+    bool pipeline_;
+    unsigned long seq_ = 0; // last sequence tag used
+    std::optional<RttEstimator> rtt_;
+    std::map<unsigned long, std::string> assigns_; // tag -> uid
+    std::vector<std::string> unconfirmed_;
+    std::string out_; // lines being sent, reused
+};
+
+/**
+ * @class FdLink
+ * @brief LineLink on a pair of raw file descriptors (stdin/stdout,
+ *        pipe, socket, serial line), see lineio.h.
+ *
+ * The descriptors are not closed by the link.
+ */
+class FdLink : public LineLink {
+public:
+    FdLink(int in, int out, int timeout = POLL_TIMEOUT,
+        bool pipeline = false) :
+        LineLink(timeout, pipeline),
+        reader_(in),
+        writer_(out)
+    {
+    }
+
+protected:
+    void writeLines(const std::string &data) override
+    {
+        writer_.write(data);
+    }
+
+    bool readRaw(std::string &line, int timeout_ms) override
+    {
+        return reader_.readLine(line, timeout_ms);
+    }
+
+private:
+    LineReader reader_;
+    LineWriter writer_;
+};
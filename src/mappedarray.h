@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**
+ * @class MappedArray
+ * @brief An array of a trivially copyable `T`, either owned or a
+ *        read-only view of memory that something else keeps, such as
+ *        a mapped image file (UidFile::loadImage()).
+ *
+ * A view holds on to its backing with a shared_ptr, so copies share
+ * the memory, and processes mapping the same file share its pages.
+ * A change (edit()) first copies a view into an owned vector.
+ */
+template <typename T>
+class MappedArray {
+public:
+    MappedArray() = default;
+
+    explicit MappedArray(std::vector<T> own) :
+        own_(std::move(own))
+    {
+        sync();
+    }
+
+    /**
+     * @brief A view of `size` elements at `data`, valid while `backing`
+     *        lives.
+     */
+    MappedArray(std::shared_ptr<const void> backing, const T *data,
+        size_t size) :
+        backing_(std::move(backing)),
+        data_(data),
+        size_(size)
+    {
+    }
+
+    MappedArray(const MappedArray &other) :
+        own_(other.own_),
+        backing_(other.backing_),
+        data_(other.data_),
+        size_(other.size_)
+    {
+        if (!backing_)
+            sync();
+    }
+
+    MappedArray(MappedArray &&other) noexcept :
+        own_(std::move(other.own_)),
+        backing_(std::move(other.backing_)),
+        data_(other.data_),
+        size_(other.size_)
+    {
+        if (!backing_)
+            sync();
+        other.sync();
+    }
+
+    MappedArray &operator=(MappedArray other) noexcept
+    {
+        const T *data = other.data_;
+        const size_t size = other.size_;
+        own_.swap(other.own_);
+        backing_.swap(other.backing_);
+        data_ = data;
+        size_ = size;
+        if (!backing_)
+            sync();
+        return *this;
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const T *data() const { return data_; }
+    const T *begin() const { return data_; }
+    const T *end() const { return data_ + size_; }
+    const T &operator[](size_t i) const { return data_[i]; }
+
+    /**
+     * @return true if this is a view
+     */
+    bool mapped() const { return backing_ != nullptr; }
+
+    /**
+     * @brief Calls `fn(std::vector<T> &)` to change the elements,
+     *        owning them first.
+     */
+    template <typename Fn>
+    void edit(Fn &&fn)
+    {
+        if (backing_) {
+            own_.assign(data_, data_ + size_);
+            backing_.reset();
+        }
+        fn(own_);
+        sync();
+    }
+
+private:
+    void sync()
+    {
+        data_ = own_.data();
+        size_ = own_.size();
+    }
+
+    std::vector<T> own_;
+    std::shared_ptr<const void> backing_; // null if owned
+    const T *data_ = nullptr;
+    size_t size_ = 0;
+};
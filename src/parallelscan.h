@@ -0,0 +1,292 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "scanengine.h"
+#include "symbolplan.h"
+#include "uidformat.h"
+
+/**
+ * @class ParallelScan
+ * @brief Walks the subtrees of a prefix on several channels of one bus
+ *        at the same time.
+ *
+ * Siblings match disjoint sets of UIDs, and everything muted below one
+ * of them belongs to that one (see ScanEngine::response()), so the
+ * subtrees below a collided node are independent as long as each one
+ * is walked on a channel of its own: connections to a
+ * `uidresp --listen` server, ports of a multiplexer, SimLinks sharing
+ * one UidBus.
+ *
+ * The tree down to setSplitDepth() is cut into tasks of one node each.
+ * A task above the split depth probes its node only; if it collides,
+ * its children are tasks in turn. A task at the split depth walks its
+ * whole subtree with a ScanEngine. Every worker (one per channel, each
+ * with its own engine) keeps a deque of tasks: it takes the newest of
+ * its own and, when that is empty, steals the oldest of another, i.e.
+ * the one closest to the root. The children of a split node are tried
+ * in the plan's order; collision hints only apply below the split.
+ *
+ * Each worker collects UIDs in a set of its own while a task runs (a
+ * UID not matching the pattern probed is a collision, so no task needs
+ * the others' results) and adds them to the shared one, under a lock,
+ * once the task is through and settled.
+ */
+class ParallelScan {
+public:
+    /**
+     * @brief A link to the bus and who hears of what is found on it.
+     */
+    struct Channel {
+        ScanLink *link;
+        ScanObserver *observer = nullptr;
+    };
+
+    struct WorkerStats {
+        size_t tasks = 0;
+        size_t stolen = 0;
+    };
+
+    /**
+     * @param channels One worker each; the first one runs in the
+     *                 calling thread.
+     * @param found    Set that receives confirmed UIDs.
+     */
+    ParallelScan(const std::vector<Channel> &channels,
+        std::set<std::string> &found) :
+        channels_(channels),
+        found_(found)
+    {
+        for (size_t i = 0; i < channels_.size(); ++i)
+            workers_.push_back(std::make_unique<Worker>());
+    }
+
+    /**
+     * @brief Engine settings, see ScanEngine. The plan is used by all
+     *        workers at once.
+     */
+    void setSymbolPlan(SymbolPlan *plan) { plan_ = plan; }
+    void setCollisionHints(ScanEngine::CollisionHints hints)
+    {
+        hints_ = hints;
+    }
+    void setConfirm(ScanEngine::Confirm confirm) { confirm_ = confirm; }
+    void setDepthLimit(size_t depth)
+    {
+        depthLimit_ = std::min<size_t>(depth, MAXLEN);
+    }
+
+    /**
+     * @brief Node length (pattern characters after the prefix) from
+     *        which on a task walks its subtree itself. 0 hands the
+     *        whole prefix to one worker. Defaults to 2, up to 4096
+     *        subtrees.
+     */
+    void setSplitDepth(size_t depth) { splitDepth_ = depth; }
+
+    /**
+     * @brief Scans one prefix completely on all channels.
+     */
+    void scan(const std::string &pfx)
+    {
+        pfx_ = pfx;
+        pending_ = 0;
+        queued_ = 0;
+        push(0, {""});
+
+        std::vector<std::thread> pool;
+        for (size_t w = 1; w < workers_.size(); ++w)
+            pool.emplace_back([this, w]() { work(w); });
+        work(0);
+        for (auto &t : pool)
+            t.join();
+    }
+
+    /**
+     * @return tasks run and stolen, per worker, over all scans
+     */
+    std::vector<WorkerStats> workerStats() const
+    {
+        std::vector<WorkerStats> stats;
+        for (const auto &w : workers_)
+            stats.push_back(w->stats);
+        return stats;
+    }
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::string> tasks; // nodes, newest at the back
+        std::set<std::string> found;   // of the task running
+        WorkerStats stats;
+    };
+
+    /**
+     * forwards every event, except the depth limit met by a task above
+     * the split depth: those are the nodes to split
+     */
+    class TaskObserver : public ScanObserver {
+    public:
+        TaskObserver(ParallelScan &scan, size_t worker) :
+            scan_(scan),
+            worker_(worker),
+            next_(scan.channels_[worker].observer)
+        {
+        }
+
+        void collision(const std::string &pattern, size_t level) override
+        {
+            if (next_)
+                next_->collision(pattern, level);
+        }
+
+        void found(const std::string &uid) override
+        {
+            if (next_)
+                next_->found(uid);
+        }
+
+        void depthLimit(const std::string &pattern) override
+        {
+            if (split)
+                scan_.split(worker_, pattern);
+            else if (next_)
+                next_->depthLimit(pattern);
+        }
+
+        void retracted(const std::string &uid) override
+        {
+            if (next_)
+                next_->retracted(uid);
+        }
+
+        bool split = false;
+
+    private:
+        ParallelScan &scan_;
+        size_t worker_;
+        ScanObserver *next_;
+    };
+
+    void work(size_t w)
+    {
+        Worker &me = *workers_[w];
+        ScanEngine engine(*channels_[w].link, me.found);
+        TaskObserver observer(*this, w);
+        engine.setObserver(&observer);
+        engine.setSymbolPlan(plan_);
+        engine.setCollisionHints(hints_);
+        engine.setConfirm(confirm_);
+
+        std::string node;
+        while (take(w, node)) {
+            observer.split = node.size() < splitDepth_ &&
+                node.size() < depthLimit_;
+            engine.setDepthLimit(observer.split ? node.size()
+                                                : depthLimit_);
+            engine.scan(pfx_, node);
+            ++me.stats.tasks;
+            {
+                std::lock_guard<std::mutex> lock(foundMutex_);
+                found_.insert(me.found.begin(), me.found.end());
+            }
+            me.found.clear();
+            if (--pending_ == 0)
+                wake();
+        }
+    }
+
+    /**
+     * queues the children of the collided node `pattern` on worker `w`
+     */
+    void split(size_t w, const std::string &pattern)
+    {
+        std::string node(pattern.rbegin(),
+            pattern.rend() - static_cast<long>(pfx_.size()));
+        const std::string symbols = plan_
+            ? plan_->symbols(pfx_, node.size()) : std::string(CHARSET);
+        std::vector<std::string> children;
+        // the back is taken first: queue the last symbol first
+        for (auto it = symbols.rbegin(); it != symbols.rend(); ++it)
+            children.push_back(node + *it);
+        push(w, children);
+    }
+
+    void push(size_t w, const std::vector<std::string> &nodes)
+    {
+        pending_ += nodes.size();
+        {
+            std::lock_guard<std::mutex> lock(workers_[w]->mutex);
+            workers_[w]->tasks.insert(workers_[w]->tasks.end(),
+                nodes.begin(), nodes.end());
+        }
+        queued_ += nodes.size();
+        wake();
+    }
+
+    /**
+     * next task of worker `w`: its own newest, else another's oldest.
+     * waits while other workers may still split
+     *
+     * @return false once all tasks are done
+     */
+    bool take(size_t w, std::string &node)
+    {
+        for (;;) {
+            for (size_t i = 0; i < workers_.size(); ++i) {
+                Worker &v = *workers_[(w + i) % workers_.size()];
+                std::lock_guard<std::mutex> lock(v.mutex);
+                if (v.tasks.empty())
+                    continue;
+                if (i == 0) {
+                    node = std::move(v.tasks.back());
+                    v.tasks.pop_back();
+                } else {
+                    node = std::move(v.tasks.front());
+                    v.tasks.pop_front();
+                    ++workers_[w]->stats.stolen;
+                }
+                --queued_;
+                return true;
+            }
+            std::unique_lock<std::mutex> lock(idleMutex_);
+            idle_.wait(lock, [this]() {
+                return queued_ > 0 || pending_ == 0;
+            });
+            if (pending_ == 0)
+                return false;
+        }
+    }
+
+    void wake()
+    {
+        // taken once, so a worker between its check and its wait can't
+        // miss the notification
+        { std::lock_guard<std::mutex> lock(idleMutex_); }
+        idle_.notify_all();
+    }
+
+    std::vector<Channel> channels_;
+    std::set<std::string> &found_;
+    std::mutex foundMutex_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    SymbolPlan *plan_ = nullptr;
+    ScanEngine::CollisionHints hints_ = ScanEngine::CollisionHints::None;
+    ScanEngine::Confirm confirm_ = ScanEngine::Confirm::Echo;
+    size_t depthLimit_ = MAXLEN;
+    size_t splitDepth_ = 2;
+
+    std::string pfx_;
+    std::atomic<size_t> pending_{0}; // queued or running
+    std::atomic<size_t> queued_{0};
+    std::mutex idleMutex_;
+    std::condition_variable idle_;
+};
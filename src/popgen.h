@@ -0,0 +1,230 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "uidformat.h"
+
+/**
+ * @class PopulationGenerator
+ * @brief Synthetic UID populations shaped like real buses, and worse.
+ *
+ * The walk (see ScanEngine) tells UIDs apart from their end, so what
+ * makes a population expensive is UIDs sharing their last characters.
+ * Besides uniformly random serial numbers a Shape mixes in:
+ *
+ * - runs: consecutive decimal serial numbers in the last `digits`
+ *   characters, as devices leave a production line. Only 10 of the 64
+ *   symbols occur there, so every tree level costs 64 probes for at
+ *   most 10 branches
+ * - shared suffixes: one of `tails` fixed endings of `suffixLength`
+ *   characters (a model code), a collision chain that deep before the
+ *   UIDs part
+ * - clusters: the adversarial case, groups of `clusterSize` UIDs that
+ *   differ in their first serial character (after the head) only, so
+ *   each group is walked down the whole UID
+ * - a shared head: the first `headLength` serial characters of every
+ *   UID of a vendor are the same, which the walk reaches last
+ *
+ * Shares are fractions of the population; what is left is random. A
+ * run, tail or cluster keeps to one vendor; the vendors take turns.
+ * The same seed and shape give the same population.
+ */
+class PopulationGenerator {
+public:
+    struct Shape {
+        double runs = 0;
+        size_t runLength = 100;
+        size_t digits = 6;
+        double suffixes = 0;
+        size_t suffixLength = 8;
+        size_t tails = 4;
+        double clusters = 0;
+        size_t clusterSize = 4;
+        size_t headLength = 0;
+    };
+
+    explicit PopulationGenerator(
+        std::vector<std::string> vendors = {"CB"}, unsigned seed = 1) :
+        vendors_(std::move(vendors)),
+        seed_(seed)
+    {
+    }
+
+    /**
+     * @brief Applies a comma separated list of `<name>=<value>`:
+     *        `runs`, `run-length`, `digits`, `suffixes`,
+     *        `suffix-length`, `tails`, `clusters`, `cluster-size`,
+     *        `head` (the Shape members).
+     *
+     * @return false if an item is malformed or out of range; an empty
+     *         list is fine
+     */
+    bool parse(const std::string &list)
+    {
+        size_t at = 0;
+        while (!list.empty() && at <= list.size()) {
+            size_t end = list.find(',', at);
+            if (end == std::string::npos)
+                end = list.size();
+            if (!set(list.substr(at, end - at)))
+                return false;
+            at = end + 1;
+        }
+        return true;
+    }
+
+    Shape &shape() { return shape_; }
+    const Shape &shape() const { return shape_; }
+
+    /**
+     * @return `n` distinct UIDs in the order generated; fewer if the
+     *         shape leaves no room for that many (a long shared head)
+     */
+    std::vector<std::string> generate(size_t n)
+    {
+        std::mt19937 rng(seed_);
+        std::vector<std::string> heads;
+        for (size_t v = 0; v < vendors_.size(); ++v)
+            heads.push_back(random(rng, shape_.headLength));
+        std::vector<std::vector<std::string>> tails(vendors_.size());
+        for (auto &t : tails) {
+            for (size_t i = 0; i < shape_.tails; ++i)
+                t.push_back(random(rng, shape_.suffixLength));
+        }
+
+        std::set<std::string> seen;
+        std::vector<std::string> uids;
+        size_t misses = 0; // duplicates in a row
+        size_t vendor = 0;
+        // the head never covers what makes the shape
+        auto add = [&](size_t v, const std::string &body, size_t keep) {
+            const size_t head = std::min(heads[v].size(), keep);
+            std::string uid = vendors_[v] + heads[v].substr(0, head) +
+                body.substr(head);
+            if (seen.insert(uid).second) {
+                uids.push_back(uid);
+                misses = 0;
+            } else {
+                ++misses;
+            }
+        };
+        auto until = [&](size_t count) {
+            return uids.size() < count && misses < MAX_MISSES;
+        };
+
+        size_t total = std::min(n, count(n, shape_.runs));
+        const size_t digits = shape_.digits;
+        while (until(total)) {
+            // one random start, counted up in the last digits
+            const size_t v = vendor++ % vendors_.size();
+            const std::string head = random(rng, BODY - digits);
+            unsigned long serial = rng() % modulus();
+            for (size_t i = 0; i < shape_.runLength && until(total); ++i)
+                add(v, head + decimal(serial++ % modulus()),
+                    BODY - digits);
+        }
+        total = std::min(n, total + count(n, shape_.suffixes));
+        const size_t tail = shape_.suffixLength;
+        while (until(total)) {
+            const size_t v = vendor++ % vendors_.size();
+            const auto &t = tails[v];
+            add(v, random(rng, BODY - tail) + t[rng() % t.size()],
+                BODY - tail);
+        }
+        total = std::min(n, total + count(n, shape_.clusters));
+        while (until(total)) {
+            // one body, its first symbol varied
+            const size_t v = vendor++ % vendors_.size();
+            std::string body = random(rng, BODY);
+            const size_t first = std::min(heads[v].size(), BODY - 1);
+            const size_t offset = rng();
+            for (size_t i = 0; i < shape_.clusterSize && until(total);
+                ++i) {
+                body[first] =
+                    AisgUid::CHARSET[(offset + i) % AisgUid::SYMBOLS];
+                add(v, body, first);
+            }
+        }
+        while (until(n))
+            add(vendor++ % vendors_.size(), random(rng, BODY), BODY);
+        return uids;
+    }
+
+private:
+    bool set(const std::string &item)
+    {
+        const size_t eq = item.find('=');
+        if (eq == std::string::npos)
+            return false;
+        const std::string name = item.substr(0, eq);
+        const char *value = item.c_str() + eq + 1;
+        char *end = nullptr;
+        const double x = std::strtod(value, &end);
+        if (end == value || *end != '\0' || x < 0)
+            return false;
+        const size_t k = static_cast<size_t>(x);
+        if (name == "runs" || name == "suffixes" || name == "clusters") {
+            if (x > 1)
+                return false;
+            (name == "runs" ? shape_.runs : name == "suffixes"
+                ? shape_.suffixes : shape_.clusters) = x;
+        } else if (name == "run-length" && k > 0) {
+            shape_.runLength = k;
+        } else if (name == "digits" && k > 0 && k <= 9 && k <= BODY) {
+            shape_.digits = k;
+        } else if (name == "suffix-length" && k <= BODY) {
+            shape_.suffixLength = k;
+        } else if (name == "tails" && k > 0) {
+            shape_.tails = k;
+        } else if (name == "cluster-size" && k > 1 &&
+            k <= AisgUid::SYMBOLS) {
+            shape_.clusterSize = k;
+        } else if (name == "head" && k <= BODY) {
+            shape_.headLength = k;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    static size_t count(size_t n, double share)
+    {
+        return static_cast<size_t>(static_cast<double>(n) * share);
+    }
+
+    static std::string random(std::mt19937 &rng, size_t len)
+    {
+        std::string s;
+        for (size_t i = 0; i < len; ++i)
+            s.push_back(AisgUid::CHARSET[rng() % AisgUid::SYMBOLS]);
+        return s;
+    }
+
+    unsigned long modulus() const
+    {
+        unsigned long m = 1;
+        for (size_t i = 0; i < shape_.digits; ++i)
+            m *= 10;
+        return m;
+    }
+
+    std::string decimal(unsigned long serial) const
+    {
+        std::string s(shape_.digits, '0');
+        for (size_t i = shape_.digits; i-- > 0; serial /= 10)
+            s[i] = static_cast<char>('0' + serial % 10);
+        return s;
+    }
+
+    static constexpr size_t BODY = AisgUid::BODY;
+    static constexpr size_t MAX_MISSES = 10000;
+
+    std::vector<std::string> vendors_;
+    unsigned seed_;
+    Shape shape_;
+};
@@ -0,0 +1,472 @@
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "histogram.h"
+#include "lineio.h"
+#include "scanengine.h"
+#include "uidbus.h"
+
+/**
+ * @class Recording
+ * @brief The link traffic of one bus in a trace (see TraceSink), in
+ *        order: every (probe, response, latency) that went over it.
+ *
+ * Besides the exchanges it keeps what a replay needs when the scan
+ * takes another way than the recorded one: the UIDs found on the bus
+ * (found and not retracted, or confirmed by a SETADDR echo), the
+ * prefixes scanned, and the latency of each kind of exchange (p50 of
+ * answered probes, of probes without answer, of windows, SETADDRs and
+ * settles).
+ */
+class Recording {
+public:
+    struct Exchange {
+        enum Kind { Probe, Window, Assign, AssignLater, Settle, Reset };
+
+        Kind kind;
+        std::vector<std::string> sent; // pattern(s) or uid
+        std::vector<std::string> resp; // settle: the ones failed
+        long us = 0;
+    };
+
+    struct Latency {
+        long probe = 0;  // answered
+        long miss = 0;   // no answer: the timeout, unless pipelined
+        long window = 0; // 0 if none were recorded
+        long assign = 0; // if none: probe, else window
+        long settle = 0; // the same
+    };
+
+    /**
+     * @brief Reads the trace `path`.
+     *
+     * @param bus Label of the bus to take (its channels, `<bus>#<n>`,
+     *            included); empty for the first one in the trace.
+     * @return false with errno set if it can't be read, EINVAL for a
+     *         line that is not a trace event
+     */
+    bool load(const std::string &path, const std::string &bus = "")
+    {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        LineReader in(fd);
+        std::string line;
+        bool ok = true;
+        while (ok && in.readLine(line))
+            ok = add(line, bus);
+        ::close(fd);
+        if (!ok) {
+            errno = EINVAL;
+            return false;
+        }
+        finish();
+        return true;
+    }
+
+    /**
+     * @brief Adds one trace line, see load(); finish() when all are in.
+     *
+     * @return false if it is not a trace event
+     */
+    bool add(std::string_view line, const std::string &bus = "")
+    {
+        Fields f;
+        if (!parse(line, f) || f["bus"].size() != 1 ||
+            f["ev"].size() != 1)
+            return false;
+        const std::string &label = f["bus"][0];
+        if (bus_.empty())
+            bus_ = bus.empty() ? label : bus;
+        if (label != bus_ && label.rfind(bus_ + "#", 0) != 0)
+            return true;
+
+        const std::string &ev = f["ev"][0];
+        const long us = f["us"].empty() ? 0
+                                        : std::atol(f["us"][0].c_str());
+        using Kind = Exchange::Kind;
+        if (ev == "probe" || ev == "assign") {
+            const char *sent = ev == "probe" ? "pattern" : "uid";
+            if (f[sent].size() != 1 || f["resp"].size() != 1)
+                return false;
+            exchanges_.push_back({ev == "probe" ? Kind::Probe
+                : Kind::Assign, f[sent], f["resp"], us});
+        } else if (ev == "window") {
+            if (f["patterns"].size() != f["resp"].size())
+                return false;
+            exchanges_.push_back({Kind::Window, f["patterns"], f["resp"],
+                us});
+        } else if (ev == "assign_later") {
+            exchanges_.push_back({Kind::AssignLater, f["uid"], {}, 0});
+        } else if (ev == "settle") {
+            exchanges_.push_back({Kind::Settle, {}, f["failed"], us});
+        } else if (ev == "reset") {
+            exchanges_.push_back({Kind::Reset, {}, {}, 0});
+        } else if (ev == "found") {
+            found_.insert(f["uid"].begin(), f["uid"].end());
+        } else if (ev == "retracted") {
+            retracted_.insert(f["uid"].begin(), f["uid"].end());
+        } else if (ev == "scan" && f["prefix"].size() == 1 &&
+            std::find(prefixes_.begin(), prefixes_.end(),
+                f["prefix"][0]) == prefixes_.end()) {
+            prefixes_.push_back(f["prefix"][0]);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Derives uids() and latency() from the lines added.
+     */
+    void finish()
+    {
+        std::set<std::string> uids;
+        for (const auto &uid : found_) {
+            if (!retracted_.count(uid))
+                uids.insert(uid);
+        }
+        Histogram probe, miss, window, assign, settle;
+        for (const auto &e : exchanges_) {
+            switch (e.kind) {
+            case Exchange::Probe:
+                (e.resp.at(0).empty() ? miss : probe).record(us(e));
+                break;
+            case Exchange::Window:
+                window.record(us(e));
+                break;
+            case Exchange::Assign:
+                assign.record(us(e));
+                if (e.resp.at(0) == e.sent.at(0))
+                    uids.insert(e.sent[0]);
+                break;
+            case Exchange::Settle:
+                settle.record(us(e));
+                break;
+            default:
+                break;
+            }
+        }
+        uids_.assign(uids.begin(), uids.end());
+        latency_.probe = static_cast<long>(probe.percentile(50));
+        latency_.miss = static_cast<long>(miss.percentile(50));
+        latency_.window = static_cast<long>(window.percentile(50));
+        // a round trip with an answer, for what was never waited for
+        const long trip = latency_.probe > 0 ? latency_.probe
+                                             : latency_.window;
+        latency_.assign = assign.count()
+            ? static_cast<long>(assign.percentile(50)) : trip;
+        latency_.settle = settle.count()
+            ? static_cast<long>(settle.percentile(50)) : trip;
+    }
+
+    const std::string &bus() const { return bus_; }
+    const std::vector<Exchange> &exchanges() const { return exchanges_; }
+    const std::vector<std::string> &uids() const { return uids_; }
+    const std::vector<std::string> &prefixes() const { return prefixes_; }
+    const Latency &latency() const { return latency_; }
+
+    /**
+     * @return true if the recorded scan sent windows
+     */
+    bool pipelined() const
+    {
+        return std::any_of(exchanges_.begin(), exchanges_.end(),
+            [](const Exchange &e) { return e.kind == Exchange::Window; });
+    }
+
+private:
+    // a value, or the strings of an array
+    using Fields = std::map<std::string, std::vector<std::string>>;
+
+    static uint64_t us(const Exchange &e)
+    {
+        return static_cast<uint64_t>(std::max(0L, e.us));
+    }
+
+    /**
+     * a flat JSON object the way TraceSink writes it: strings, integers
+     * and arrays of strings
+     */
+    static bool parse(std::string_view s, Fields &f)
+    {
+        size_t i = 0;
+        auto skip = [&]() {
+            while (i < s.size() && (s[i] == ' ' || s[i] == '\t'))
+                ++i;
+        };
+        auto eat = [&](char c) {
+            skip();
+            if (i >= s.size() || s[i] != c)
+                return false;
+            ++i;
+            return true;
+        };
+        if (!eat('{'))
+            return false;
+        if (eat('}'))
+            return true;
+        do {
+            std::string key;
+            skip();
+            if (!quoted(s, i, key) || !eat(':'))
+                return false;
+            std::vector<std::string> &value = f[key];
+            value.clear();
+            skip();
+            if (eat('[')) {
+                if (!eat(']')) {
+                    do {
+                        skip();
+                        value.emplace_back();
+                        if (!quoted(s, i, value.back()))
+                            return false;
+                    } while (eat(','));
+                    if (!eat(']'))
+                        return false;
+                }
+            } else if (i < s.size() && s[i] == '"') {
+                value.emplace_back();
+                if (!quoted(s, i, value.back()))
+                    return false;
+            } else {
+                const size_t start = i;
+                while (i < s.size() && (s[i] == '-' ||
+                    (s[i] >= '0' && s[i] <= '9')))
+                    ++i;
+                if (i == start)
+                    return false;
+                value.emplace_back(s.substr(start, i - start));
+            }
+        } while (eat(','));
+        return eat('}');
+    }
+
+    /**
+     * a quoted string at `s[i]`, escapes as TraceSink writes them
+     */
+    static bool quoted(std::string_view s, size_t &i, std::string &out)
+    {
+        if (i >= s.size() || s[i] != '"')
+            return false;
+        for (++i; i < s.size(); ++i) {
+            char c = s[i];
+            if (c == '"') {
+                ++i;
+                return true;
+            }
+            if (c == '\\') {
+                if (++i >= s.size())
+                    return false;
+                c = s[i];
+                if (c == 'u') {
+                    if (i + 4 >= s.size())
+                        return false;
+                    c = static_cast<char>(std::strtol(
+                        std::string(s.substr(i + 1, 4)).c_str(),
+                        nullptr, 16));
+                    i += 4;
+                }
+            }
+            out.push_back(c);
+        }
+        return false;
+    }
+
+    std::string bus_;
+    std::vector<Exchange> exchanges_;
+    std::set<std::string> found_;
+    std::set<std::string> retracted_;
+    std::vector<std::string> prefixes_;
+    std::vector<std::string> uids_;
+    Latency latency_;
+};
+
+/**
+ * @class ReplayLink
+ * @brief ScanLink serving a Recording back, on a simulated clock.
+ *
+ * As long as the scan sends what was recorded, in the recorded order,
+ * every exchange is answered with the recorded response and costs the
+ * recorded latency: the same strategy replays the recorded scan
+ * exactly. From the first exchange that differs on, a UidBus over the
+ * UIDs of the recording answers instead, and latencies come from
+ * Recording::latency(); a window on a recording without windows costs
+ * its slowest member. The bus is kept up to date with every exchange
+ * either way, so it knows what is muted at the point of departure.
+ *
+ * elapsedUs() is the time the scan would have taken on the recorded
+ * bus, for comparing strategies without it.
+ */
+class ReplayLink : public ScanLink {
+public:
+    explicit ReplayLink(const Recording &rec) :
+        rec_(rec),
+        bus_(rec.uids()),
+        sim_(bus_),
+        pipelined_(rec.pipelined())
+    {
+        bus_.setLog(nullptr);
+    }
+
+    /**
+     * @brief Whether probeWindow() puts windows on the wire or sends
+     *        them one by one. Defaults to the recording's.
+     */
+    void setPipelined(bool on) { pipelined_ = on; }
+
+    /**
+     * @brief Cost of a probe without answer when the recording has none
+     *        to go by, as one made with pipelined windows. Default 0.
+     */
+    void setTimeoutUs(long us) { timeout_ = us; }
+
+    std::string probe(const std::string &pattern) override
+    {
+        ++probes_;
+        ++trips_;
+        std::string resp = sim_.probe(pattern);
+        if (const Exchange *e = next(Exchange::Probe, {pattern})) {
+            elapsed_ += e->us;
+            return e->resp.at(0);
+        }
+        elapsed_ += resp.empty() ? miss() : rec_.latency().probe;
+        return resp;
+    }
+
+    std::vector<std::string> probeWindow(
+        const std::vector<std::string> &patterns) override
+    {
+        if (!pipelined_)
+            return ScanLink::probeWindow(patterns);
+        probes_ += patterns.size();
+        ++trips_;
+        std::vector<std::string> resp;
+        long slowest = 0;
+        for (const auto &p : patterns) {
+            resp.push_back(sim_.probe(p));
+            slowest = std::max(slowest, resp.back().empty()
+                ? miss() : rec_.latency().probe);
+        }
+        if (const Exchange *e = next(Exchange::Window, patterns)) {
+            elapsed_ += e->us;
+            return e->resp;
+        }
+        elapsed_ += rec_.latency().window > 0 ? rec_.latency().window
+                                              : slowest;
+        return resp;
+    }
+
+    bool pipelined() const override { return pipelined_; }
+
+    std::string assign(const std::string &uid) override
+    {
+        ++trips_;
+        std::string resp = sim_.assign(uid);
+        if (const Exchange *e = next(Exchange::Assign, {uid})) {
+            elapsed_ += e->us;
+            return e->resp.at(0);
+        }
+        elapsed_ += rec_.latency().assign;
+        return resp;
+    }
+
+    /**
+     * the bus has the verdict, recorded or not: the recording only
+     * tells it in the settle() that reports it
+     */
+    void assignLater(const std::string &uid) override
+    {
+        if (sim_.assign(uid) != uid)
+            unconfirmed_.push_back(uid);
+        next(Exchange::AssignLater, {uid});
+    }
+
+    std::vector<std::string> settle(bool wait = true) override
+    {
+        std::vector<std::string> failed;
+        failed.swap(unconfirmed_);
+        // an early settle is only traced if it reports something
+        if (wait || !failed.empty()) {
+            ++trips_;
+            const Exchange *e = next(Exchange::Settle, {});
+            elapsed_ += e ? e->us : rec_.latency().settle;
+        }
+        return failed;
+    }
+
+    void resetAll() override
+    {
+        sim_.resetAll();
+        next(Exchange::Reset, {});
+    }
+
+    /**
+     * @return simulated time spent on the bus so far
+     */
+    long elapsedUs() const { return elapsed_; }
+
+    /**
+     * @return patterns sent, window members included
+     */
+    size_t probes() const { return probes_; }
+
+    /**
+     * @return exchanges waited for: single probes, windows, SETADDRs
+     *         and settles
+     */
+    size_t roundTrips() const { return trips_; }
+
+    /**
+     * @return exchanges served from the recording
+     */
+    size_t replayed() const { return cursor_; }
+
+    /**
+     * @return false once the scan left the recorded sequence
+     */
+    bool inStep() const { return inStep_; }
+
+private:
+    using Exchange = Recording::Exchange;
+
+    long miss() const
+    {
+        return rec_.latency().miss > 0 ? rec_.latency().miss : timeout_;
+    }
+
+    /**
+     * the recorded exchange the scan is at, if it is the one sent now
+     */
+    const Exchange *next(Exchange::Kind kind,
+        const std::vector<std::string> &sent)
+    {
+        const auto &all = rec_.exchanges();
+        if (inStep_ && cursor_ < all.size() &&
+            all[cursor_].kind == kind && all[cursor_].sent == sent)
+            return &all[cursor_++];
+        inStep_ = false;
+        return nullptr;
+    }
+
+    const Recording &rec_;
+    UidBus bus_;
+    SimLink sim_;
+    bool pipelined_;
+    size_t cursor_ = 0;
+    bool inStep_ = true;
+    long elapsed_ = 0;
+    size_t probes_ = 0;
+    size_t trips_ = 0;
+    long timeout_ = 0;
+    std::vector<std::string> unconfirmed_;
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+/**
+ * @class RttEstimator
+ * @brief Adaptive no-answer timeout from observed response latencies.
+ *
+ * Keeps a smoothed latency and its variation the way TCP does
+ * (RFC 6298: SRTT, RTTVAR, alpha = 1/8, beta = 1/4) plus the p99 of the
+ * most recent samples. The timeout is the larger of SRTT + 4 * RTTVAR
+ * and twice the p99, clamped to [floor, ceiling]. Until enough samples
+ * are in it stays at the ceiling, i.e. the configured fixed timeout.
+ *
+ * Slow links are handled by backing off: a reply that arrives after the
+ * wait gave up (late()) or close to the limit doubles the timeout, and
+ * the factor decays again after a run of clean samples.
+ */
+class RttEstimator {
+public:
+    /**
+     * @param floorMs   Smallest timeout ever used.
+     * @param ceilingMs Largest timeout, also used while warming up.
+     */
+    RttEstimator(int floorMs, int ceilingMs) :
+        floor_(std::max(1, std::min(floorMs, ceilingMs))),
+        ceiling_(std::max(1, ceilingMs))
+    {
+    }
+
+    /**
+     * @brief Records the latency of a reply that arrived in time.
+     */
+    void sample(double ms)
+    {
+        ms = std::max(0.0, ms);
+        const int limit = timeout(); // what this reply had to beat
+        if (count_ == 0) {
+            srtt_ = ms;
+            rttvar_ = ms / 2;
+        } else {
+            rttvar_ = 0.75 * rttvar_ + 0.25 * std::fabs(srtt_ - ms);
+            srtt_ = 0.875 * srtt_ + 0.125 * ms;
+        }
+        recent_[count_ % recent_.size()] = ms;
+        ++count_;
+        p99Valid_ = false;
+
+        if (count_ > WARMUP && ms > 0.75 * limit) {
+            backOff();
+        } else if (++clean_ >= DECAY_AFTER && backoff_ > 1) {
+            backoff_ /= 2;
+            clean_ = 0;
+        }
+    }
+
+    /**
+     * @brief A reply showed up after its wait had already timed out.
+     */
+    void late() { backOff(); }
+
+    /**
+     * @return how long to wait for a reply, in ms
+     */
+    int timeout() const
+    {
+        if (count_ < WARMUP)
+            return ceiling_;
+        double t = std::max(srtt_ + 4 * rttvar_, 2 * p99()) * backoff_;
+        return std::clamp(static_cast<int>(std::ceil(t)), floor_,
+            ceiling_);
+    }
+
+    size_t samples() const { return count_; }
+    double srtt() const { return srtt_; }
+    double rttvar() const { return rttvar_; }
+
+    /**
+     * @return 99th percentile of the most recent samples
+     */
+    double p99() const
+    {
+        if (!p99Valid_) {
+            size_t n = std::min(count_, recent_.size());
+            std::array<double, WINDOW> sorted;
+            std::copy(recent_.begin(), recent_.begin() + n,
+                sorted.begin());
+            size_t k = (n * 99) / 100;
+            std::nth_element(sorted.begin(), sorted.begin() + k,
+                sorted.begin() + n);
+            p99_ = n ? sorted[k] : 0.0;
+            p99Valid_ = true;
+        }
+        return p99_;
+    }
+
+private:
+    static constexpr size_t WARMUP = 8;
+    static constexpr size_t WINDOW = 128;
+    static constexpr size_t DECAY_AFTER = 32;
+    static constexpr int MAX_BACKOFF = 64;
+
+    void backOff()
+    {
+        backoff_ = std::min(backoff_ * 2, MAX_BACKOFF);
+        clean_ = 0;
+    }
+
+    int floor_;
+    int ceiling_;
+    double srtt_ = 0;
+    double rttvar_ = 0;
+    size_t count_ = 0;
+    size_t clean_ = 0;
+    int backoff_ = 1;
+    std::array<double, WINDOW> recent_{};
+    mutable double p99_ = 0;
+    mutable bool p99Valid_ = false;
+};
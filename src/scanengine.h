@@ -0,0 +1,768 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "symbolplan.h"
+#include "uidformat.h"
+
+constexpr int MAXLEN = AisgUid::BODY; // uid length w/o prefix
+constexpr std::string_view CHARSET = AisgUid::CHARSET;
+
+/**
+ * @brief return reversed string
+ *
+ * we use reverse strings in algorithm because it's much more easier to
+ * append symbols to string than insert them to beginning. this
+ * `reverse_string` used before sending
+ */
+inline std::string reverse_string(const std::string &line)
+{
+    return std::string(line.rbegin(), line.rend());
+}
+
+/**
+ * @class ScanLink
+ * @brief Transport between the scan engine and a bus.
+ *
+ * Responses are encoded the way uidscan always did: an empty string if
+ * nobody answered, "!" for an empty line (a collision, "!" is not a
+ * valid symbol in any response), otherwise the received line.
+ */
+class ScanLink {
+public:
+    virtual ~ScanLink() = default;
+
+    /**
+     * @brief Sends one pattern and waits for its response.
+     */
+    virtual std::string probe(const std::string &pattern) = 0;
+
+    /**
+     * @brief Sends several independent patterns, returns one response
+     *        per pattern.
+     *
+     * The default sends them one after another; pipelined links put
+     * them on the wire at once.
+     */
+    virtual std::vector<std::string> probeWindow(
+        const std::vector<std::string> &patterns)
+    {
+        std::vector<std::string> resp;
+        for (const auto &p : patterns)
+            resp.push_back(probe(p));
+        return resp;
+    }
+
+    /**
+     * @return true if probeWindow() is cheaper than single probes
+     */
+    virtual bool pipelined() const { return false; }
+
+    /**
+     * @brief "Assigns" an address (SETADDR), so the UID stops
+     *        responding, and waits for the device to confirm.
+     *
+     * @return confirmation read back, encoded like probe() responses
+     */
+    virtual std::string assign(const std::string &uid) = 0;
+
+    /**
+     * @brief Like assign(), without waiting: the device is muted for
+     *        every probe sent afterwards, its confirmation is checked
+     *        by settle().
+     *
+     * The default assigns at once and keeps the verdict for settle().
+     */
+    virtual void assignLater(const std::string &uid)
+    {
+        if (assign(uid) != uid)
+            unconfirmed_.push_back(uid);
+    }
+
+    /**
+     * @brief Reports assignLater() calls known not to be confirmed,
+     *        each once.
+     *
+     * @param wait Wait for all outstanding confirmations first;
+     *             otherwise only report what the replies read so far
+     *             tell.
+     * @return the UIDs that were not confirmed
+     */
+    virtual std::vector<std::string> settle(bool wait = true)
+    {
+        (void)wait;
+        std::vector<std::string> failed;
+        failed.swap(unconfirmed_);
+        return failed;
+    }
+
+    /**
+     * @brief Lets every device respond again (RESETALL).
+     */
+    virtual void resetAll() = 0;
+
+    /**
+     * @brief Asks the responder for a response mode (`MODE:<mode>`, see
+     *        UidBus), e.g. `FASTCOLLISION`.
+     *
+     * The default sends it like a pattern: one that does not know the
+     * mode, or the command, stays silent, which costs a timeout.
+     *
+     * @return true if the responder switched
+     */
+    virtual bool setMode(const std::string &mode)
+    {
+        const std::string command = "MODE:" + mode;
+        return probe(command) == command;
+    }
+
+private:
+    std::vector<std::string> unconfirmed_;
+};
+
+/**
+ * @class ScanObserver
+ * @brief Receives notable scan events; all hooks default to no-ops.
+ */
+class ScanObserver {
+public:
+    virtual ~ScanObserver() = default;
+
+    virtual void collision(const std::string &pattern, size_t level)
+    {
+        (void)pattern;
+        (void)level;
+    }
+    virtual void found(const std::string &uid) { (void)uid; }
+    virtual void depthLimit(const std::string &pattern)
+    {
+        (void)pattern;
+    }
+    /**
+     * @brief A UID reported found() was not confirmed after all, see
+     *        ScanEngine::Confirm.
+     */
+    virtual void retracted(const std::string &uid) { (void)uid; }
+};
+
+/**
+ * @class ScanEngine
+ * @brief Iterative form of the uidscan tree walk.
+ *
+ * The search state lives in a preallocated stack of MAXLEN + 1 frames,
+ * one per tree level, instead of in recursion and a function-local
+ * static. Every step() processes exactly one response, so a caller can
+ * run an engine to completion, interleave engines for several
+ * prefixes, stop early or take a checkpoint() to restore() later.
+ *
+ * Walk (unchanged from the recursive scan()): level 0 probes the prefix
+ * alone, every deeper level tries the CHARSET extensions of its node.
+ * A SymbolPlan may narrow and reorder the symbols tried per level, and
+ * collision hints (setCollisionHints()) reorder or narrow the children
+ * of a collided node by what its collision response tells.
+ * On a collision the engine descends. A UID found below level 1 sends
+ * the walk back up one level, where the collided node is probed again:
+ * if only one UID remained there it answers at once.
+ *
+ * A response that looks like a UID is confirmed the way setConfirm()
+ * says: by default with a blocking SETADDR echo, otherwise muted right
+ * away and checked, together with all others, once the walk is done.
+ */
+class ScanEngine {
+public:
+    /**
+     * @brief What a collision response reveals about the UIDs behind it.
+     *
+     * - None   nothing; every collision is a bare "!"
+     * - Mixed  uidresp `mixed`: the first MIXED_COLUMNS characters are
+     *          taken from a colliding UID, the rest is random. A symbol
+     *          seen there is probed first
+     * - Or     wired-OR bus (uidresp `or`): every character is the
+     *          bitwise OR of the colliding UIDs' ones. Only symbols
+     *          whose bits it covers are probed, exact ones first. As
+     *          such an OR can look like a valid UID, a node that
+     *          answered with a UID is probed again
+     */
+    enum class CollisionHints { None, Mixed, Or };
+
+    /**
+     * @brief How a response that looks like a UID is confirmed.
+     *
+     * - Echo      SETADDR, then wait for the device to echo its UID; a
+     *             response made up by a collision costs a timeout
+     * - None      SETADDR without waiting, no check: for buses whose
+     *             collisions never look like a UID (`empty` profile)
+     * - Crc       only UIDs ending in their AisgUid::checkSymbol() are
+     *             taken, then as Deferred
+     * - Deferred  SETADDR without waiting. The echo comes back before
+     *             the reply to the next probe, so the walk learns of a
+     *             missing one without a round trip of its own; what is
+     *             still open when a level-1 walk ends is waited for with
+     *             a single SYNC. A UID without echo is retracted, its
+     *             node taken for the collision it was and walked below
+     */
+    enum class Confirm { Echo, None, Crc, Deferred };
+
+    static constexpr int MAX_RESCANS = 4;
+
+    static constexpr size_t MIXED_COLUMNS = 5;
+
+    /**
+     * @brief Saved position of an engine, see checkpoint().
+     */
+    struct Checkpoint {
+        struct FrameState {
+            size_t len;
+            size_t pos;
+            size_t inner;
+            bool reprobe;
+            std::string symbols;
+            std::string childSymbols;
+        };
+
+        std::string prefix;
+        std::string node;
+        std::vector<FrameState> frames;
+        std::vector<std::string> symbols; // per node length
+    };
+
+    /**
+     * @param link  Bus to scan.
+     * @param found Set that receives confirmed UIDs; may be shared
+     *              between engines.
+     */
+    ScanEngine(ScanLink &link, std::set<std::string> &found) :
+        link_(link),
+        found_(found)
+    {
+    }
+
+    void setObserver(ScanObserver *observer) { observer_ = observer; }
+
+    /**
+     * @brief Takes the symbols of every level from `plan` (charset and
+     *        order, fixed when a scan starts) and teaches it every
+     *        UID found. Without a plan all of CHARSET is tried.
+     */
+    void setSymbolPlan(SymbolPlan *plan) { plan_ = plan; }
+
+    /**
+     * @brief Trusts collision responses to follow `hints`. Mind that Or
+     *        skips symbols: a bus that does not OR may lose UIDs.
+     */
+    void setCollisionHints(CollisionHints hints) { hints_ = hints; }
+
+    void setConfirm(Confirm confirm) { confirm_ = confirm; }
+
+    /**
+     * @brief Limits how deep the walk may go; nodes at `depth` pattern
+     *        characters (not counting the prefix) are not expanded.
+     *        Defaults to, and never exceeds, MAXLEN.
+     */
+    void setDepthLimit(size_t depth)
+    {
+        depthLimit_ = std::min<size_t>(depth, MAXLEN);
+    }
+
+    /**
+     * @brief Begins a scan of one vendor prefix, or of the subtree below
+     *        `node` only (scan order, i.e. the UID's last symbols
+     *        reversed). The node itself is probed first, like the
+     *        prefix alone otherwise.
+     */
+    void start(const std::string &pfx, const std::string &node = "")
+    {
+        if (pfx != pfx_) {
+            collided_.clear();
+            candidates_.clear();
+        }
+        pfx_ = pfx;
+        setNode(node.substr(0, MAXLEN));
+        top_ = 0;
+        for (size_t len = 0; len < symbols_.size(); ++len) {
+            symbols_[len] = plan_ ? plan_->symbols(pfx, len)
+                                  : std::string(CHARSET);
+        }
+        push(node_.size(), 0, true, symbols_[node_.size()]);
+    }
+
+    /**
+     * @return true once the scan started last has finished
+     */
+    bool done() const { return top_ == 0; }
+
+    /**
+     * @brief Processes one response.
+     *
+     * @return false when there is nothing left to do
+     */
+    bool step()
+    {
+        if (top_ == 0)
+            return false;
+
+        Frame &f = frames_[top_ - 1];
+        const size_t level = top_ - 1;
+        if (f.pos >= f.symbols.size()) {
+            if (!candidates_.empty() && level <= 1)
+                retract(link_.settle(true));
+            if (!f.revisit.empty()) {
+                // a node taken for a uid in passing: walk below it now
+                f.pos = f.revisit.back();
+                f.revisit.pop_back();
+                f.revisiting = true;
+                f.reprobe = true;
+                f.inner = 0;
+                return true;
+            }
+            finish(f.pos);
+            return top_ > 0;
+        }
+
+        truncate(f.len);
+        if (!f.root)
+            extend(f.symbols[f.pos]);
+        const std::string resp = response(f);
+        if (!candidates_.empty())
+            retract(link_.settle(false));
+
+        if (f.root)
+            f.pos = f.symbols.size(); // the prefix is probed only once
+
+        // timeout, i.e. no answer
+        if (resp.empty()) {
+            f.inner = 0;
+            advance(f);
+            return true;
+        }
+
+        if (collided_.count(pattern()) || collision(resp, pattern())) {
+            if (observer_)
+                observer_->collision(pattern(), level);
+
+            // the order below a node is chosen once, at its first
+            // collision, so a later descent resumes in the same order
+            if (f.inner == 0)
+                childSymbols(resp, f.childSymbols);
+            if (f.inner >= f.childSymbols.size()) {
+                f.inner = 0;
+                advance(f);
+                return true;
+            }
+
+            // the collided node is probed again once its subtree returns
+            f.reprobe = true;
+            if (node_.size() >= depthLimit_) {
+                if (observer_)
+                    observer_->depthLimit(pattern());
+                f.inner = SIZE_MAX;
+                return true;
+            }
+            push(node_.size(), f.inner, false, f.childSymbols);
+            return true;
+        }
+
+        if (found_.insert(resp).second) {
+            if (confirm_ == Confirm::Crc || confirm_ == Confirm::Deferred)
+                candidates_[resp] = {pattern(), level,
+                    f.root ? 0 : f.pos, f.gen};
+            if (plan_)
+                plan_->learn(resp);
+            if (observer_)
+                observer_->found(resp);
+            if (level > 1) {
+                finish(f.pos);
+                return top_ > 0;
+            }
+            f.inner = 0;
+            if (hints_ == CollisionHints::Or) {
+                // an OR of several uids may read as a uid of its own:
+                // ask again until the node is quiet
+                f.reprobe = true;
+                return true;
+            }
+        }
+        advance(f);
+        return true;
+    }
+
+    /**
+     * @brief Runs the current scan to the end.
+     */
+    void run()
+    {
+        while (step()) {
+        }
+    }
+
+    /**
+     * @brief Scans one prefix (or one subtree, see start()) completely,
+     *        deferred confirmations included.
+     */
+    void scan(const std::string &pfx, const std::string &node = "")
+    {
+        start(pfx, node);
+        run();
+        for (int pass = 0; pass < MAX_RESCANS && settle(); ++pass) {
+            start(pfx, node);
+            run();
+        }
+    }
+
+    /**
+     * @brief Waits for the confirmations not waited for yet (Confirm
+     *        other than Echo) and retracts the UIDs without one.
+     *
+     * @return true if a UID was retracted after the walk: it may hide
+     *         devices, so the walk has to be repeated
+     */
+    bool settle()
+    {
+        if (confirm_ == Confirm::Echo)
+            return false;
+        return retract(link_.settle(true)) > 0;
+    }
+
+    /**
+     * @brief Confirms UIDs known from an earlier scan, without a walk.
+     *
+     * A full UID is a pattern only that device matches, so every known
+     * UID costs one probe (all of them in one window on a pipelined
+     * link) and, if it answers, the assign that mutes it. Confirmed
+     * UIDs go to the found set like discovered ones; a scan started
+     * afterwards only has the rest to find.
+     *
+     * @return number of UIDs confirmed
+     */
+    size_t verify(const std::vector<std::string> &uids)
+    {
+        std::vector<std::string> resp;
+        if (link_.pipelined()) {
+            resp = link_.probeWindow(uids);
+        } else {
+            for (const auto &uid : uids)
+                resp.push_back(link_.probe(uid));
+        }
+
+        std::vector<std::string> confirmed;
+        for (size_t i = 0; i < uids.size() && i < resp.size(); ++i) {
+            if (resp[i] != uids[i] || collision(resp[i], uids[i]))
+                continue;
+            confirmed.push_back(resp[i]);
+            if (found_.insert(resp[i]).second) {
+                if (plan_)
+                    plan_->learn(resp[i]);
+                if (observer_)
+                    observer_->found(resp[i]);
+            }
+        }
+        settle();
+        return std::count_if(confirmed.begin(), confirmed.end(),
+            [&](const std::string &uid) { return found_.count(uid); });
+    }
+
+    /**
+     * @return the pattern most recently probed, prefix included
+     */
+    const std::string &pattern() const { return wire_; }
+
+    /**
+     * @return number of active frames (0 when done)
+     */
+    size_t depth() const { return top_; }
+
+    Checkpoint checkpoint() const
+    {
+        Checkpoint c;
+        c.prefix = pfx_;
+        c.node = node_;
+        for (size_t i = 0; i < top_; ++i)
+            c.frames.push_back({frames_[i].len, frames_[i].pos,
+                frames_[i].inner, frames_[i].reprobe, frames_[i].symbols,
+                frames_[i].childSymbols});
+        c.symbols.assign(symbols_.begin(), symbols_.end());
+        return c;
+    }
+
+    /**
+     * @brief Continues from a checkpoint. Pipelined windows are not
+     *        part of it and get requested again.
+     *
+     * @return false if the checkpoint does not fit this engine
+     */
+    bool restore(const Checkpoint &c)
+    {
+        if (c.frames.size() > frames_.size() || c.node.size() > MAXLEN ||
+            (!c.symbols.empty() && c.symbols.size() != symbols_.size()))
+            return false;
+        for (char ch : c.node) {
+            if (!AisgUid::isSymbol(ch))
+                return false;
+        }
+        for (size_t len = 0; len < symbols_.size(); ++len) {
+            symbols_[len] = c.symbols.empty() ? std::string(CHARSET)
+                                              : c.symbols[len];
+        }
+        pfx_ = c.prefix;
+        setNode(c.node);
+        top_ = 0;
+        for (const auto &fs : c.frames) {
+            for (char ch : fs.symbols + fs.childSymbols) {
+                if (!AisgUid::isSymbol(ch))
+                    return false;
+            }
+            push(fs.len, fs.pos, top_ == 0, fs.symbols);
+            frames_[top_ - 1].inner = fs.inner;
+            frames_[top_ - 1].reprobe = fs.reprobe;
+            frames_[top_ - 1].childSymbols = fs.childSymbols;
+        }
+        return true;
+    }
+
+private:
+    struct Frame {
+        size_t len = 0;        // length of the node pattern
+        size_t pos = 0;        // symbols index of the next probe
+        size_t inner = 0;      // childSymbols index the descent resumes
+        bool reprobe = false;  // next probe must go out fresh
+        bool root = false;     // level 0: probe the prefix alone
+        bool needWindow = false;
+        size_t windowBase = 0;
+        std::vector<std::string> window;
+        std::string symbols;      // tried here, in this order
+        std::string childSymbols; // below the node collided last
+        unsigned long gen = 0;    // tells the frames of a level apart
+        std::vector<size_t> revisit; // positions of retracted uids
+        bool revisiting = false;  // back at one, continue at the end
+    };
+
+    /**
+     * a uid not confirmed on the spot, and where the walk met it
+     */
+    struct Candidate {
+        std::string pattern;
+        size_t level;
+        size_t pos;
+        unsigned long gen;
+    };
+
+    void push(size_t len, size_t pos, bool root,
+        const std::string &symbols)
+    {
+        Frame &f = frames_[top_++];
+        f.symbols = symbols;
+        f.len = len;
+        f.pos = pos;
+        f.inner = 0;
+        f.reprobe = false;
+        f.root = root;
+        f.needWindow = !root && link_.pipelined();
+        f.window.clear();
+        f.gen = ++gen_;
+        f.revisit.clear();
+        f.revisiting = false;
+    }
+
+    /**
+     * on to the next symbol of `f`, or, back at a retracted node, to
+     * where `f` was before
+     */
+    void advance(Frame &f)
+    {
+        if (f.revisiting) {
+            f.revisiting = false;
+            f.pos = f.symbols.size();
+            return;
+        }
+        f.pos++;
+    }
+
+    /**
+     * forgets the uids of `failed` again: their nodes collided after
+     * all. a node whose frame is still active is walked once that
+     * frame is through, a left one when its parent probes it again
+     *
+     * @return number of uids retracted whose node is left for good
+     */
+    size_t retract(const std::vector<std::string> &failed)
+    {
+        size_t lost = 0;
+        for (const auto &uid : failed) {
+            if (confirm_ == Confirm::None || !found_.erase(uid))
+                continue;
+            if (observer_)
+                observer_->retracted(uid);
+            auto it = candidates_.find(uid);
+            if (it == candidates_.end()) {
+                ++lost;
+                continue;
+            }
+            const Candidate &c = it->second;
+            collided_.insert(c.pattern);
+            if (c.level < top_ && frames_[c.level].gen == c.gen)
+                frames_[c.level].revisit.push_back(c.pos);
+            else if (c.level <= 1 || top_ == 0)
+                ++lost;
+            candidates_.erase(it);
+        }
+        return lost;
+    }
+
+    /**
+     * the node and, in wire_, the pattern to probe. the pattern has the
+     * node reversed behind the prefix, so the walk going one level
+     * deeper or back up only inserts or erases right after the prefix;
+     * both buffers keep their capacity
+     */
+    void setNode(const std::string &node)
+    {
+        node_.reserve(MAXLEN);
+        wire_.reserve(pfx_.size() + MAXLEN);
+        node_ = node;
+        wire_.assign(pfx_);
+        wire_.append(node.rbegin(), node.rend());
+    }
+
+    void truncate(size_t len)
+    {
+        if (len >= node_.size())
+            return;
+        wire_.erase(pfx_.size(), node_.size() - len);
+        node_.resize(len);
+    }
+
+    void extend(char sym)
+    {
+        node_.push_back(sym);
+        wire_.insert(wire_.begin() + static_cast<long>(pfx_.size()), sym);
+    }
+
+    /**
+     * pops the top frame; its parent resumes its next descent at `pos`
+     */
+    void finish(size_t pos)
+    {
+        --top_;
+        if (top_ > 0)
+            frames_[top_ - 1].inner = pos;
+    }
+
+    /**
+     * response for the node in `node_`. pipelined links get all
+     * remaining siblings at once: siblings match disjoint sets of UIDs
+     * and everything muted below one of them belongs to that one, so the
+     * replies stay valid while the walk goes on. only a re-probe has to
+     * go out again
+     */
+    std::string response(Frame &f)
+    {
+        if (f.reprobe) {
+            f.reprobe = false;
+            return link_.probe(pattern());
+        }
+
+        if (f.needWindow) {
+            // the siblings differ from the pattern right after the
+            // prefix only; the strings of the last window are reused
+            f.needWindow = false;
+            patterns_.resize(f.symbols.size() - f.pos);
+            for (size_t i = f.pos; i < f.symbols.size(); ++i) {
+                std::string &p = patterns_[i - f.pos];
+                p.assign(wire_);
+                p[pfx_.size()] = f.symbols[i];
+            }
+            f.window = link_.probeWindow(patterns_);
+            f.windowBase = f.pos;
+        }
+
+        if (!f.window.empty() && f.pos >= f.windowBase &&
+            f.pos - f.windowBase < f.window.size())
+            return f.window[f.pos - f.windowBase];
+        return link_.probe(pattern());
+    }
+
+    /**
+     * symbols to try below the node in `node_`, which collided with
+     * `resp`: the plan's ones for that level, reordered or narrowed by
+     * the response character where the next symbol sits in the uid
+     */
+    void childSymbols(const std::string &resp, std::string &out) const
+    {
+        const std::string &base = symbols_[node_.size()];
+        const size_t col = AisgUid::LENGTH - 1 - node_.size();
+        if (hints_ == CollisionHints::None || resp == "!" ||
+            node_.size() >= AisgUid::BODY || col >= resp.size() ||
+            (hints_ == CollisionHints::Mixed && col >= MIXED_COLUMNS)) {
+            out = base;
+            return;
+        }
+
+        const char hint = resp[col];
+        out.clear();
+        if (base.find(hint) != std::string::npos)
+            out.push_back(hint);
+        for (char ch : base) {
+            if (ch == hint)
+                continue;
+            // an OR response holds every bit of every participant
+            if (hints_ == CollisionHints::Or && (ch & ~hint) != 0)
+                continue;
+            out.push_back(ch);
+        }
+        if (out.empty())
+            out = base; // not an OR after all
+    }
+
+    /**
+     * detect collisions by "collision symbol" ("!"), by form (a uid has
+     * the AisgUid length and only CHARSET symbols), by not matching the
+     * `pattern` probed, by naming a uid already found (it is muted, so
+     * a mix of others) and by comparing with the confirmation of the
+     * assigned address, right away or in settle()
+     */
+    bool collision(const std::string &s, const std::string &pattern)
+    {
+        if ((s == "!") || !AisgUid::isUid(s) ||
+            !AisgUid::matches(pattern, s) || found_.count(s))
+            return true;
+        switch (confirm_) {
+        case Confirm::Echo:
+            return link_.assign(s) != s;
+        case Confirm::Crc:
+            if (!AisgUid::isChecked(s))
+                return true;
+            break;
+        case Confirm::None:
+        case Confirm::Deferred:
+            break;
+        }
+        link_.assignLater(s);
+        return false;
+    }
+
+    ScanLink &link_;
+    std::set<std::string> &found_;
+    ScanObserver *observer_ = nullptr;
+    SymbolPlan *plan_ = nullptr;
+    CollisionHints hints_ = CollisionHints::None;
+    Confirm confirm_ = Confirm::Echo;
+    std::set<std::string> collided_; // where retracted uids answered
+    std::map<std::string, Candidate> candidates_;
+    unsigned long gen_ = 0;
+    size_t depthLimit_ = MAXLEN;
+
+    std::string pfx_;
+    std::string node_; // scan order, i.e. reversed on the wire
+    std::string wire_; // pattern(), see setNode()
+    std::vector<std::string> patterns_; // of the last window
+    std::array<Frame, MAXLEN + 1> frames_;
+    std::array<std::string, MAXLEN + 1> symbols_; // per node length
+    size_t top_ = 0;
+};
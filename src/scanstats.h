@@ -0,0 +1,320 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "histogram.h"
+#include "scanengine.h"
+#include "uidformat.h"
+
+/**
+ * @class ScanStats
+ * @brief Counters and latency histograms of a scan, per vendor prefix.
+ *
+ * Filled by a StatsLink (what went over the wire) and a StatsObserver
+ * (what the engine made of it). One instance per bus, as it is not
+ * thread-safe; merge() them for the report.
+ *
+ * - probes          patterns sent, window members included
+ * - windows         pipelined windows, one round trip each
+ * - no answer       probes without a reply; on a line link that is not
+ *                   pipelined each one waited for the full timeout
+ * - collisions      collisions the engine descended into
+ * - confirmations   SETADDRs (the check inside collision()), waited for
+ *                   or deferred; `rejected` the ones answered by another
+ *                   UID or not at all
+ * - retracted       UIDs found but not confirmed later
+ * - latency         answered single probes, whole windows and SETADDR
+ *                   round trips; recorded in ns (in-process links are
+ *                   that fast), reported in us
+ */
+class ScanStats {
+public:
+    struct Prefix {
+        uint64_t probes = 0;
+        uint64_t windows = 0;
+        uint64_t noAnswer = 0;
+        uint64_t collisions = 0;
+        uint64_t confirmations = 0;
+        uint64_t rejected = 0;
+        uint64_t found = 0;
+        uint64_t retracted = 0;
+        Histogram probeNs;
+        Histogram windowNs;
+        Histogram assignNs;
+
+        void merge(const Prefix &o)
+        {
+            probes += o.probes;
+            windows += o.windows;
+            noAnswer += o.noAnswer;
+            collisions += o.collisions;
+            confirmations += o.confirmations;
+            rejected += o.rejected;
+            found += o.found;
+            retracted += o.retracted;
+            probeNs.merge(o.probeNs);
+            windowNs.merge(o.windowNs);
+            assignNs.merge(o.assignNs);
+        }
+
+        /**
+         * @return UIDs found and not retracted
+         */
+        uint64_t uids() const { return found - retracted; }
+
+        double probesPerUid() const
+        {
+            return uids() ? double(probes) / double(uids()) : 0.0;
+        }
+    };
+
+    /**
+     * @return the counters of the vendor prefix `pattern` starts with
+     */
+    Prefix &of(std::string_view pattern)
+    {
+        std::string_view pfx = pattern.substr(0, AisgUid::PREFIX);
+        auto it = prefixes_.find(pfx);
+        if (it == prefixes_.end())
+            it = prefixes_.emplace(std::string(pfx), Prefix()).first;
+        return it->second;
+    }
+
+    const std::map<std::string, Prefix, std::less<>> &prefixes() const
+    {
+        return prefixes_;
+    }
+
+    Prefix total() const
+    {
+        Prefix t;
+        for (const auto &kv : prefixes_)
+            t.merge(kv.second);
+        return t;
+    }
+
+    void merge(const ScanStats &o)
+    {
+        for (const auto &kv : o.prefixes_)
+            of(kv.first).merge(kv.second);
+    }
+
+    /**
+     * @brief Human-readable report, one block per prefix and the total.
+     *
+     * @param seconds Wall time of the scan, for the probe rate.
+     */
+    void writeText(std::ostream &out, double seconds) const
+    {
+        out << "== scan statistics ==\n";
+        const bool one = prefixes_.size() == 1;
+        for (const auto &kv : prefixes_)
+            writeText(out, kv.first, kv.second, one ? seconds : 0);
+        if (!one)
+            writeText(out, "all", total(), seconds);
+    }
+
+    /**
+     * @brief The same as one JSON object:
+     *        `{"seconds":..,"total":{..},"prefixes":{"CB":{..},..}}`
+     */
+    void writeJson(std::ostream &out, double seconds) const
+    {
+        out << "{\"seconds\":" << seconds << ",\"total\":";
+        writeJson(out, total());
+        out << ",\"prefixes\":{";
+        bool first = true;
+        for (const auto &kv : prefixes_) {
+            out << (first ? "" : ",") << "\"" << kv.first << "\":";
+            writeJson(out, kv.second);
+            first = false;
+        }
+        out << "}}\n";
+    }
+
+private:
+    static void writeText(std::ostream &out, std::string_view name,
+        const Prefix &p, double seconds)
+    {
+        out << name << ": " << p.uids() << " found, " << p.probes
+            << " probes (" << p.probesPerUid() << " per uid";
+        if (seconds > 0)
+            out << ", " << static_cast<uint64_t>(p.probes / seconds)
+                << "/s";
+        out << "), " << p.windows << " windows, " << p.noAnswer
+            << " no answer, " << p.collisions << " collisions, "
+            << p.confirmations << " confirmations (" << p.rejected
+            << " rejected)";
+        if (p.retracted)
+            out << ", " << p.retracted << " retracted";
+        out << "\n";
+        writeText(out, "  probe us:   ", p.probeNs);
+        writeText(out, "  window us:  ", p.windowNs);
+        writeText(out, "  setaddr us: ", p.assignNs);
+    }
+
+    static void writeText(std::ostream &out, std::string_view label,
+        const Histogram &h)
+    {
+        if (h.count() == 0)
+            return;
+        out << label;
+        h.writeText(out, 1000);
+        out << "\n";
+    }
+
+    static void writeJson(std::ostream &out, const Prefix &p)
+    {
+        out << "{\"found\":" << p.uids() << ",\"probes\":" << p.probes
+            << ",\"probes_per_uid\":" << p.probesPerUid()
+            << ",\"windows\":" << p.windows << ",\"no_answer\":"
+            << p.noAnswer << ",\"collisions\":" << p.collisions
+            << ",\"confirmations\":" << p.confirmations
+            << ",\"rejected\":" << p.rejected << ",\"retracted\":"
+            << p.retracted << ",\"probe_us\":";
+        p.probeNs.writeJson(out, 1000);
+        out << ",\"window_us\":";
+        p.windowNs.writeJson(out, 1000);
+        out << ",\"setaddr_us\":";
+        p.assignNs.writeJson(out, 1000);
+        out << "}";
+    }
+
+    std::map<std::string, Prefix, std::less<>> prefixes_;
+};
+
+/**
+ * @class StatsLink
+ * @brief ScanLink decorator counting and timing all traffic of a bus in
+ *        a ScanStats.
+ */
+class StatsLink : public ScanLink {
+public:
+    StatsLink(ScanLink &link, ScanStats &stats) :
+        link_(link),
+        stats_(stats)
+    {
+    }
+
+    std::string probe(const std::string &pattern) override
+    {
+        const auto start = clock::now();
+        std::string resp = link_.probe(pattern);
+        ScanStats::Prefix &p = stats_.of(pattern);
+        ++p.probes;
+        if (resp.empty())
+            ++p.noAnswer;
+        else
+            p.probeNs.record(since(start));
+        return resp;
+    }
+
+    std::vector<std::string> probeWindow(
+        const std::vector<std::string> &patterns) override
+    {
+        const auto start = clock::now();
+        std::vector<std::string> resp = link_.probeWindow(patterns);
+        if (patterns.empty())
+            return resp;
+        ScanStats::Prefix &p = stats_.of(patterns[0]);
+        p.windowNs.record(since(start));
+        ++p.windows;
+        p.probes += patterns.size();
+        for (const auto &r : resp)
+            p.noAnswer += r.empty();
+        return resp;
+    }
+
+    bool pipelined() const override { return link_.pipelined(); }
+
+    std::string assign(const std::string &uid) override
+    {
+        const auto start = clock::now();
+        std::string resp = link_.assign(uid);
+        ScanStats::Prefix &p = stats_.of(uid);
+        p.assignNs.record(since(start));
+        ++p.confirmations;
+        p.rejected += resp != uid;
+        return resp;
+    }
+
+    void assignLater(const std::string &uid) override
+    {
+        link_.assignLater(uid);
+        ++stats_.of(uid).confirmations;
+    }
+
+    std::vector<std::string> settle(bool wait = true) override
+    {
+        std::vector<std::string> failed = link_.settle(wait);
+        for (const auto &uid : failed)
+            ++stats_.of(uid).rejected;
+        return failed;
+    }
+
+    void resetAll() override { link_.resetAll(); }
+
+    // no probe of any prefix
+    bool setMode(const std::string &mode) override
+    {
+        return link_.setMode(mode);
+    }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    static uint64_t since(clock::time_point start)
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<
+            std::chrono::nanoseconds>(clock::now() - start).count());
+    }
+
+    ScanLink &link_;
+    ScanStats &stats_;
+};
+
+/**
+ * @class StatsObserver
+ * @brief Counts engine events in a ScanStats and passes them on.
+ */
+class StatsObserver : public ScanObserver {
+public:
+    StatsObserver(ScanObserver &next, ScanStats &stats) :
+        next_(next),
+        stats_(stats)
+    {
+    }
+
+    void collision(const std::string &pattern, size_t level) override
+    {
+        ++stats_.of(pattern).collisions;
+        next_.collision(pattern, level);
+    }
+
+    void found(const std::string &uid) override
+    {
+        ++stats_.of(uid).found;
+        next_.found(uid);
+    }
+
+    void depthLimit(const std::string &pattern) override
+    {
+        next_.depthLimit(pattern);
+    }
+
+    void retracted(const std::string &uid) override
+    {
+        ++stats_.of(uid).retracted;
+        next_.retracted(uid);
+    }
+
+private:
+    ScanObserver &next_;
+    ScanStats &stats_;
+};
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "uidformat.h"
+
+/**
+ * @class SymbolPlan
+ * @brief Which symbols the scan tries at each tree level, and in which
+ *        order.
+ *
+ * Two independent parts, both per two-character vendor prefix:
+ *
+ * - a charset: the symbols a vendor's serial numbers are made of. The
+ *   walk never tries any other symbol, so a vendor declared `0-9`
+ *   costs 10 probes per tree node instead of 64. A UID holding a
+ *   symbol outside its vendor's charset can't be told apart from its
+ *   neighbours and may stay undiscovered, so a charset has to be a
+ *   promise about the population.
+ * - learned statistics: every discovered UID is counted (learn()) and,
+ *   if learning is enabled, the symbols of a level come most frequent
+ *   first, counted at the same distance from the UID end. A device
+ *   then tends to answer after a few probes, not after a walk through
+ *   every less likely symbol. Without statistics the order is the
+ *   CHARSET one.
+ *
+ * All members may be called from several scan threads at once.
+ */
+class SymbolPlan {
+public:
+    /**
+     * @brief Applies an assignment of the form `<prefix>=<symbols>`;
+     *        the prefix `*` stands for every vendor not listed.
+     *
+     * Symbols are listed one by one or as ranges: `0-9A-F`. A `-`
+     * that can't start a range (first or last) is the symbol itself.
+     *
+     * @return false if the assignment is malformed or names a
+     *         character that is no UID symbol
+     */
+    bool parse(const std::string &assignment)
+    {
+        size_t eq = assignment.find('=');
+        if (eq == std::string::npos || eq == 0)
+            return false;
+        std::string symbols;
+        if (!parseSymbols(assignment.substr(eq + 1), symbols))
+            return false;
+        std::string prefix = assignment.substr(0, eq);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (prefix == "*")
+            default_ = std::move(symbols);
+        else
+            charsets_[prefix] = std::move(symbols);
+        return true;
+    }
+
+    /**
+     * @brief Turns the learned symbol order on or off (default: off,
+     *        statistics are counted anyway).
+     */
+    void setLearning(bool on)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        learning_ = on;
+    }
+
+    /**
+     * @brief Counts the serial number symbols of a discovered UID.
+     */
+    void learn(std::string_view uid)
+    {
+        if (!AisgUid::isUid(uid))
+            return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        Stats &s = stats_[std::string(uid.substr(0, AisgUid::PREFIX))];
+        for (size_t level = 0; level < AisgUid::BODY; ++level) {
+            int sym = AisgUid::index(uid[AisgUid::LENGTH - 1 - level]);
+            ++s.level[level][sym];
+            ++s.total[sym];
+        }
+    }
+
+    /**
+     * @return the allowed symbols of `prefix`, in CHARSET order
+     */
+    std::string charset(const std::string &prefix) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return charsetLocked(prefix);
+    }
+
+    /**
+     * @brief Symbols to try for the UID character `level` positions
+     *        before the end (level 0 is the last one), in probe order.
+     */
+    std::string symbols(const std::string &prefix, size_t level) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::string out = charsetLocked(prefix);
+        auto it = stats_.find(prefix);
+        if (!learning_ || it == stats_.end() || level >= AisgUid::BODY)
+            return out;
+
+        // most frequent at this level first, then most frequent
+        // anywhere, then CHARSET order (stable sort of a sorted list)
+        const Stats &s = it->second;
+        std::stable_sort(out.begin(), out.end(), [&](char a, char b) {
+            int ia = AisgUid::index(a), ib = AisgUid::index(b);
+            if (s.level[level][ia] != s.level[level][ib])
+                return s.level[level][ia] > s.level[level][ib];
+            return s.total[ia] > s.total[ib];
+        });
+        return out;
+    }
+
+    /**
+     * @brief Expands a symbol list with ranges into the symbols it
+     *        names, in CHARSET order and without duplicates.
+     */
+    static bool parseSymbols(std::string_view spec, std::string &out)
+    {
+        std::array<bool, AisgUid::SYMBOLS> used{};
+        for (size_t i = 0; i < spec.size(); ++i) {
+            char lo = spec[i], hi = lo;
+            if (i + 2 < spec.size() && spec[i + 1] == '-') {
+                hi = spec[i + 2];
+                i += 2;
+            }
+            if (lo > hi || !AisgUid::isSymbol(lo) ||
+                !AisgUid::isSymbol(hi))
+                return false;
+            for (int c = lo; c <= hi; ++c) {
+                if (AisgUid::isSymbol(static_cast<char>(c)))
+                    used[AisgUid::index(static_cast<char>(c))] = true;
+            }
+        }
+        out.clear();
+        for (size_t i = 0; i < AisgUid::SYMBOLS; ++i) {
+            if (used[i])
+                out.push_back(AisgUid::CHARSET[i]);
+        }
+        return !out.empty();
+    }
+
+private:
+    struct Stats {
+        std::array<std::array<uint32_t, AisgUid::SYMBOLS>, AisgUid::BODY>
+            level{};
+        std::array<uint32_t, AisgUid::SYMBOLS> total{};
+    };
+
+    std::string charsetLocked(const std::string &prefix) const
+    {
+        auto it = charsets_.find(prefix);
+        return it != charsets_.end() ? it->second : default_;
+    }
+
+    mutable std::mutex mutex_;
+    std::string default_{AisgUid::CHARSET};
+    std::map<std::string, std::string> charsets_;
+    std::map<std::string, Stats> stats_;
+    bool learning_ = false;
+};
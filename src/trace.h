@@ -0,0 +1,351 @@
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "lineio.h"
+#include "scanengine.h"
+
+/**
+ * @class TraceSink
+ * @brief JSON-lines event log of a scan, written to a buffered file.
+ *
+ * One object per line, always with `t` (microseconds since the sink was
+ * opened), `bus` and `ev`:
+ *
+ *     {"t":12,"bus":"-","ev":"scan","prefix":"CB"}
+ *     {"t":40,"bus":"-","ev":"probe","pattern":"CB","resp":"!","us":21}
+ *     {"t":95,"bus":"-","ev":"window","patterns":[...],"resp":[...],
+ *      "us":50}
+ *     {"t":99,"bus":"-","ev":"assign","uid":"CB...","resp":"CB...",
+ *      "us":3}
+ *     {"t":99,"bus":"-","ev":"assign_later","uid":"CB..."}
+ *     {"t":99,"bus":"-","ev":"settle","failed":[...],"us":8}
+ *     {"t":99,"bus":"-","ev":"found","uid":"CB..."}
+ *     {"t":99,"bus":"-","ev":"retracted","uid":"CB..."}
+ *     {"t":99,"bus":"-","ev":"collision","pattern":"CB1","level":1}
+ *     {"t":99,"bus":"-","ev":"depth_limit","pattern":"CB..."}
+ *     {"t":99,"bus":"-","ev":"reset"}
+ *
+ * Responses are encoded like ScanLink responses ("" no answer, "!"
+ * collision), so the link events alone are enough to replay a scan.
+ * Safe to share between buses; the file is written in large chunks and
+ * flushed when the sink goes away.
+ */
+class TraceSink {
+public:
+    /**
+     * @brief Creates or truncates `path`; check ok() afterwards.
+     */
+    explicit TraceSink(const std::string &path) :
+        fd_(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)),
+        out_(fd_),
+        start_(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~TraceSink()
+    {
+        out_.flush();
+        if (fd_ >= 0)
+            ::close(fd_);
+    }
+
+    TraceSink(const TraceSink &) = delete;
+    TraceSink &operator=(const TraceSink &) = delete;
+
+    bool ok() const { return fd_ >= 0; }
+
+    void scan(std::string_view bus, std::string_view prefix)
+    {
+        Line l(*this, bus, "scan");
+        l.field("prefix", prefix);
+    }
+
+    void probe(std::string_view bus, std::string_view pattern,
+        std::string_view resp, long us)
+    {
+        Line l(*this, bus, "probe");
+        l.field("pattern", pattern);
+        l.field("resp", resp);
+        l.field("us", us);
+    }
+
+    void window(std::string_view bus,
+        const std::vector<std::string> &patterns,
+        const std::vector<std::string> &resp, long us)
+    {
+        Line l(*this, bus, "window");
+        l.field("patterns", patterns);
+        l.field("resp", resp);
+        l.field("us", us);
+    }
+
+    void assign(std::string_view bus, std::string_view uid,
+        std::string_view resp, long us)
+    {
+        Line l(*this, bus, "assign");
+        l.field("uid", uid);
+        l.field("resp", resp);
+        l.field("us", us);
+    }
+
+    void assignLater(std::string_view bus, std::string_view uid)
+    {
+        Line l(*this, bus, "assign_later");
+        l.field("uid", uid);
+    }
+
+    void settle(std::string_view bus,
+        const std::vector<std::string> &failed, long us)
+    {
+        Line l(*this, bus, "settle");
+        l.field("failed", failed);
+        l.field("us", us);
+    }
+
+    void reset(std::string_view bus) { Line l(*this, bus, "reset"); }
+
+    void found(std::string_view bus, std::string_view uid)
+    {
+        Line l(*this, bus, "found");
+        l.field("uid", uid);
+    }
+
+    void collision(std::string_view bus, std::string_view pattern,
+        size_t level)
+    {
+        Line l(*this, bus, "collision");
+        l.field("pattern", pattern);
+        l.field("level", static_cast<long>(level));
+    }
+
+    void depthLimit(std::string_view bus, std::string_view pattern)
+    {
+        Line l(*this, bus, "depth_limit");
+        l.field("pattern", pattern);
+    }
+
+    void retracted(std::string_view bus, std::string_view uid)
+    {
+        Line l(*this, bus, "retracted");
+        l.field("uid", uid);
+    }
+
+private:
+    /**
+     * one event, built in `buf` and handed to the writer when it goes
+     * out of scope
+     */
+    class Line {
+    public:
+        Line(TraceSink &sink, std::string_view bus, std::string_view ev) :
+            sink_(sink)
+        {
+            buf_ = "{";
+            field("t", sink.elapsed());
+            field("bus", bus);
+            field("ev", ev);
+        }
+
+        ~Line()
+        {
+            buf_.push_back('}');
+            std::lock_guard<std::mutex> lock(sink_.mutex_);
+            sink_.out_.put(buf_);
+        }
+
+        void field(std::string_view name, std::string_view value)
+        {
+            key(name);
+            quote(value);
+        }
+
+        void field(std::string_view name, long value)
+        {
+            key(name);
+            buf_ += std::to_string(value);
+        }
+
+        void field(std::string_view name,
+            const std::vector<std::string> &values)
+        {
+            key(name);
+            buf_.push_back('[');
+            for (size_t i = 0; i < values.size(); ++i) {
+                if (i)
+                    buf_.push_back(',');
+                quote(values[i]);
+            }
+            buf_.push_back(']');
+        }
+
+    private:
+        void key(std::string_view name)
+        {
+            if (buf_.size() > 1)
+                buf_.push_back(',');
+            quote(name);
+            buf_.push_back(':');
+        }
+
+        void quote(std::string_view s)
+        {
+            buf_.push_back('"');
+            for (unsigned char c : s) {
+                if (c == '"' || c == '\\') {
+                    buf_.push_back('\\');
+                    buf_.push_back(static_cast<char>(c));
+                } else if (c < 0x20) {
+                    char esc[8];
+                    std::snprintf(esc, sizeof(esc), "\\u%04x", c);
+                    buf_ += esc;
+                } else {
+                    buf_.push_back(static_cast<char>(c));
+                }
+            }
+            buf_.push_back('"');
+        }
+
+        TraceSink &sink_;
+        std::string buf_;
+    };
+
+    long elapsed() const
+    {
+        return static_cast<long>(std::chrono::duration_cast<
+            std::chrono::microseconds>(std::chrono::steady_clock::now() -
+            start_).count());
+    }
+
+    int fd_;
+    LineWriter out_;
+    std::chrono::steady_clock::time_point start_;
+    std::mutex mutex_;
+};
+
+/**
+ * @class TraceLink
+ * @brief ScanLink decorator recording all traffic of a bus in a
+ *        TraceSink.
+ */
+class TraceLink : public ScanLink {
+public:
+    TraceLink(ScanLink &link, TraceSink &sink, std::string bus) :
+        link_(link),
+        sink_(sink),
+        bus_(std::move(bus))
+    {
+    }
+
+    std::string probe(const std::string &pattern) override
+    {
+        const auto start = clock::now();
+        std::string resp = link_.probe(pattern);
+        sink_.probe(bus_, pattern, resp, since(start));
+        return resp;
+    }
+
+    std::vector<std::string> probeWindow(
+        const std::vector<std::string> &patterns) override
+    {
+        const auto start = clock::now();
+        std::vector<std::string> resp = link_.probeWindow(patterns);
+        sink_.window(bus_, patterns, resp, since(start));
+        return resp;
+    }
+
+    bool pipelined() const override { return link_.pipelined(); }
+
+    std::string assign(const std::string &uid) override
+    {
+        const auto start = clock::now();
+        std::string resp = link_.assign(uid);
+        sink_.assign(bus_, uid, resp, since(start));
+        return resp;
+    }
+
+    void assignLater(const std::string &uid) override
+    {
+        link_.assignLater(uid);
+        sink_.assignLater(bus_, uid);
+    }
+
+    std::vector<std::string> settle(bool wait = true) override
+    {
+        const auto start = clock::now();
+        std::vector<std::string> failed = link_.settle(wait);
+        if (wait || !failed.empty())
+            sink_.settle(bus_, failed, since(start));
+        return failed;
+    }
+
+    void resetAll() override
+    {
+        link_.resetAll();
+        sink_.reset(bus_);
+    }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    static long since(clock::time_point start)
+    {
+        return static_cast<long>(std::chrono::duration_cast<
+            std::chrono::microseconds>(clock::now() - start).count());
+    }
+
+    ScanLink &link_;
+    TraceSink &sink_;
+    std::string bus_;
+};
+
+/**
+ * @class TraceObserver
+ * @brief Records engine events in a TraceSink and passes them on.
+ */
+class TraceObserver : public ScanObserver {
+public:
+    TraceObserver(ScanObserver &next, TraceSink &sink, std::string bus) :
+        next_(next),
+        sink_(sink),
+        bus_(std::move(bus))
+    {
+    }
+
+    void collision(const std::string &pattern, size_t level) override
+    {
+        sink_.collision(bus_, pattern, level);
+        next_.collision(pattern, level);
+    }
+
+    void found(const std::string &uid) override
+    {
+        sink_.found(bus_, uid);
+        next_.found(uid);
+    }
+
+    void depthLimit(const std::string &pattern) override
+    {
+        sink_.depthLimit(bus_, pattern);
+        next_.depthLimit(pattern);
+    }
+
+    void retracted(const std::string &uid) override
+    {
+        sink_.retracted(bus_, uid);
+        next_.retracted(uid);
+    }
+
+private:
+    ScanObserver &next_;
+    TraceSink &sink_;
+    std::string bus_;
+};
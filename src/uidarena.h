@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mappedarray.h"
+#include "uidformat.h"
+
+/**
+ * @class UidArena
+ * @brief A UID population in one contiguous block of fixed-width slots.
+ *
+ * Every slot is width() bytes: the UID, padded with NUL bytes, the
+ * layout of a packed population file (UidFile). UIDs are handed out as
+ * std::string_view into the block, so a population of any size costs
+ * two allocations, not one per UID, and neighbouring UIDs share cache
+ * lines. The width starts at AisgUid::LENGTH and grows (every slot
+ * moved once) when a longer UID is added; lengths are kept per slot,
+ * so shorter UIDs work as well. A UID longer than MAX_LEN, the largest
+ * length a slot records, is refused (false, errno EINVAL).
+ *
+ * An arena can also be a view of slots and lengths kept elsewhere, the
+ * mapped image of a UidIndex (view()); the first change copies them.
+ */
+class UidArena {
+public:
+    static constexpr size_t MAX_LEN = UINT16_MAX; // lengths are uint16
+
+    UidArena() = default;
+
+    /**
+     * @brief An arena of `uids`, none longer than MAX_LEN: a longer one
+     *        is left out, so input is best added with push_back().
+     */
+    explicit UidArena(const std::vector<std::string> &uids)
+    {
+        size_t width = width_;
+        for (const auto &uid : uids) {
+            if (uid.size() <= MAX_LEN)
+                width = std::max(width, uid.size());
+        }
+        setWidth(width);
+        reserve(uids.size());
+        for (const auto &uid : uids)
+            push_back(uid);
+    }
+
+    /**
+     * @brief An arena over `count` slots of `width` bytes at `slots` and
+     *        their lengths at `lengths`, valid while `backing` lives.
+     */
+    static UidArena view(const std::shared_ptr<const void> &backing,
+        const char *slots, const uint16_t *lengths, size_t width,
+        size_t count)
+    {
+        UidArena arena;
+        arena.width_ = width;
+        arena.data_ = MappedArray<char>(backing, slots, count * width);
+        arena.len_ = MappedArray<uint16_t>(backing, lengths, count);
+        return arena;
+    }
+
+    size_t size() const { return len_.size(); }
+    bool empty() const { return len_.empty(); }
+    size_t width() const { return width_; }
+
+    std::string_view operator[](size_t i) const
+    {
+        return {data_.data() + i * width_, len_[i]};
+    }
+
+    void reserve(size_t n)
+    {
+        data_.edit([&](std::vector<char> &d) { d.reserve(n * width_); });
+        len_.edit([&](std::vector<uint16_t> &l) { l.reserve(n); });
+    }
+
+    /**
+     * @brief Adds `uid`; false (EINVAL) if it is longer than MAX_LEN.
+     */
+    bool push_back(std::string_view uid)
+    {
+        if (uid.size() > MAX_LEN) {
+            errno = EINVAL;
+            return false;
+        }
+        if (uid.size() > width_)
+            setWidth(uid.size());
+        data_.edit([&](std::vector<char> &d) {
+            const size_t at = d.size();
+            d.resize(at + width_, '\0');
+            std::memcpy(&d[at], uid.data(), uid.size());
+        });
+        len_.edit([&](std::vector<uint16_t> &l) {
+            l.push_back(static_cast<uint16_t>(uid.size()));
+        });
+        return true;
+    }
+
+    /**
+     * @brief Appends `count` slots of `width` bytes each, NUL padded, as
+     *        they are stored in a packed file.
+     */
+    bool append(const char *slots, size_t width, size_t count)
+    {
+        if (width > MAX_LEN) {
+            errno = EINVAL;
+            return false;
+        }
+        if (width > width_)
+            setWidth(width);
+        reserve(size() + count);
+        if (width != width_) {
+            for (size_t i = 0; i < count; ++i) {
+                const char *s = slots + i * width;
+                push_back(std::string_view(s, strnlen(s, width)));
+            }
+            return true;
+        }
+        data_.edit([&](std::vector<char> &d) { // as it is
+            d.insert(d.end(), slots, slots + count * width);
+        });
+        len_.edit([&](std::vector<uint16_t> &l) {
+            for (size_t i = 0; i < count; ++i)
+                l.push_back(static_cast<uint16_t>(
+                    strnlen(slots + i * width, width)));
+        });
+        return true;
+    }
+
+    /**
+     * @return the slots, size() * width() bytes
+     */
+    std::string_view slots() const
+    {
+        return {data_.data(), data_.size()};
+    }
+
+    /**
+     * @return the length of every slot's UID, size() of them
+     */
+    const uint16_t *lengths() const { return len_.data(); }
+
+    /**
+     * @brief Reorders the slots: slot `i` becomes the one that was at
+     *        `order[i]`.
+     */
+    void permute(const std::vector<uint32_t> &order)
+    {
+        std::vector<char> data(order.size() * width_, '\0');
+        std::vector<uint16_t> len(order.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            std::memcpy(&data[i * width_],
+                &data_[size_t(order[i]) * width_], width_);
+            len[i] = len_[order[i]];
+        }
+        data_ = MappedArray<char>(std::move(data));
+        len_ = MappedArray<uint16_t>(std::move(len));
+    }
+
+private:
+    void setWidth(size_t width)
+    {
+        if (width == width_)
+            return;
+        std::vector<char> data(size() * width, '\0');
+        for (size_t i = 0; i < size(); ++i)
+            std::memcpy(&data[i * width], &data_[i * width_], len_[i]);
+        data_ = MappedArray<char>(std::move(data));
+        width_ = width;
+    }
+
+    size_t width_ = AisgUid::LENGTH;
+    MappedArray<char> data_;     // size() slots of width_ bytes
+    MappedArray<uint16_t> len_;  // per slot
+};
@@ -0,0 +1,422 @@
+#pragma once
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "histogram.h"
+#include "scanengine.h"
+#include "uidfile.h"
+#include "uidindex.h"
+#include "vendortable.h"
+
+/**
+ * @class UidBus
+ * @brief A simulated bus: the devices of one UID population answering
+ *        the uidresp line protocol.
+ *
+ * handle() takes one input line and produces the reply uidresp would
+ * print for it, so the same object serves the uidresp tool and
+ * in-process simulations (see SimLink).
+ *
+ * Lines:
+ * - `<pattern>`            the matching device answers with its UID,
+ *                          several produce a collision (VendorTable)
+ * - `SETADDR:<uid>`        mutes a device, which confirms with its UID
+ * - `RESETADDR:<uid>`      unmutes a device
+ * - `RESETALL`             unmutes every device
+ * - `SYNC:<token>`         echoed back unchanged (a bare `SYNC` is a
+ *                          pattern like any other, for vendor `SY`)
+ * - `SNAPSHOT:<name>`      saves the muted state (UidFile), echoed back
+ *                          once written
+ * - `RESTORE:<name>`       replaces the muted state by a saved one,
+ *                          echoed back once done
+ * - `MODE:<mode>`          switches the response mode of the session,
+ *                          echoed back if it is known: `NORMAL`, or
+ *                          `FASTCOLLISION` for collisions answered with
+ *                          an empty line, at no cost, whatever the
+ *                          vendor profile (the scanner only needs to
+ *                          see that it is no UID)
+ * - `@<tag>:<line>`        like `<line>`, the reply prefixed with
+ *                          `@<tag>:`
+ *
+ * A Session holds what a client switched; handle() without one uses
+ * the bus' own, which setDefaultSession() preconfigures.
+ *
+ * Snapshots are files of setSnapshotDir(), named by a plain file name
+ * (no '/', no ".."); without a directory, or in a session that may not
+ * (Session::snapshots), SNAPSHOT and RESTORE fail.
+ *
+ * RESETADDR/RESETALL and failed SNAPSHOT/RESTORE commands report on
+ * the log stream (std::cerr unless changed by setLog()).
+ */
+class UidBus {
+public:
+    /**
+     * @brief Counters kept once setStats() is on.
+     *
+     * Match sets are only counted up to two (all a reply depends on),
+     * so `participants` holds the sizes of the collisions whose profile
+     * collects them (VendorTable, `or` and `mixed`).
+     */
+    struct Stats {
+        using clock = std::chrono::steady_clock;
+
+        uint64_t lines = 0; // commands included
+        uint64_t patterns = 0;
+        uint64_t noMatch = 0;
+        uint64_t unique = 0;
+        uint64_t collisions = 0;
+        Histogram participants;
+        Histogram collisionNs; // building collision replies
+        clock::time_point first;
+        clock::time_point last;
+
+        double seconds() const
+        {
+            return std::chrono::duration<double>(last - first).count();
+        }
+
+        double linesPerSecond() const
+        {
+            return seconds() > 0 ? lines / seconds() : 0.0;
+        }
+
+        void writeText(std::ostream &out) const
+        {
+            out << "== bus statistics ==\n"
+                << "lines: " << lines << " in " << seconds() << " s ("
+                << static_cast<uint64_t>(linesPerSecond()) << "/s)\n"
+                << "patterns: " << patterns << " (" << noMatch
+                << " no match, " << unique << " one, " << collisions
+                << " collisions)\n";
+            if (participants.count()) {
+                out << "collision sizes: ";
+                participants.writeText(out);
+                out << "\n";
+            }
+            if (collisionNs.count()) {
+                out << "collision reply us: ";
+                collisionNs.writeText(out, 1000);
+                out << " (" << collisionNs.sum() / 1e6 << " ms total)\n";
+            }
+        }
+
+        void writeJson(std::ostream &out) const
+        {
+            out << "{\"seconds\":" << seconds() << ",\"lines\":" << lines
+                << ",\"lines_per_s\":" << linesPerSecond()
+                << ",\"patterns\":" << patterns << ",\"no_match\":"
+                << noMatch << ",\"unique\":" << unique
+                << ",\"collisions\":" << collisions
+                << ",\"collision_sizes\":";
+            participants.writeJson(out);
+            out << ",\"collision_reply_us\":";
+            collisionNs.writeJson(out, 1000);
+            out << "}\n";
+        }
+    };
+
+    /**
+     * @param uids    Population on the bus.
+     * @param vendors Collision behaviour per vendor.
+     * @param seed    Seed of the collision generator.
+     */
+    explicit UidBus(const std::vector<std::string> &uids,
+        VendorTable vendors = VendorTable(), unsigned long seed = 1) :
+        UidBus(UidArena(uids), std::move(vendors), seed)
+    {
+    }
+
+    explicit UidBus(UidArena uids, VendorTable vendors = VendorTable(),
+        unsigned long seed = 1) :
+        UidBus(UidIndex(std::move(uids)), std::move(vendors), seed)
+    {
+    }
+
+    /**
+     * @brief A bus over a built index, e.g. a mapped image
+     *        (UidFile::loadImage()).
+     */
+    explicit UidBus(UidIndex index, VendorTable vendors = VendorTable(),
+        unsigned long seed = 1) :
+        index_(std::move(index)),
+        vendors_(std::move(vendors)),
+        rng_(static_cast<std::mt19937::result_type>(seed))
+    {
+    }
+
+    /**
+     * @brief Where RESETADDR/RESETALL messages go; nullptr for nowhere.
+     */
+    void setLog(std::ostream *log) { log_ = log; }
+
+    /**
+     * @brief Per-client protocol state.
+     */
+    struct Session {
+        bool fastCollision = false;
+        bool snapshots = true; // may SNAPSHOT/RESTORE
+    };
+
+    /**
+     * @brief The session of handle() calls without one, and the one
+     *        new clients start from.
+     */
+    void setDefaultSession(const Session &session) { session_ = session; }
+    const Session &defaultSession() const { return session_; }
+
+    /**
+     * @brief The directory SNAPSHOT and RESTORE keep their files in;
+     *        empty (the default) for none, which refuses them.
+     */
+    void setSnapshotDir(std::string dir) { snapshotDir_ = std::move(dir); }
+
+    /**
+     * @brief Starts or stops keeping stats().
+     */
+    void setStats(bool on) { statsOn_ = on; }
+
+    const Stats &stats() const { return stats_; }
+
+    /**
+     * @brief Processes one input line (without '\n').
+     *
+     * @param reply Receives the reply line (without '\n'), which may be
+     *              empty: a collision without content.
+     * @return false if the line gets no reply at all
+     */
+    bool handle(const std::string &line, std::string &reply)
+    {
+        return handle(line, reply, session_);
+    }
+
+    /**
+     * @brief The same on behalf of one client.
+     */
+    bool handle(const std::string &line, std::string &reply,
+        Session &session)
+    {
+        if (line.empty())
+            return false;
+        if (statsOn_) {
+            stats_.last = Stats::clock::now();
+            if (stats_.lines++ == 0)
+                stats_.first = stats_.last;
+        }
+
+        // @<tag>:<line>
+        std::string_view tag;
+        std::string_view l = line;
+        if (line[0] == '@') {
+            size_t colon = line.find(':');
+            if (colon != std::string::npos) {
+                tag = l.substr(0, colon + 1);
+                l.remove_prefix(colon + 1);
+            }
+            if (l.empty())
+                return false;
+        }
+        reply.assign(tag);
+
+        // SYNC:<token>; no pattern holds a ':'
+        if (startsWith(l, "SYNC:")) {
+            reply.append(l);
+            return true;
+        }
+
+        // MODE:<mode>
+        if (startsWith(l, "MODE:")) {
+            std::string_view mode = l.substr(5);
+            if (mode != "NORMAL" && mode != "FASTCOLLISION")
+                return false;
+            session.fastCollision = mode == "FASTCOLLISION";
+            reply.append(l);
+            return true;
+        }
+
+        // SETADDR:<uid>
+        if (startsWith(l, "SETADDR:")) {
+            std::string_view uid = l.substr(8);
+            if (!index_.mute(uid))
+                return false;
+            reply.append(uid);
+            return true;
+        }
+
+        // RESETADDR:<uid>
+        if (startsWith(l, "RESETADDR:")) {
+            std::string_view uid = l.substr(10);
+            if (index_.unmute(uid)) {
+                if (log_)
+                    *log_ << "[unmuted] " << uid << std::endl;
+            } else if (log_) {
+                *log_ << "[warn] tried to unmute unknown or active uid: "
+                    << uid << std::endl;
+            }
+            return false;
+        }
+
+        // SNAPSHOT:<name>, RESTORE:<name>
+        if (startsWith(l, "SNAPSHOT:") || startsWith(l, "RESTORE:")) {
+            const bool save = l[0] == 'S';
+            const std::string_view name = l.substr(save ? 9 : 8);
+            std::string path;
+            if (snapshotPath(session, name, path) &&
+                (save ? UidFile::saveMuted(path, index_)
+                      : UidFile::loadMuted(path, index_))) {
+                reply.append(l);
+                return true;
+            }
+            if (log_)
+                *log_ << "[warn] " << (save ? "snapshot" : "restore")
+                    << " failed: " << name << ": " << std::strerror(errno)
+                    << std::endl;
+            return false;
+        }
+
+        // RESETALL
+        if (l == "RESETALL") {
+            index_.unmuteAll();
+            if (log_)
+                *log_ << "[unmuted all]" << std::endl;
+            return false;
+        }
+
+        // normal pattern matching: "none", "one" or "several" is all
+        // that counts, unless the collision is made of the participants
+        BatchMatcher::Result r = index_.countMatches(l, 2);
+        if (statsOn_) {
+            ++stats_.patterns;
+            ++(r.count == 0 ? stats_.noMatch
+                : r.count == 1 ? stats_.unique : stats_.collisions);
+        }
+
+        if (r.count == 0)
+            return false;
+
+        if (r.count == 1) {
+            reply.append(index_.uid(r.first));
+        } else if (!session.fastCollision) {
+            const auto start = statsOn_ ? Stats::clock::now()
+                                        : Stats::clock::time_point();
+            // e.g. CB vendor returns empty line, others a mix of symbols
+            const CollisionProfile &profile =
+                vendors_.lookup(index_.uid(r.first));
+            participants_.clear();
+            if (profile.needsParticipants) {
+                index_.forEachMatch(l, [&](size_t ordinal) {
+                    participants_.emplace_back(index_.uid(ordinal));
+                });
+            }
+            profile.respond(participants_, rng_, noise_);
+            reply.append(noise_);
+            if (statsOn_) {
+                stats_.collisionNs.record(static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    Stats::clock::now() - start).count()));
+                if (profile.needsParticipants)
+                    stats_.participants.record(participants_.size());
+            }
+        }
+        return true;
+    }
+
+    UidIndex &index() { return index_; }
+    const UidIndex &index() const { return index_; }
+
+private:
+    UidIndex index_;
+    VendorTable vendors_;
+    std::mt19937 rng_;
+    static bool startsWith(std::string_view s, std::string_view head)
+    {
+        return s.substr(0, head.size()) == head;
+    }
+
+    /**
+     * the file of snapshot `name`, false (errno set) if `session` may
+     * not have it: snapshots not allowed or no directory (EPERM), or
+     * not a plain file name (EINVAL)
+     */
+    bool snapshotPath(const Session &session, std::string_view name,
+        std::string &path) const
+    {
+        if (!session.snapshots || snapshotDir_.empty()) {
+            errno = EPERM;
+            return false;
+        }
+        if (name.empty() || name.find('/') != std::string_view::npos ||
+            name.find("..") != std::string_view::npos) {
+            errno = EINVAL;
+            return false;
+        }
+        path.assign(snapshotDir_).append("/").append(name);
+        return true;
+    }
+
+    std::string snapshotDir_;
+
+    std::string noise_;
+    CollisionProfile::Participants participants_; // views into index_
+    Session session_;
+    std::ostream *log_ = &std::cerr;
+    bool statsOn_ = false;
+    Stats stats_;
+};
+
+/**
+ * @class SimLink
+ * @brief ScanLink straight into a UidBus, no pipes, no timeouts: a
+ *        miss is known at once.
+ *
+ * Several SimLinks may share a bus between threads (the channels of a
+ * ParallelScan) if they share a `lock` as well; every request holds it.
+ */
+class SimLink : public ScanLink {
+public:
+    explicit SimLink(UidBus &bus, std::mutex *lock = nullptr) :
+        bus_(bus),
+        lock_(lock)
+    {
+    }
+
+    std::string probe(const std::string &pattern) override
+    {
+        return request(pattern);
+    }
+
+    std::string assign(const std::string &uid) override
+    {
+        line_.assign("SETADDR:");
+        line_.append(uid);
+        return request(line_);
+    }
+
+    void resetAll() override { request("RESETALL"); }
+
+private:
+    /**
+     * reply encoded the way LineLink::readLine() does
+     */
+    std::string request(const std::string &line)
+    {
+        std::unique_lock<std::mutex> lock;
+        if (lock_)
+            lock = std::unique_lock<std::mutex>(*lock_);
+        if (!bus_.handle(line, reply_))
+            return "";
+        return reply_.empty() ? "!" : reply_;
+    }
+
+    UidBus &bus_;
+    std::mutex *lock_;
+    std::string line_; // commands, reused
+    std::string reply_;
+};
@@ -0,0 +1,425 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "uidarena.h"
+#include "uidindex.h"
+
+/**
+ * @class UidFile
+ * @brief Population files and muted-state snapshots of uidresp.
+ *
+ * A population file is read through mmap() in one of two layouts:
+ * - text: one UID per line; blank lines and lines starting with `#` are
+ *   skipped, surrounding blanks trimmed
+ * - packed: the 16-byte header `UIDPACK1`, the slot width and the
+ *   count (both uint32, native byte order), then `count` slots of
+ *   `width` bytes, each one UID padded with NUL bytes
+ *
+ * An image is a built UidIndex (UidIndex::layout()), relocatable since
+ * nodes refer to each other by number: the header `UIDIMAGE`, then
+ * IMAGE_VERSION, UidIndex::NODE_SIZE, the slot width and the bucket
+ * count (uint32 each), the UID count and the node count (uint64 each);
+ * then, each at a multiple of 8 bytes, the slots as in a packed file,
+ * the UID lengths (uint16), the nodes and the bucket roots (uint32).
+ * All of it is in native byte order: an image of the other byte order
+ * fails the version check. IMAGE_VERSION changes with the layout.
+ *
+ * A snapshot saves the muted state of a UidIndex: the header `UIDMUTE1`,
+ * the population size and UidIndex::fingerprint() (uint64 each), then
+ * the muted words. It can only be restored into an index over the same
+ * population.
+ *
+ * Errors are reported as false with errno set (EINVAL for a malformed
+ * or foreign file).
+ */
+class UidFile {
+public:
+    static constexpr char PACK_MAGIC[8] = {
+        'U', 'I', 'D', 'P', 'A', 'C', 'K', '1'};
+    static constexpr char MUTE_MAGIC[8] = {
+        'U', 'I', 'D', 'M', 'U', 'T', 'E', '1'};
+    static constexpr char IMAGE_MAGIC[8] = {
+        'U', 'I', 'D', 'I', 'M', 'A', 'G', 'E'};
+    static constexpr uint32_t IMAGE_VERSION = 1;
+
+    /**
+     * @brief Appends the UIDs of a text or packed population file, or
+     *        of an image. The slots of a packed file or an image of the
+     *        arena's width are copied as one block. A UID longer
+     *        than UidArena::MAX_LEN fails the load with EINVAL.
+     */
+    static bool load(const std::string &path, UidArena &uids)
+    {
+        Mapping m;
+        if (!m.open(path))
+            return false;
+        std::string_view data = m.data();
+        if (data.size() >= 16 && data.compare(0, 8,
+            std::string_view(PACK_MAGIC, 8)) == 0)
+            return parsePacked(data, uids);
+        if (data.size() >= 8 && data.compare(0, 8,
+            std::string_view(IMAGE_MAGIC, 8)) == 0) {
+            Image image;
+            if (!parseImage(data, image))
+                return false;
+            return uids.append(data.data() + image.slotsAt, image.width,
+                image.count);
+        }
+        return parseText(data, uids);
+    }
+
+    static bool load(const std::string &path,
+        std::vector<std::string> &uids)
+    {
+        UidArena arena;
+        if (!load(path, arena))
+            return false;
+        uids.reserve(uids.size() + arena.size());
+        for (size_t i = 0; i < arena.size(); ++i)
+            uids.emplace_back(arena[i]);
+        return true;
+    }
+
+    /**
+     * @brief Writes `uids` as a packed population file; the slot width
+     *        is that of the arena (AisgUid::LENGTH unless a UID is
+     *        longer).
+     */
+    static bool writePacked(const std::string &path, const UidArena &uids)
+    {
+        std::string out(PACK_MAGIC, 8);
+        appendRaw(out, static_cast<uint32_t>(uids.width()));
+        appendRaw(out, static_cast<uint32_t>(uids.size()));
+        out.append(uids.slots());
+        return writeFile(path, {out});
+    }
+
+    static bool writePacked(const std::string &path,
+        const std::vector<std::string> &uids)
+    {
+        return writePacked(path, UidArena(uids));
+    }
+
+    /**
+     * @brief Writes `index` as an image.
+     */
+    static bool writeImage(const std::string &path, const UidIndex &index)
+    {
+        const UidIndex::Layout l = index.layout();
+        Image image;
+        image.width = l.width;
+        image.count = l.count;
+        image.nodeCount = l.nodeCount;
+        image.buckets = l.roots.size();
+        place(image);
+
+        std::string head(IMAGE_MAGIC, 8);
+        appendRaw(head, IMAGE_VERSION);
+        appendRaw(head, static_cast<uint32_t>(UidIndex::NODE_SIZE));
+        appendRaw(head, static_cast<uint32_t>(image.width));
+        appendRaw(head, static_cast<uint32_t>(image.buckets));
+        appendRaw(head, static_cast<uint64_t>(image.count));
+        appendRaw(head, static_cast<uint64_t>(image.nodeCount));
+        const char zeros[8] = {};
+        auto pad = [&](size_t from, size_t to) {
+            return std::string_view(zeros, to - from);
+        };
+        const std::string_view lengths(
+            reinterpret_cast<const char *>(l.lengths),
+            l.count * sizeof(uint16_t));
+        const std::string_view nodes(
+            static_cast<const char *>(l.nodes),
+            l.nodeCount * UidIndex::NODE_SIZE);
+        const std::string_view roots(
+            reinterpret_cast<const char *>(l.roots.data()),
+            l.roots.size() * sizeof(uint32_t));
+        return writeFile(path, {head, l.slots,
+            pad(image.slotsAt + l.slots.size(), image.lengthsAt), lengths,
+            pad(image.lengthsAt + lengths.size(), image.nodesAt), nodes,
+            pad(image.nodesAt + nodes.size(), image.rootsAt), roots});
+    }
+
+    /**
+     * @brief Maps an image written by writeImage() into `index`, which
+     *        works on the mapped pages as they are, nothing copied.
+     *
+     * Besides the header and the section sizes, one pass over the UID
+     * lengths and the trie nodes checks that they stay in bounds
+     * (UidIndex::validLayout()), so a damaged or crafted image is
+     * refused (EINVAL) instead of read out of bounds by a query.
+     */
+    static bool loadImage(const std::string &path,
+        std::optional<UidIndex> &index)
+    {
+        auto m = std::make_shared<Mapping>();
+        if (!m->open(path, MADV_NORMAL))
+            return false;
+        const std::string_view data = m->data();
+        Image image;
+        if (!parseImage(data, image))
+            return false;
+
+        UidIndex::Layout l;
+        l.slots = data.substr(image.slotsAt, image.count * image.width);
+        l.width = image.width;
+        l.lengths = reinterpret_cast<const uint16_t *>(
+            data.data() + image.lengthsAt);
+        l.count = image.count;
+        l.nodes = data.data() + image.nodesAt;
+        l.nodeCount = image.nodeCount;
+        l.roots.resize(image.buckets);
+        std::memcpy(l.roots.data(), data.data() + image.rootsAt,
+            image.buckets * sizeof(uint32_t));
+        if (!UidIndex::validLayout(l)) {
+            errno = EINVAL;
+            return false;
+        }
+        index.emplace(l, m);
+        return true;
+    }
+
+    /**
+     * @brief Saves the muted state of `index`.
+     */
+    static bool saveMuted(const std::string &path, const UidIndex &index)
+    {
+        const std::vector<uint64_t> &words = index.mutedWords();
+        std::string out(MUTE_MAGIC, 8);
+        appendRaw(out, static_cast<uint64_t>(index.size()));
+        appendRaw(out, index.fingerprint());
+        out.append(reinterpret_cast<const char *>(words.data()),
+            words.size() * sizeof(uint64_t));
+        return writeFile(path, {out});
+    }
+
+    /**
+     * @brief Restores a muted state saved by saveMuted().
+     */
+    static bool loadMuted(const std::string &path, UidIndex &index)
+    {
+        Mapping m;
+        if (!m.open(path))
+            return false;
+        std::string_view data = m.data();
+        const size_t words = (index.size() + 63) / 64;
+        if (data.size() != 24 + words * sizeof(uint64_t) ||
+            data.compare(0, 8, std::string_view(MUTE_MAGIC, 8)) != 0 ||
+            readRaw<uint64_t>(data, 8) != index.size() ||
+            readRaw<uint64_t>(data, 16) != index.fingerprint()) {
+            errno = EINVAL;
+            return false;
+        }
+        std::vector<uint64_t> bits(words);
+        std::memcpy(bits.data(), data.data() + 24,
+            words * sizeof(uint64_t));
+        return index.setMutedWords(bits);
+    }
+
+private:
+    /**
+     * read-only mapping of a whole file; empty files map to nothing
+     */
+    class Mapping {
+    public:
+        Mapping() = default;
+        Mapping(const Mapping &) = delete;
+        Mapping &operator=(const Mapping &) = delete;
+
+        ~Mapping()
+        {
+            if (addr_ != MAP_FAILED)
+                munmap(addr_, size_);
+        }
+
+        bool open(const std::string &path, int advice = MADV_SEQUENTIAL)
+        {
+            int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                return false;
+            struct stat st;
+            if (fstat(fd, &st) != 0) {
+                int e = errno;
+                close(fd);
+                errno = e;
+                return false;
+            }
+            size_ = static_cast<size_t>(st.st_size);
+            if (size_ > 0) {
+                addr_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd,
+                    0);
+                if (addr_ != MAP_FAILED)
+                    madvise(addr_, size_, advice);
+            }
+            int e = errno;
+            close(fd);
+            errno = e;
+            return size_ == 0 || addr_ != MAP_FAILED;
+        }
+
+        std::string_view data() const
+        {
+            if (addr_ == MAP_FAILED)
+                return {};
+            return {static_cast<const char *>(addr_), size_};
+        }
+
+    private:
+        void *addr_ = MAP_FAILED;
+        size_t size_ = 0;
+    };
+
+    static bool parseText(std::string_view data, UidArena &uids)
+    {
+        while (!data.empty()) {
+            size_t nl = data.find('\n');
+            std::string_view line = data.substr(0, nl);
+            data.remove_prefix(nl == std::string_view::npos ? data.size()
+                                                            : nl + 1);
+            size_t b = line.find_first_not_of(" \t\r");
+            if (b == std::string_view::npos || line[b] == '#')
+                continue;
+            size_t e = line.find_last_not_of(" \t\r");
+            if (!uids.push_back(line.substr(b, e - b + 1)))
+                return false;
+        }
+        return true;
+    }
+
+    static bool parsePacked(std::string_view data, UidArena &uids)
+    {
+        const size_t width = readRaw<uint32_t>(data, 8);
+        const size_t count = readRaw<uint32_t>(data, 12);
+        if (width == 0 || (data.size() - 16) / width < count) {
+            errno = EINVAL;
+            return false;
+        }
+        return uids.append(data.data() + 16, width, count);
+    }
+
+    /**
+     * the header fields of an image and where its sections start
+     */
+    struct Image {
+        size_t width = 0;
+        size_t count = 0;
+        size_t nodeCount = 0;
+        size_t buckets = 0;
+        size_t slotsAt = 0;
+        size_t lengthsAt = 0;
+        size_t nodesAt = 0;
+        size_t rootsAt = 0;
+        size_t end = 0;
+    };
+
+    static constexpr size_t IMAGE_HEAD = 40;
+
+    static size_t align8(size_t n) { return (n + 7) & ~size_t(7); }
+
+    /**
+     * sets the section offsets of `image` from its counts
+     */
+    static void place(Image &image)
+    {
+        image.slotsAt = IMAGE_HEAD;
+        image.lengthsAt =
+            align8(image.slotsAt + image.count * image.width);
+        image.nodesAt =
+            align8(image.lengthsAt + image.count * sizeof(uint16_t));
+        image.rootsAt =
+            align8(image.nodesAt + image.nodeCount * UidIndex::NODE_SIZE);
+        image.end = image.rootsAt + image.buckets * sizeof(uint32_t);
+    }
+
+    static bool parseImage(std::string_view data, Image &image)
+    {
+        bool ok = data.size() >= IMAGE_HEAD && data.compare(0, 8,
+            std::string_view(IMAGE_MAGIC, 8)) == 0 &&
+            readRaw<uint32_t>(data, 8) == IMAGE_VERSION &&
+            readRaw<uint32_t>(data, 12) == UidIndex::NODE_SIZE;
+        if (ok) {
+            image.width = readRaw<uint32_t>(data, 16);
+            image.buckets = readRaw<uint32_t>(data, 20);
+            const uint64_t count = readRaw<uint64_t>(data, 24);
+            const uint64_t nodes = readRaw<uint64_t>(data, 32);
+            // ordinals and node numbers are uint32, lengths uint16
+            ok = image.width > 0 && image.width <= UINT16_MAX &&
+                count <= UINT32_MAX && nodes <= UINT32_MAX;
+            image.count = static_cast<size_t>(count);
+            image.nodeCount = static_cast<size_t>(nodes);
+        }
+        if (ok) {
+            place(image);
+            ok = image.end == data.size();
+        }
+        if (!ok)
+            errno = EINVAL;
+        return ok;
+    }
+
+    template <typename T>
+    static void appendRaw(std::string &out, T v)
+    {
+        out.append(reinterpret_cast<const char *>(&v), sizeof(v));
+    }
+
+    template <typename T>
+    static T readRaw(std::string_view data, size_t at)
+    {
+        T v;
+        std::memcpy(&v, data.data() + at, sizeof(v));
+        return v;
+    }
+
+    /**
+     * whole file at once, the `parts` one after the other, through a
+     * temporary file renamed over `path`
+     */
+    static bool writeFile(const std::string &path,
+        std::initializer_list<std::string_view> parts)
+    {
+        const std::string tmp = path + ".tmp";
+        int fd = ::open(tmp.c_str(),
+            O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+            return false;
+        for (std::string_view data : parts) {
+            size_t done = 0;
+            while (done < data.size()) {
+                ssize_t n =
+                    ::write(fd, data.data() + done, data.size() - done);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n < 0) {
+                    int e = errno;
+                    close(fd);
+                    unlink(tmp.c_str());
+                    errno = e;
+                    return false;
+                }
+                done += static_cast<size_t>(n);
+            }
+        }
+        if (close(fd) != 0 || rename(tmp.c_str(), path.c_str()) != 0) {
+            int e = errno;
+            unlink(tmp.c_str());
+            errno = e;
+            return false;
+        }
+        return true;
+    }
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "charclass.h"
+
+/**
+ * @struct UidFormat
+ * @brief Compile-time description of a UID: `PrefixLen` vendor
+ *        characters followed by `BodyLen` characters, all drawn from
+ *        `Charset` (a NUL-terminated array with static storage).
+ *
+ * Everything length- or charset-dependent is a constant here, so the
+ * compiler sees fixed loop bounds: matching a pattern against a UID of
+ * the format is a fixed-length prefix compare plus one tail compare,
+ * and the symbol <-> index mapping is a 256-entry table built at
+ * compile time instead of a search through the charset.
+ */
+template <size_t PrefixLen, size_t BodyLen, const char *Charset>
+struct UidFormat {
+    static constexpr size_t PREFIX = PrefixLen;
+    static constexpr size_t BODY = BodyLen;
+    static constexpr size_t LENGTH = PrefixLen + BodyLen;
+
+    static constexpr std::string_view CHARSET{Charset};
+    static constexpr size_t SYMBOLS = CHARSET.size();
+
+    static_assert(SYMBOLS > 0 && SYMBOLS < 128, "charset size");
+
+    /**
+     * @return position of `c` in the charset, -1 if it is not a symbol
+     */
+    static constexpr int index(char c)
+    {
+        return INDEX[static_cast<unsigned char>(c)];
+    }
+
+    static constexpr bool isSymbol(char c) { return index(c) >= 0; }
+
+    /**
+     * @return true if `s` has the full length and only charset symbols
+     */
+    static constexpr bool isUid(std::string_view s)
+    {
+        if (s.size() != LENGTH)
+            return false;
+        for (size_t i = 0; i < LENGTH; ++i) {
+            if (!isSymbol(s[i]))
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Check symbol of a UID whose last character is one: the
+     *        CRC-8 (polynomial 0x07) of the LENGTH - 1 characters
+     *        before it, mod SYMBOLS, as a symbol.
+     */
+    static constexpr char checkSymbol(std::string_view head)
+    {
+        uint8_t crc = 0;
+        for (size_t i = 0; i < head.size() && i < LENGTH - 1; ++i) {
+            crc ^= static_cast<uint8_t>(head[i]);
+            for (int bit = 0; bit < 8; ++bit)
+                crc = static_cast<uint8_t>(
+                    (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1);
+        }
+        return CHARSET[crc % SYMBOLS];
+    }
+
+    /**
+     * @return true if `s` is a UID ending in its checkSymbol()
+     */
+    static constexpr bool isChecked(std::string_view s)
+    {
+        return isUid(s) && s[LENGTH - 1] == checkSymbol(s.substr(0,
+            LENGTH - 1));
+    }
+
+    /**
+     * @brief UidResponder match rule for a UID of exactly LENGTH
+     *        characters: the first PREFIX pattern characters are the
+     *        UID's start, the rest is its end. A position may be a
+     *        character class (see CharClass).
+     */
+    static bool matches(std::string_view pattern, std::string_view uid)
+    {
+        if (CharClass::hasClass(pattern))
+            return CharClass::matches(pattern, uid, PREFIX);
+        const size_t len = pattern.size();
+        if (len == 0 || len > LENGTH)
+            return false;
+        if (len <= PREFIX)
+            return pattern == uid.substr(0, len);
+        return pattern.substr(0, PREFIX) == uid.substr(0, PREFIX) &&
+            pattern.substr(PREFIX) == uid.substr(LENGTH - (len - PREFIX));
+    }
+
+private:
+    static constexpr std::array<int8_t, 256> makeIndex()
+    {
+        std::array<int8_t, 256> t{};
+        for (auto &v : t)
+            v = -1;
+        for (size_t i = 0; i < SYMBOLS; ++i)
+            t[static_cast<unsigned char>(CHARSET[i])] =
+                static_cast<int8_t>(i);
+        return t;
+    }
+
+    static constexpr std::array<int8_t, 256> INDEX = makeIndex();
+};
+
+inline constexpr char AISG_CHARSET[] = "0123456789"
+                                       "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                       "abcdefghijklmnopqrstuvwxyz"
+                                       "-_";
+
+/**
+ * @brief AISG device UID: two vendor characters and a 17 character
+ *        serial number
+ */
+using AisgUid = UidFormat<2, 17, AISG_CHARSET>;
@@ -0,0 +1,746 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "batchmatch.h"
+#include "charclass.h"
+#include "mappedarray.h"
+#include "uidarena.h"
+
+/**
+ * @class UidIndex
+ * @brief Prebuilt lookup structure for the UidResponder match rule.
+ *
+ * UIDs are grouped into buckets by their first two characters. Every
+ * bucket holds a trie over the rest of the UID read from the end, so a
+ * pattern selects its bucket with the left part and walks the trie with
+ * the right part (last character first). The node reached covers
+ * exactly the UIDs that match the pattern; nothing else is looked at.
+ *
+ * The UIDs themselves sit in a UidArena, in index order, and are
+ * handed out as views into it.
+ *
+ * The index order doubles as the UID ordinal: every trie node covers a
+ * contiguous ordinal range. Muted (addressed) state is a dense bitset
+ * keyed by ordinal, so muting allocates nothing, unmuting everything is
+ * a memset and a match walks its range one 64-bit word at a time,
+ * skipping fully muted words at once.
+ *
+ * Instead of the trie, queries can run on a BatchMatcher over the same
+ * ordinals and muted bits (useBatch()): a SIMD pass over the whole
+ * population, linear but without pointer chasing.
+ *
+ * A pattern with character classes (see CharClass) always takes the
+ * trie: a class position follows every child it holds, so the pattern
+ * covers a few ordinal ranges instead of one.
+ *
+ * The scan refines: each probe is an earlier one with a character
+ * inserted right after the prefix, i.e. one trie level below it. The
+ * nodes of the last CACHED patterns are kept, most recent first, so
+ * such a probe takes one step from its parent's node instead of the
+ * walk from the bucket root. Muting changes the bitset only, never a
+ * node, so nothing cached goes stale. Queries update the cache: unlike
+ * the rest of the const interface they must not run concurrently.
+ *
+ * A built index is flat arrays of plain data (layout()): an image file
+ * of them can be mapped and queried as it is, nothing built, the pages
+ * shared by every process mapping it (UidFile::loadImage()).
+ *
+ * `UidResponder::matches` stays the reference implementation: for any
+ * pattern the index yields the same UIDs as a linear scan with it.
+ */
+class UidIndex {
+public:
+    /**
+     * @brief Builds the index over a UID population.
+     *
+     * Duplicates are kept: they share one terminal node and match (and
+     * get muted) together, the same way the linear scan treats them.
+     *
+     * @param uids Full UIDs, in any order.
+     */
+    explicit UidIndex(const std::vector<std::string> &uids) :
+        UidIndex(UidArena(uids))
+    {
+    }
+
+    explicit UidIndex(UidArena uids) :
+        uids_(std::move(uids))
+    {
+        std::vector<uint32_t> order(uids_.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return less(uids_[a], uids_[b]);
+        });
+        uids_.permute(order);
+
+        std::vector<Node> nodes;
+        size_t lo = 0;
+        while (lo < uids_.size()) {
+            std::string key(uids_[lo].substr(0, MATCH_LEFT));
+            size_t hi = lo;
+            while (hi < uids_.size() &&
+                uids_[hi].compare(0, MATCH_LEFT, key) == 0)
+                ++hi;
+
+            uint32_t root = static_cast<uint32_t>(nodes.size());
+            nodes.push_back(Node{});
+            nodes[root].lo = static_cast<uint32_t>(lo);
+            nodes[root].hi = static_cast<uint32_t>(hi);
+            build(nodes, root, 0);
+            buckets_.push_back(Bucket{key, root});
+            lo = hi;
+        }
+        nodes_ = MappedArray<Node>(std::move(nodes));
+        muted_.assign((uids_.size() + WORD_BITS - 1) / WORD_BITS, 0);
+    }
+
+    /**
+     * @brief The built index as flat arrays of plain data in native
+     *        byte order; the pointers are valid while the index is.
+     */
+    struct Layout {
+        std::string_view slots;     // uids().slots()
+        size_t width = 0;           // uids().width()
+        const uint16_t *lengths = nullptr;
+        size_t count = 0;           // slots and lengths
+        const void *nodes = nullptr; // NODE_SIZE bytes each
+        size_t nodeCount = 0;
+        std::vector<uint32_t> roots; // of the buckets, in key order
+    };
+
+    static constexpr size_t NODE_SIZE = 24;
+
+    Layout layout() const
+    {
+        Layout l;
+        l.slots = uids_.slots();
+        l.width = uids_.width();
+        l.lengths = uids_.lengths();
+        l.count = uids_.size();
+        l.nodes = nodes_.data();
+        l.nodeCount = nodes_.size();
+        for (const Bucket &b : buckets_)
+            l.roots.push_back(b.root);
+        return l;
+    }
+
+    /**
+     * @brief Checks that the arrays of `layout` keep every query in
+     *        bounds, in one pass over the lengths and the nodes: UID
+     *        lengths within the width, node ranges within the UIDs,
+     *        children within the nodes and after their parent (so the
+     *        trie has no cycles), and roots that hold a UID.
+     */
+    static bool validLayout(const Layout &layout)
+    {
+        for (size_t i = 0; i < layout.count; ++i) {
+            if (layout.lengths[i] > layout.width)
+                return false;
+        }
+        const Node *nodes = static_cast<const Node *>(layout.nodes);
+        for (size_t n = 0; n < layout.nodeCount; ++n) {
+            const Node &node = nodes[n];
+            if (node.lo > node.hi || node.hi > layout.count ||
+                node.term > node.hi - node.lo)
+                return false;
+            if (node.nchild > 0 && (node.child <= n ||
+                size_t(node.child) + node.nchild > layout.nodeCount))
+                return false;
+        }
+        for (uint32_t root : layout.roots) {
+            if (root >= layout.nodeCount ||
+                nodes[root].lo == nodes[root].hi)
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief An index over the arrays of a layout(), as they are: they
+     *        are not copied and must stay valid while `backing` lives.
+     *        They must pass validLayout(), which is not repeated here.
+     */
+    UidIndex(const Layout &layout,
+        const std::shared_ptr<const void> &backing) :
+        uids_(UidArena::view(backing, layout.slots.data(),
+            layout.lengths, layout.width, layout.count)),
+        nodes_(backing, static_cast<const Node *>(layout.nodes),
+            layout.nodeCount)
+    {
+        for (uint32_t root : layout.roots)
+            buckets_.push_back(Bucket{std::string(
+                uids_[nodes_[root].lo].substr(0, MATCH_LEFT)), root});
+        muted_.assign((uids_.size() + WORD_BITS - 1) / WORD_BITS, 0);
+    }
+
+    /**
+     * @return number of UIDs in the index (duplicates included)
+     */
+    size_t size() const { return uids_.size(); }
+
+    /**
+     * @return UID stored under the given ordinal
+     */
+    std::string_view uid(size_t ordinal) const { return uids_[ordinal]; }
+
+    /**
+     * @return every UID, in index order
+     */
+    const UidArena &uids() const { return uids_; }
+
+    /**
+     * @brief Calls `fn(ordinal)` for every active UID matching `input`.
+     *
+     * Ordinals are reported in index order, which is stable for a given
+     * population but unrelated to the order the UIDs were passed in.
+     */
+    template <typename Fn>
+    void forEachMatch(std::string_view input, Fn &&fn) const
+    {
+        if (CharClass::hasClass(input)) {
+            for (const auto &r : classRanges(input))
+                visitRange(r.first, r.second, fn);
+            return;
+        }
+        if (batch_) {
+            batch_->forEachMatch(input, muted_.data(), fn);
+            return;
+        }
+        uint32_t lo, hi;
+        if (range(input, lo, hi))
+            visitRange(lo, hi, fn);
+    }
+
+    /**
+     * @brief Counts the active UIDs matching `input` without visiting
+     *        them one by one, stopping once `limit` are found (2 tells
+     *        "one" from "a collision").
+     *
+     * @return the count, exact below `limit` and at least `limit`
+     *         otherwise, and the smallest matching ordinal
+     */
+    BatchMatcher::Result countMatches(std::string_view input,
+        size_t limit = SIZE_MAX) const
+    {
+        BatchMatcher::Result r;
+        if (CharClass::hasClass(input)) {
+            for (const auto &range : classRanges(input))
+                countRange(range.first, range.second, r, limit);
+            return r;
+        }
+        if (batch_)
+            return batch_->match(input, muted_.data(), limit);
+
+        uint32_t lo, hi;
+        if (range(input, lo, hi))
+            countRange(lo, hi, r, limit);
+        return r;
+    }
+
+    /**
+     * @brief Answers queries with a BatchMatcher using `isa` instead of
+     *        the trie.
+     *
+     * @return false (and nothing changes) if `isa` is not supported here
+     */
+    bool useBatch(BatchMatcher::Isa isa)
+    {
+        if (!BatchMatcher::supported(isa))
+            return false;
+        if (!batch_)
+            batch_.emplace(uids_);
+        return batch_->setIsa(isa);
+    }
+
+    /**
+     * @brief Goes back to trie queries (the default).
+     */
+    void useTrie() { batch_.reset(); }
+
+    /**
+     * @return the batch matcher in use, nullptr for the trie
+     */
+    const BatchMatcher *batch() const
+    {
+        return batch_ ? &*batch_ : nullptr;
+    }
+
+    /**
+     * @brief Returns a copy of every active UID matching `input`.
+     */
+    std::vector<std::string> match(std::string_view input) const
+    {
+        std::vector<std::string> result;
+        forEachMatch(input,
+            [&](size_t ordinal) { result.emplace_back(uids_[ordinal]); });
+        return result;
+    }
+
+    /**
+     * @brief Looks up the ordinal of a full UID.
+     *
+     * Duplicates occupy consecutive ordinals; the first one is returned.
+     *
+     * @return false if `uid` is not part of the population
+     */
+    bool ordinal(std::string_view uid, size_t &out) const
+    {
+        uint32_t n = terminal(uid);
+        if (n == NONE)
+            return false;
+        out = nodes_[n].lo;
+        return true;
+    }
+
+    /**
+     * @return true if `uid` is part of the population
+     */
+    bool contains(std::string_view uid) const
+    {
+        return terminal(uid) != NONE;
+    }
+
+    /**
+     * @return true if the UID under `ordinal` is muted
+     */
+    bool isMuted(size_t ordinal) const
+    {
+        return (muted_[ordinal / WORD_BITS] >> (ordinal % WORD_BITS)) & 1;
+    }
+
+    /**
+     * @return true if `uid` is part of the population and muted
+     */
+    bool isMuted(std::string_view uid) const
+    {
+        size_t o;
+        return ordinal(uid, o) && isMuted(o);
+    }
+
+    /**
+     * @brief Mutes a UID so it no longer matches any pattern.
+     *
+     * @return false if `uid` is unknown; muting an already muted UID is
+     *         not an error
+     */
+    bool mute(std::string_view uid)
+    {
+        uint32_t n = terminal(uid);
+        if (n == NONE)
+            return false;
+        for (uint32_t i = nodes_[n].lo; i < nodes_[n].lo + nodes_[n].term;
+             ++i)
+            muted_[i / WORD_BITS] |= uint64_t(1) << (i % WORD_BITS);
+        return true;
+    }
+
+    /**
+     * @brief Lets a muted UID respond again.
+     *
+     * @return false if `uid` is unknown or was not muted
+     */
+    bool unmute(std::string_view uid)
+    {
+        uint32_t n = terminal(uid);
+        if (n == NONE || !isMuted(nodes_[n].lo))
+            return false;
+        for (uint32_t i = nodes_[n].lo; i < nodes_[n].lo + nodes_[n].term;
+             ++i)
+            muted_[i / WORD_BITS] &= ~(uint64_t(1) << (i % WORD_BITS));
+        return true;
+    }
+
+    /**
+     * @brief Unmutes the whole population.
+     */
+    void unmuteAll()
+    {
+        std::fill(muted_.begin(), muted_.end(), 0);
+    }
+
+    /**
+     * @return the muted state, one bit per ordinal, 64 to a word
+     */
+    const std::vector<uint64_t> &mutedWords() const { return muted_; }
+
+    /**
+     * @brief Replaces the muted state by one taken with mutedWords()
+     *        from an index over the same population.
+     *
+     * @return false (and nothing changes) if the size does not fit
+     */
+    bool setMutedWords(const std::vector<uint64_t> &words)
+    {
+        if (words.size() != muted_.size())
+            return false;
+        muted_ = words;
+        const size_t tail = uids_.size() % WORD_BITS;
+        if (tail) // no bits beyond the last ordinal
+            muted_.back() &= (uint64_t(1) << tail) - 1;
+        return true;
+    }
+
+    /**
+     * @brief Hash (64-bit FNV-1a) over the population in index order;
+     *        tells whether saved state belongs to this population.
+     */
+    uint64_t fingerprint() const
+    {
+        uint64_t h = 14695981039346656037ull;
+        for (size_t i = 0; i < uids_.size(); ++i) {
+            for (char c : uids_[i])
+                h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+            h = (h ^ '\n') * 1099511628211ull;
+        }
+        return h;
+    }
+
+private:
+    static constexpr size_t MATCH_LEFT = AisgUid::PREFIX;
+    static constexpr uint32_t NONE = UINT32_MAX;
+    static constexpr size_t WORD_BITS = 64;
+    static constexpr size_t CACHED = 16;
+
+    /**
+     * trie node; covers the UIDs [lo, hi) in index order, the first
+     * `term` of which end exactly at this node
+     */
+    struct Node {
+        uint32_t lo = 0;
+        uint32_t hi = 0;
+        uint32_t child = 0; // first child, children are contiguous
+        uint32_t nchild = 0;
+        uint32_t term = 0;
+        uint32_t ch = 0; // a whole word: no padding bytes in an image
+    };
+    static_assert(sizeof(Node) == NODE_SIZE, "image layout");
+
+    struct Bucket {
+        std::string key;
+        uint32_t root;
+    };
+
+    struct Cached {
+        std::string pattern;
+        uint32_t node = 0;
+    };
+
+    /**
+     * index order: by two-character key, then by the remainder read
+     * backwards (as unsigned bytes, like std::string::compare)
+     */
+    static bool less(std::string_view a, std::string_view b)
+    {
+        int c = a.compare(0, MATCH_LEFT, b, 0, MATCH_LEFT);
+        if (c != 0)
+            return c < 0;
+        size_t ia = a.size(), ib = b.size();
+        while (ia > MATCH_LEFT && ib > MATCH_LEFT) {
+            auto ca = static_cast<unsigned char>(a[--ia]);
+            auto cb = static_cast<unsigned char>(b[--ib]);
+            if (ca != cb)
+                return ca < cb;
+        }
+        return ia < ib;
+    }
+
+    /**
+     * character `depth` positions from the end of the UID
+     */
+    unsigned char tailChar(size_t ordinal, size_t depth) const
+    {
+        std::string_view u = uids_[ordinal];
+        return static_cast<unsigned char>(u[u.size() - 1 - depth]);
+    }
+
+    size_t tailLen(size_t ordinal) const
+    {
+        std::string_view u = uids_[ordinal];
+        return u.size() > MATCH_LEFT ? u.size() - MATCH_LEFT : 0;
+    }
+
+    void build(std::vector<Node> &nodes, uint32_t n, size_t depth)
+    {
+        uint32_t lo = nodes[n].lo, hi = nodes[n].hi;
+
+        uint32_t i = lo;
+        while (i < hi && tailLen(i) == depth)
+            ++i;
+        nodes[n].term = i - lo;
+        if (i == hi)
+            return;
+
+        // one child per distinct character, allocated as one block
+        uint32_t first = static_cast<uint32_t>(nodes.size());
+        while (i < hi) {
+            unsigned char c = tailChar(i, depth);
+            uint32_t j = i;
+            while (j < hi && tailChar(j, depth) == c)
+                ++j;
+            Node child;
+            child.lo = i;
+            child.hi = j;
+            child.ch = c;
+            nodes.push_back(child);
+            i = j;
+        }
+        nodes[n].child = first;
+        nodes[n].nchild = static_cast<uint32_t>(nodes.size()) - first;
+
+        for (uint32_t c = first; c < first + nodes[n].nchild; ++c)
+            build(nodes, c, depth + 1);
+    }
+
+    uint32_t childOf(uint32_t n, unsigned char c) const
+    {
+        auto first = nodes_.begin() + nodes_[n].child;
+        auto last = first + nodes_[n].nchild;
+        auto it = std::lower_bound(first, last, c,
+            [](const Node &node, unsigned char ch) {
+                return node.ch < ch;
+            });
+        if (it == last || it->ch != c)
+            return NONE;
+        return static_cast<uint32_t>(it - nodes_.begin());
+    }
+
+    /**
+     * walks to the node for the first `len` characters of `s`
+     * (len >= MATCH_LEFT)
+     */
+    uint32_t find(std::string_view s, size_t len) const
+    {
+        auto it = std::lower_bound(buckets_.begin(), buckets_.end(), s,
+            [](const Bucket &b, std::string_view k) {
+                return b.key.compare(0, MATCH_LEFT, k, 0, MATCH_LEFT) < 0;
+            });
+        if (it == buckets_.end() ||
+            it->key.compare(0, MATCH_LEFT, s, 0, MATCH_LEFT) != 0)
+            return NONE;
+
+        uint32_t n = it->root;
+        for (size_t i = len; i > MATCH_LEFT && n != NONE; --i)
+            n = childOf(n, static_cast<unsigned char>(s[i - 1]));
+        return n;
+    }
+
+    /**
+     * ordinal range [lo, hi) of the UIDs matching `input`, muted ones
+     * included
+     *
+     * @return false if nothing can match
+     */
+    bool range(std::string_view input, uint32_t &lo, uint32_t &hi) const
+    {
+        if (input.empty())
+            return false;
+
+        if (input.size() < MATCH_LEFT) {
+            // a one-character pattern spans every bucket it starts
+            auto it = std::lower_bound(buckets_.begin(), buckets_.end(),
+                input, [](const Bucket &b, std::string_view k) {
+                    return b.key < k;
+                });
+            // buckets are adjacent, so are their ordinal ranges
+            auto last = it;
+            while (last != buckets_.end() && last->key[0] == input[0])
+                ++last;
+            if (last == it)
+                return false;
+            lo = nodes_[it->root].lo;
+            hi = nodes_[(last - 1)->root].hi;
+            return true;
+        }
+
+        uint32_t n = findCached(input);
+        if (n == NONE)
+            return false;
+        lo = nodes_[n].lo;
+        hi = nodes_[n].hi;
+        return true;
+    }
+
+    /**
+     * find() for a whole pattern, by way of the cache: the pattern
+     * itself, or the one it extends by the character after the prefix
+     */
+    uint32_t findCached(std::string_view s) const
+    {
+        for (size_t i = 0; i < cached_; ++i) {
+            const std::string &p = cache_[i].pattern;
+            uint32_t n;
+            if (p.size() == s.size() && p == s) {
+                n = cache_[i].node;
+            } else if (p.size() + 1 == s.size() &&
+                s.compare(0, MATCH_LEFT, p, 0, MATCH_LEFT) == 0 &&
+                s.substr(MATCH_LEFT + 1) ==
+                    std::string_view(p).substr(MATCH_LEFT)) {
+                n = childOf(cache_[i].node,
+                    static_cast<unsigned char>(s[MATCH_LEFT]));
+            } else {
+                continue;
+            }
+            // most recent first
+            std::rotate(cache_.begin(), cache_.begin() + i,
+                cache_.begin() + i + 1);
+            remember(s, n);
+            return n;
+        }
+        uint32_t n = find(s, s.size());
+        remember(s, n);
+        return n;
+    }
+
+    /**
+     * puts the node of `s` first in the cache, if more than one UID
+     * hangs below: a node of one has no refinements to speed up
+     */
+    void remember(std::string_view s, uint32_t n) const
+    {
+        if (n == NONE || nodes_[n].hi - nodes_[n].lo < 2 ||
+            (cached_ > 0 && cache_[0].pattern == s))
+            return;
+        if (cached_ < CACHED)
+            ++cached_;
+        // the oldest entry's string is reused, capacity and all
+        std::rotate(cache_.begin(), cache_.begin() + cached_ - 1,
+            cache_.begin() + cached_);
+        cache_[0].pattern.assign(s);
+        cache_[0].node = n;
+    }
+
+    using Ranges = std::vector<std::pair<uint32_t, uint32_t>>;
+
+    /**
+     * ordinal ranges of a pattern with classes, muted UIDs included, in
+     * index order: every bucket whose key the left part takes, and in
+     * it every node the right part leads to
+     */
+    Ranges classRanges(std::string_view input) const
+    {
+        Ranges out;
+        std::vector<CharClass> pos;
+        for (size_t at = 0; at < input.size();) {
+            pos.emplace_back();
+            if (!pos.back().parse(input, at))
+                return out;
+        }
+        const size_t left = std::min(pos.size(), MATCH_LEFT);
+        for (const Bucket &b : buckets_) {
+            size_t i = 0;
+            while (i < left && i < b.key.size() &&
+                pos[i].contains(static_cast<unsigned char>(b.key[i])))
+                ++i;
+            if (i == left)
+                collect(b.root, pos, pos.size(), out);
+        }
+        return out;
+    }
+
+    /**
+     * adds the nodes below `n` that positions [MATCH_LEFT, `end`) of
+     * `pos` lead to, the last position first
+     */
+    void collect(uint32_t n, const std::vector<CharClass> &pos,
+        size_t end, Ranges &out) const
+    {
+        if (end <= MATCH_LEFT) {
+            out.emplace_back(nodes_[n].lo, nodes_[n].hi);
+            return;
+        }
+        const CharClass &c = pos[end - 1];
+        unsigned char ch = 0;
+        if (c.single(ch)) {
+            const uint32_t child = childOf(n, ch);
+            if (child != NONE)
+                collect(child, pos, end - 1, out);
+            return;
+        }
+        for (uint32_t k = nodes_[n].child;
+             k < nodes_[n].child + nodes_[n].nchild; ++k) {
+            if (c.contains(static_cast<unsigned char>(nodes_[k].ch)))
+                collect(k, pos, end - 1, out);
+        }
+    }
+
+    /**
+     * terminal node of a full UID, NONE if it is not in the population
+     */
+    uint32_t terminal(std::string_view uid) const
+    {
+        if (uid.empty())
+            return NONE;
+        uint32_t n;
+        if (uid.size() < MATCH_LEFT) {
+            auto it = std::lower_bound(buckets_.begin(), buckets_.end(),
+                uid, [](const Bucket &b, std::string_view k) {
+                    return b.key < k;
+                });
+            n = (it != buckets_.end() && it->key == uid) ? it->root : NONE;
+        } else {
+            n = find(uid, uid.size());
+        }
+        return (n != NONE && nodes_[n].term > 0) ? n : NONE;
+    }
+
+    /**
+     * reports every unmuted ordinal in [lo, hi), a word at a time
+     */
+    template <typename Fn>
+    void visitRange(size_t lo, size_t hi, Fn &fn) const
+    {
+        while (lo < hi) {
+            size_t w = lo / WORD_BITS;
+            uint64_t bits = ~muted_[w] >> (lo % WORD_BITS);
+            size_t end = std::min(hi, (w + 1) * WORD_BITS);
+            while (bits != 0) {
+                size_t i = lo + static_cast<size_t>(__builtin_ctzll(bits));
+                if (i >= end)
+                    break;
+                fn(i);
+                bits &= bits - 1;
+            }
+            lo = end;
+        }
+    }
+
+    /**
+     * adds the unmuted ordinals in [lo, hi) to `r`, a word at a time
+     */
+    void countRange(size_t lo, size_t hi, BatchMatcher::Result &r,
+        size_t limit) const
+    {
+        while (lo < hi && r.count < limit) {
+            size_t w = lo / WORD_BITS;
+            size_t end = std::min(hi, (w + 1) * WORD_BITS);
+            uint64_t bits = ~muted_[w] >> (lo % WORD_BITS);
+            if (end - lo < WORD_BITS)
+                bits &= (uint64_t(1) << (end - lo)) - 1;
+            if (bits != 0) {
+                if (r.count == 0)
+                    r.first = lo + static_cast<size_t>(
+                        __builtin_ctzll(bits));
+                r.count += static_cast<size_t>(__builtin_popcountll(bits));
+            }
+            lo = end;
+        }
+    }
+
+    UidArena uids_;                 // index order
+    MappedArray<Node> nodes_;
+    std::vector<Bucket> buckets_;   // sorted by key
+    std::vector<uint64_t> muted_;   // bit per ordinal
+    std::optional<BatchMatcher> batch_;
+    mutable std::array<Cached, CACHED> cache_; // see findCached()
+    mutable size_t cached_ = 0;
+};
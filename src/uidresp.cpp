@@ -1,16 +1,77 @@
+#include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <optional>
 #include <random>
-#include <set>
 #include <string>
 #include <vector>
 
-#include "uidresp.h"
+#include "lineio.h"
+#include "uidarena.h"
+#include "uidbus.h"
+#include "uidfile.h"
+#include "uidserver.h"
+#include "vendortable.h"
+
+/**
+ *  check seed parameter for valid value
+ */
+bool parse_seed(const char *arg, unsigned long &value_out)
+{
+    char *endptr = nullptr;
+    errno = 0;
+    unsigned long val = std::strtoul(arg, &endptr, 10);
+
+    if (errno != 0 || endptr == arg || *endptr != '\0' || *arg == '-') {
+        return false;
+    }
+
+    value_out = val;
+    return true;
+}
+
+volatile sig_atomic_t gl_stop = 0;
+
+void on_stop_signal(int)
+{
+    gl_stop = 1;
+}
+
+/**
+ * @brief print the bus statistics on stderr in `format`, if any
+ */
+void report_stats(const UidBus &bus, const std::string &format)
+{
+    if (format == "json")
+        bus.stats().writeJson(std::cerr);
+    else if (format == "text")
+        bus.stats().writeText(std::cerr);
+}
+
+void usage(const char *progname)
+{
+    std::cerr << "usage: " << progname
+        << " [--seed|-s <n>] [--profile|-p <vendor>=<profile> ...]"
+        << " [--matcher|-m <trie|auto|scalar|sse2|avx2|neon>]"
+        << " [--uid-file|-f <file> ...] [--restore|-r <snapshot>]"
+        << " [--snapshot-dir <dir>] [--remote-snapshots]"
+        << " [--pack <file>] [--compile <file> ... --output|-o <image>]"
+        << " [--image|-i <image>]"
+        << " [--listen|-l <unix:<path>|tcp:[<host>:]<port>> ...]"
+        << " [--stats[=text|json]] [--response-mode normal|fast-collision]"
+        << " [<uid1> <uid2> ...]\n";
+}
 
 /**
  * @brief Simple UID responder tool.
  *
- * Reads UID patterns from stdin and prints:
+ * Reads UID patterns from stdin and prints (see `uidbus.h`):
  * - exact match if exactly one UID matches,
  * - a generated collision string if multiple match,
  * - nothing if no match.
@@ -18,94 +79,286 @@
  * Matching is done using the rule:
  * - first two bytes of input must match UID start,
  * - remaining bytes must match UID end.
+ * A character class such as `[0-9A-F]` stands for any one of its
+ * characters (see `charclass.h`).
  *
  * Example:
  * ./uidtool 12341234 12349875976 12340870987076
  * → then type patterns interactively
  *
+ * `--seed|-s <n>` seeds the collision generator, so that a run with the
+ * same input and population produces the same collision strings.
+ *
+ * `--profile|-p <vendor>=<profile>` changes the collision response of
+ * one vendor prefix (`*` for all others), see `vendortable.h`.
+ *
+ * `--matcher|-m` selects how patterns are matched: `trie` (default, see
+ * `uidindex.h`) or a SIMD pass over the population (`batchmatch.h`)
+ * with the given instruction set, `auto` for the best one available.
+ *
+ * `--uid-file|-f <file>` (repeatable) adds the UIDs of a population
+ * file, text (one per line) or packed binary, read with mmap (see
+ * `uidfile.h`); the population is the files plus the arguments.
+ * `--pack <file>` writes the population as a packed file and exits.
+ * `--compile <file>` (repeatable) adds a population file the same way,
+ * and instead of serving it uidresp writes the built index as an image
+ * to `--output|-o <image>` (see `uidfile.h`). `--image|-i <image>`
+ * serves such an image, mapped read-only: nothing is parsed or built,
+ * only checked in one pass, and concurrent instances share its pages
+ * through the page cache.
+ * `--restore|-r <snapshot>` starts with a muted state saved by the
+ * `SNAPSHOT:<name>` command, so a long run can be resumed.
+ * `--snapshot-dir <dir>` is where `SNAPSHOT:<name>` and
+ * `RESTORE:<name>` keep their files, refused without it; a name is a
+ * plain file name, no '/' or "..". Socket clients may use them only
+ * with `--remote-snapshots`.
+ *
+ * `--listen|-l <endpoint>` (repeatable) serves the population to socket
+ * clients instead of stdin/stdout, at `unix:<path>` or
+ * `tcp:[<host>:]<port>`: any number of scanners, monitors
+ * (`MODE:MONITOR`) and fault injectors share the one bus, see
+ * `uidserver.h`.
+ *
+ * `--response-mode fast-collision` answers every collision with an
+ * empty line, no collision string built, from the start; a client can
+ * switch its own session with `MODE:FASTCOLLISION` / `MODE:NORMAL`
+ * either way (see `uidscan --fast-collision`).
+ *
+ * `--stats[=text|json]` counts lines, match results, collision sizes
+ * and the time spent building collision replies, reported on stderr
+ * when the input ends or the server is stopped.
+ *
+ * Pipelined framing (see `uidscan --pipeline`): a line `@<tag>:<line>`
+ * is handled like `<line>`, and its reply, if any, is prefixed with the
+ * same `@<tag>:`. `SYNC:<token>` is echoed back as is; since lines are
+ * answered in order, the echo tells that all earlier lines are done. A
+ * bare `SYNC` is a pattern (vendor `SY`).
+ *
+ * Replies are buffered while more input lines are already waiting and
+ * written together once they run out, so a pipelined window is answered
+ * with a single write.
+ *
  * @param argc number of arguments
  * @param argv list of full UIDs to scan against
  * @return 0 on success, 1 on invalid usage
  */
-
 int main(int argc, char **argv)
 {
-    UidResponder responder;
+    const struct option long_opts[] = {
+        {"seed", required_argument, nullptr, 's'},
+        {"profile", required_argument, nullptr, 'p'},
+        {"matcher", required_argument, nullptr, 'm'},
+        {"uid-file", required_argument, nullptr, 'f'},
+        {"restore", required_argument, nullptr, 'r'},
+        {"pack", required_argument, nullptr, 'P'},
+        {"compile", required_argument, nullptr, 'C'},
+        {"output", required_argument, nullptr, 'o'},
+        {"image", required_argument, nullptr, 'i'},
+        {"listen", required_argument, nullptr, 'l'},
+        {"stats", optional_argument, nullptr, 'x'},
+        {"response-mode", required_argument, nullptr, 'M'},
+        {"snapshot-dir", required_argument, nullptr, 'D'},
+        {"remote-snapshots", no_argument, nullptr, 'R'},
+        {nullptr, 0, nullptr, 0}
+    };
 
-    if (argc < 2) {
-        std::cerr << "usage: " << argv[0] << " <uid1> <uid2> ...\n";
-        return 1;
+    unsigned long seed = std::random_device{}();
+    VendorTable vendors;
+    std::string matcher = "trie";
+    BatchMatcher::Isa isa = BatchMatcher::Isa::Scalar;
+    UidArena uids;
+    std::string restore_path;
+    std::string snapshot_dir;
+    bool remote_snapshots = false;
+    std::string pack_path;
+    bool compile = false;
+    std::string output_path;
+    std::string image_path;
+    std::vector<std::string> listen;
+    std::string stats; // empty: none
+    UidBus::Session session;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "s:p:m:f:r:l:o:i:",
+        long_opts, nullptr)) != -1) {
+        switch (opt) {
+        case 's':
+            if (!parse_seed(optarg, seed)) {
+                std::cerr << "Invalid seed value: " << optarg
+                    << std::endl;
+                return 1;
+            }
+            break;
+        case 'p':
+            if (!vendors.parse(optarg)) {
+                std::cerr << "Invalid profile: " << optarg << std::endl;
+                return 1;
+            }
+            break;
+        case 'm':
+            matcher = optarg;
+            if (matcher != "trie" &&
+                !BatchMatcher::parseIsa(matcher, isa)) {
+                std::cerr << "Invalid matcher: " << optarg << std::endl;
+                return 1;
+            }
+            break;
+        case 'C':
+            compile = true;
+            // fall through
+        case 'f':
+            if (!UidFile::load(optarg, uids)) {
+                std::cerr << "Can't read uid file " << optarg << ": "
+                    << std::strerror(errno) << std::endl;
+                return 1;
+            }
+            break;
+        case 'r':
+            restore_path = optarg;
+            break;
+        case 'D':
+            snapshot_dir = optarg;
+            break;
+        case 'R':
+            remote_snapshots = true;
+            break;
+        case 'P':
+            pack_path = optarg;
+            break;
+        case 'o':
+            output_path = optarg;
+            break;
+        case 'i':
+            image_path = optarg;
+            break;
+        case 'l':
+            listen.push_back(optarg);
+            break;
+        case 'x':
+            stats = optarg ? optarg : "text";
+            if (stats != "text" && stats != "json") {
+                std::cerr << "Invalid stats format: " << stats
+                    << std::endl;
+                return 1;
+            }
+            break;
+        case 'M':
+            if (std::strcmp(optarg, "normal") != 0 &&
+                std::strcmp(optarg, "fast-collision") != 0) {
+                std::cerr << "Invalid response mode: " << optarg
+                    << std::endl;
+                return 1;
+            }
+            session.fastCollision = optarg[0] == 'f';
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
     }
 
-    std::vector<std::string> uids(argv + 1, argv + argc);
-    std::set<std::string> muted;
-
-    std::string line;
-    while (std::getline(std::cin, line)) {
-        if (line.empty())
-            continue;
-
-        // SETADDR:<uid>
-        if (line.rfind("SETADDR:", 0) == 0) {
-            std::string uid = line.substr(8);
-            auto it = std::find(uids.begin(), uids.end(), uid);
-            if (it != uids.end()) {
-                muted.insert(uid);
-                std::cout << uid << std::endl;
-            } 
-            continue;
+    for (int i = optind; i < argc; ++i) {
+        if (!uids.push_back(argv[i])) {
+            std::cerr << "UID too long: " << std::strlen(argv[i])
+                << " characters" << std::endl;
+            return 1;
         }
+    }
+    if (compile != !output_path.empty()) {
+        std::cerr << "--compile and --output go together" << std::endl;
+        return 1;
+    }
+    if (!image_path.empty() &&
+        (!uids.empty() || compile || !pack_path.empty())) {
+        std::cerr << "--image is the whole population: no uids, uid"
+            << " files or --pack with it" << std::endl;
+        return 1;
+    }
+    if (uids.empty() && image_path.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
 
-        // RESETADDR:<uid>
-        if (line.rfind("RESETADDR:", 0) == 0) {
-            std::string uid = line.substr(10);
-            auto it = muted.find(uid);
-            if (it != muted.end()) {
-                muted.erase(it);
-                std::cerr << "[unmuted] " << uid << std::endl;
-            } else {
-                std::cerr
-                    << "[warn] tried to unmute unknown or active uid: "
-                    << uid << std::endl;
-            }
-            continue;
+    if (!pack_path.empty()) {
+        if (!UidFile::writePacked(pack_path, uids)) {
+            std::cerr << "Can't write " << pack_path << ": "
+                << std::strerror(errno) << std::endl;
+            return 1;
         }
+        return 0;
+    }
 
-        // RESETALL
-        if (line == "RESETALL") {
-            muted.clear();
-            std::cerr << "[unmuted all]" << std::endl;
-            continue;
+    if (compile) {
+        if (!UidFile::writeImage(output_path, UidIndex(std::move(uids)))) {
+            std::cerr << "Can't write " << output_path << ": "
+                << std::strerror(errno) << std::endl;
+            return 1;
         }
+        return 0;
+    }
 
-        // normal pattern matching
-        std::vector<std::string> matched;
-        for (const auto &uid : uids) {
-            if (muted.count(uid))
-                continue;
-            if (responder.matches(line, uid))
-                matched.push_back(uid);
-        }
+    std::optional<UidIndex> image;
+    if (!image_path.empty() && !UidFile::loadImage(image_path, image)) {
+        std::cerr << "Can't map image " << image_path << ": "
+            << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    UidBus bus = image ? UidBus(std::move(*image), vendors, seed)
+                       : UidBus(std::move(uids), vendors, seed);
+    bus.setStats(!stats.empty());
+    bus.setDefaultSession(session);
+    bus.setSnapshotDir(snapshot_dir);
+    if (!restore_path.empty() &&
+        !UidFile::loadMuted(restore_path, bus.index())) {
+        std::cerr << "Can't restore " << restore_path << ": "
+            << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    if (matcher != "trie" && !bus.index().useBatch(isa)) {
+        std::cerr << "Matcher not supported on this machine: " << matcher
+            << std::endl;
+        return 1;
+    }
 
-        if (matched.empty())
-            continue;
-
-        if (matched.size() == 1) {
-            std::cout << matched[0] << std::endl;
-        } else {
-            std::string noise = responder.generateCollision(matched);
-            if (matched[0].size() >= 2 && matched[0][0] == 'C' &&
-                matched[0][1] == 'B') {
-                // CB vendor returns empty line
-                noise = "";
-            } else {
-                // all others return mix of symbols
-                noise = responder.generateCollision(matched);
+    if (!listen.empty()) {
+        UidServer server(bus);
+        server.setSnapshots(remote_snapshots);
+        for (const auto &spec : listen) {
+            if (!server.listen(spec)) {
+                std::cerr << "Can't listen on " << spec << ": "
+                    << std::strerror(errno) << std::endl;
+                return 1;
+            }
+        }
+        // leave through the destructor, which removes the socket files
+        struct sigaction sa = {};
+        sa.sa_handler = on_stop_signal;
+        sigaction(SIGINT, &sa, nullptr);
+        sigaction(SIGTERM, &sa, nullptr);
+        while (!gl_stop) {
+            if (!server.poll()) {
+                std::cerr << "Server failed: " << std::strerror(errno)
+                    << std::endl;
+                return 1;
             }
-            std::cout << noise << std::endl;
         }
-        std::cout.flush();
+        report_stats(bus, stats);
+        return 0;
+    }
+
+    LineReader in(STDIN_FILENO);
+    LineWriter out(STDOUT_FILENO);
+    std::string line;
+    std::string reply;
+    for (;;) {
+        if (!in.buffered())
+            out.flush(); // about to wait for input
+        if (!in.readLine(line))
+            break;
+        if (bus.handle(line, reply))
+            out.put(reply);
     }
+    out.flush();
+    report_stats(bus, stats);
 
     return 0;
 }
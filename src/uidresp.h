@@ -1,11 +1,15 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <random>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "uidformat.h"
+
 /**
  * @class UidResponder
  * @brief Provides UID matching and random collision generation.
@@ -22,14 +26,18 @@ public:
      * - the first two characters match the beginning of the UID
      * - the remaining characters match the end of the UID
      *
+     * Either part may hold character classes, see CharClass.
+     *
      * @param input Partial UID pattern from scan command.
      * @param uid   Full UID to compare against.
      * @return true if input matches the UID; false otherwise.
      */
-    static bool matches(const std::string &input, const std::string &uid)
+    static bool matches(std::string_view input, std::string_view uid)
     {
         if (input.empty())
             return false;
+        if (CharClass::hasClass(input))
+            return CharClass::matches(input, uid, MATCH_LEFT);
         const size_t len = input.size();
         if (len > uid.size())
             return false;
@@ -48,6 +56,44 @@ public:
         return true;
     }
 
+    /**
+     * @brief Counts the UIDs matching `input`, stopping at `limit`.
+     *
+     * Telling "none", "exactly one" and "a collision" apart needs
+     * `limit` = 2; nothing is copied.
+     *
+     * @param uids  Random-access list of UIDs (strings or string views).
+     * @param first Receives the index of the first match, if any.
+     * @return number of matches, at most `limit`
+     */
+    template <typename Uids>
+    static size_t countMatches(std::string_view input, const Uids &uids,
+        size_t limit = SIZE_MAX, size_t *first = nullptr)
+    {
+        size_t n = 0;
+        for (size_t i = 0; i < uids.size() && n < limit; ++i) {
+            if (!matches(input, uids[i]))
+                continue;
+            if (n++ == 0 && first)
+                *first = i;
+        }
+        return n;
+    }
+
+    /**
+     * @brief Appends views of all UIDs matching `input` to `out`; the
+     *        views point into `uids`.
+     */
+    template <typename Uids>
+    static void collectMatches(std::string_view input, const Uids &uids,
+        std::vector<std::string_view> &out)
+    {
+        for (const auto &uid : uids) {
+            if (matches(input, uid))
+                out.emplace_back(uid);
+        }
+    }
+
     /**
      * @brief Generates a pseudo-random collision string.
      *
@@ -62,33 +108,94 @@ public:
      * @return Randomized string formed from characters in matched UIDs.
      */
     static std::string generateCollision(
-        const std::vector<std::string> &uids, size_t maxLen = 19)
+        const std::vector<std::string> &uids,
+        size_t maxLen = AisgUid::LENGTH)
     {
         std::string result;
-        std::mt19937 rng(std::random_device{}());
+        generateCollision(uids, defaultRng(), result, maxLen);
+        return result;
+    }
+
+    /**
+     * @brief Allocation-free form of generateCollision().
+     *
+     * Same result distribution, but draws from a caller-owned generator
+     * and writes into a caller-owned buffer, so a seeded generator makes
+     * the output reproducible and a reused buffer keeps its capacity.
+     * Column characters are read straight from the UIDs.
+     *
+     * @param uids   Random-access list of matching UIDs (any string-like
+     *               type with size() and operator[]).
+     * @param rng    Uniform random bit generator, e.g. std::mt19937.
+     * @param out    Receives the collision string; previous content is
+     *               discarded.
+     * @param maxLen Maximum length of the generated string.
+     */
+    template <typename Uids, typename Rng>
+    static void generateCollision(const Uids &uids, Rng &rng,
+        std::string &out, size_t maxLen = AisgUid::LENGTH)
+    {
+        mixColumns(uids, rng, out, maxLen);
+        if (uids.size() > 1) {
+            randomizeFromFifthChar(out, rng);
+        }
+    }
+
+    /**
+     * @brief The column pass of generateCollision(), before the tail is
+     *        randomized: column i is that of one of the UIDs reaching
+     *        it, picked at random, up to `maxLen` columns.
+     */
+    template <typename Uids, typename Rng>
+    static void mixColumns(const Uids &uids, Rng &rng, std::string &out,
+        size_t maxLen = AisgUid::LENGTH)
+    {
+        out.clear();
+        if (uids.size() == 0)
+            return;
+
+        size_t minLen = uids[0].size();
+        for (const auto &uid : uids)
+            minLen = std::min<size_t>(minLen, uid.size());
 
         for (size_t i = 0; i < maxLen; ++i) {
-            std::vector<char> candidates;
-            for (const auto &uid : uids) {
-                if (i < uid.size())
-                    candidates.push_back(uid[i]);
+            // columns every UID reaches: pick a UID directly
+            if (i < minLen) {
+                std::uniform_int_distribution<size_t> dist(0,
+                    uids.size() - 1);
+                out.push_back(uids[dist(rng)][i]);
+                continue;
             }
 
-            if (candidates.empty())
+            size_t n = 0;
+            for (const auto &uid : uids)
+                if (i < uid.size())
+                    ++n;
+            if (n == 0)
                 break;
 
-            std::uniform_int_distribution<size_t> dist(0,
-                candidates.size() - 1);
-            result.push_back(candidates[dist(rng)]);
-        }
-
-        if(uids.size() > 1) {
-            randomizeFromFifthChar(result);
+            std::uniform_int_distribution<size_t> dist(0, n - 1);
+            size_t k = dist(rng);
+            for (const auto &uid : uids) {
+                if (i < uid.size() && k-- == 0) {
+                    out.push_back(uid[i]);
+                    break;
+                }
+            }
         }
-        return result;
     }
 
     static void randomizeFromFifthChar(std::string& str) {
+        randomizeFromFifthChar(str, defaultRng());
+    }
+
+    /**
+     * @brief randomizeFromFifthChar() drawing from a caller-owned
+     *        generator.
+     */
+    template <typename Rng>
+    static void randomizeFromFifthChar(std::string &str, Rng &rng)
+    {
         if (str.size() <= 5) return; // нечего менять
 
         static const char charset[] =
@@ -96,8 +203,7 @@ public:
             "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
             "0123456789";
 
-        static std::mt19937 rng{std::random_device{}()};
-        static std::uniform_int_distribution<> dist(0, sizeof(charset) - 2); // -2, чтобы не брать '\0'
+        std::uniform_int_distribution<> dist(0, sizeof(charset) - 2); // -2, чтобы не брать '\0'
 
         for (size_t i = 5; i < str.size(); ++i) {
             str[i] = charset[dist(rng)];
@@ -106,5 +212,15 @@ public:
 
 
 private:
-    static constexpr size_t MATCH_LEFT = 2;
+    static constexpr size_t MATCH_LEFT = AisgUid::PREFIX;
+
+    /**
+     * generator behind the overloads without an explicit one; seeded
+     * once per thread
+     */
+    static std::mt19937 &defaultRng()
+    {
+        thread_local std::mt19937 rng{std::random_device{}()};
+        return rng;
+    }
 };
@@ -10,223 +10,508 @@
  * usage:
  * - sends string (with prefix) to stdout
  * - reads lines from stdin
- * - detects uid collisions and recursively refines pattern
+ * - detects uid collisions and refines the pattern (see scanengine.h)
  * - confirms uid by repeating pattern
  * - mutes confirmed uids using setaddr command
+ * - optionally (`--pipeline`) sends all sibling probes of a tree node in
+ *   one write and matches the tagged replies back
+ * - optionally (`--bus`, repeated) scans several buses at the same time
+ *   instead of stdin/stdout and merges the results
+ * - optionally (`--channels`) walks subtrees in parallel on several
+ *   connections to one bus
+ * - optionally (`--simulate`) scans a simulated population in-process
+ * - optionally (`--replay`) scans a recorded trace again, on a simulated
+ *   clock (see replay.h)
+ * - optionally (`--charset`, `--learn`) narrows and orders the symbols
+ *   tried per vendor (see symbolplan.h)
+ * - optionally (`--hints`) reads collision responses for the symbols
+ *   behind them
+ * - optionally (`--inventory`) confirms the uids of the last scan first
+ *   and keeps the result for the next one
+ * - optionally (`--confirm`) mutes found uids without waiting for the
+ *   setaddr echo, checking all of them at the end of a prefix
+ * - optionally (`--fast-collision`) asks the responder to answer
+ *   collisions with an empty line
+ * - optionally (`--bisect`) probes half of the symbols of a level at
+ *   once, as a character class (see bisectscan.h)
+ * - optionally (`--stats`) reports counters and latencies of the scan
+ *   (see scanstats.h)
  *
  * expected to be used with a compatible responder (see `uidresp.cpp`)
  */
 
+#include <fcntl.h>
 #include <getopt.h>
-#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <termios.h>
 #include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <set>
 #include <string>
+#include <thread>
 #include <vector>
 
-constexpr int MAXLEN = 17; // uid length w/o prefix
-const std::string CHARSET = "0123456789"
-                            "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-                            "abcdefghijklmnopqrstuvwxyz"
-                            "-_";
-constexpr int POLL_TIMEOUT = 200;
-
+#include "bisectscan.h"
+#include "linelink.h"
+#include "parallelscan.h"
+#include "replay.h"
+#include "scanengine.h"
+#include "scanstats.h"
+#include "symbolplan.h"
+#include "trace.h"
+#include "uidbus.h"
 
 int gl_timeout = POLL_TIMEOUT;
+bool gl_pipeline = false;
+int gl_min_timeout = -1; // adaptive timeout floor, < 0 if not adaptive
+ScanEngine::CollisionHints gl_hints = ScanEngine::CollisionHints::None;
+ScanEngine::Confirm gl_confirm = ScanEngine::Confirm::Echo;
+bool gl_fast_collision = false;
+bool gl_bisect = false;
+constexpr int MIN_TIMEOUT = 5;
+
+enum { LOG_QUIET, LOG_NORMAL, LOG_VERBOSE };
+int gl_log_level = LOG_NORMAL;
 
 /**
- * @brief return reversed string
+ * @brief progress messages on stderr; safe to share between buses
  *
- * we use reverse strings in algorithm because it's much more easier to
- * append symbols to string than insert them to beginning. this
- * `reverse_string` used before sending
+ * what is printed depends on the log level: LOG_QUIET only errors,
+ * LOG_NORMAL adds found uids, LOG_VERBOSE every collision as well. a
+ * message goes out with a single write
  */
-std::string reverse_string(const std::string &line)
-{
-    return std::string(line.rbegin(), line.rend());
-}
+class StderrObserver : public ScanObserver {
+public:
+    explicit StderrObserver(int level, std::string label = "") :
+        level_(level),
+        label_(std::move(label))
+    {
+    }
+
+    void collision(const std::string &pattern, size_t level) override
+    {
+        if (level_ >= LOG_VERBOSE)
+            print("COLLISION: " + pattern + " level=" +
+                std::to_string(level));
+    }
+
+    void found(const std::string &uid) override
+    {
+        if (level_ >= LOG_NORMAL)
+            print("FOUND: " + uid);
+    }
+
+    void depthLimit(const std::string &pattern) override
+    {
+        print("ERROR: length limit reached! " + pattern);
+    }
+
+    void retracted(const std::string &uid) override
+    {
+        if (level_ >= LOG_NORMAL)
+            print("RETRACTED: " + uid + " (not confirmed)");
+    }
+
+private:
+    void print(const std::string &msg)
+    {
+        std::lock_guard<std::mutex> lock(mutex());
+        std::cerr << label_ + msg + "\n";
+    }
+
+    static std::mutex &mutex()
+    {
+        static std::mutex m;
+        return m;
+    }
+
+    int level_;
+    std::string label_;
+};
+
+/**
+ * @brief one bus to scan: where it is and what was found on it
+ */
+struct Bus {
+    std::string spec;
+    std::unique_ptr<ScanLink> link;
+    std::set<std::string> found;
+    std::unique_ptr<UidBus> sim; // devices of a simulated bus
+    ScanStats stats;
+    std::vector<std::unique_ptr<ScanLink>> channels; // more links to it
+    std::unique_ptr<std::mutex> simLock; // shared by its SimLinks
+    std::unique_ptr<Recording> recording; // of a replayed bus
+    ReplayLink *replay = nullptr;         // its link
+};
 
 /**
- * @brief read data, detect timeout and, partly, a collision (empty
- * line with "\n" is the collision, too)
+ * @brief connect to `<host>:<port>`
  *
- * @return 1. empty string if timeout
- *         2. "!" if collision because "!" is not a valid symbol in
- *            any response
- *         3. response string
+ * @return the socket, -1 (errno set) if no address of host answers
  */
-std::string read_line(int timeout_ms = POLL_TIMEOUT)
+int connect_tcp(const std::string &hostport)
 {
-    struct pollfd pfd;
-    pfd.fd = STDIN_FILENO;
-    pfd.events = POLLIN;
-
-    int ret = poll(&pfd, 1, timeout_ms);
+    size_t colon = hostport.rfind(':');
+    if (colon == std::string::npos || colon == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    std::string host = hostport.substr(0, colon);
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']')
+        host = host.substr(1, host.size() - 2);
 
-    if (ret > 0 && (pfd.revents & POLLIN)) {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *res = nullptr;
+    if (getaddrinfo(host.c_str(), hostport.c_str() + colon + 1, &hints,
+            &res) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    int fd = -1;
+    for (struct addrinfo *ai = res; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) < 0) {
+            int e = errno;
+            close(fd);
+            errno = e;
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    return fd;
+}
 
-        std::string line;
-        if (std::getline(std::cin, line)) {
+/**
+ * @brief open a bus endpoint
+ *
+ * - `-`             stdin/stdout
+ * - `fd:<n>[,<m>]`  inherited descriptors: read from n, write to m
+ *                   (default: n as well)
+ * - `unix:<path>`   UNIX stream socket
+ * - `tcp:<host>:<port>` TCP connection, e.g. to `uidresp --listen`
+ * - anything else   device or file path, opened read-write; serial
+ *                   lines are switched to raw mode
+ *
+ * @return false (with a message on stderr) if it can't be opened
+ */
+bool open_bus(const std::string &spec, int &in, int &out)
+{
+    if (spec == "-") {
+        in = STDIN_FILENO;
+        out = STDOUT_FILENO;
+        return true;
+    }
 
-            if (!line.empty())
-                return line; // normal response
+    if (spec.rfind("fd:", 0) == 0) {
+        char *endptr = nullptr;
+        const char *s = spec.c_str() + 3;
+        long a = std::strtol(s, &endptr, 10);
+        long b = a;
+        if (endptr != s && *endptr == ',') {
+            s = endptr + 1;
+            b = std::strtol(s, &endptr, 10);
+        }
+        if (endptr == s || *endptr != '\0' || a < 0 || b < 0) {
+            std::cerr << "Invalid bus: " << spec << std::endl;
+            return false;
+        }
+        in = static_cast<int>(a);
+        out = static_cast<int>(b);
+        return true;
+    }
 
-            return "!"; // collision
+    int fd;
+    if (spec.rfind("unix:", 0) == 0) {
+        struct sockaddr_un addr = {};
+        std::string path = spec.substr(5);
+        if (path.size() >= sizeof(addr.sun_path)) {
+            std::cerr << "Socket path too long: " << path << std::endl;
+            return false;
+        }
+        addr.sun_family = AF_UNIX;
+        std::copy(path.begin(), path.end(), addr.sun_path);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd,
+            reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+            close(fd);
+            fd = -1;
+        }
+    } else if (spec.rfind("tcp:", 0) == 0) {
+        fd = connect_tcp(spec.substr(4));
+    } else {
+        fd = open(spec.c_str(), O_RDWR | O_NOCTTY);
+        struct termios tio;
+        if (fd >= 0 && isatty(fd) && tcgetattr(fd, &tio) == 0) {
+            cfmakeraw(&tio);
+            tcsetattr(fd, TCSANOW, &tio);
         }
     }
-    return ""; // timeout or error
+    if (fd < 0) {
+        std::cerr << "Can't open bus " << spec << ": "
+            << std::strerror(errno) << std::endl;
+        return false;
+    }
+    in = out = fd;
+    return true;
 }
 
-
 /**
- *  self-explaining function name ;)
+ * @brief add the uids of a comma separated list to the simulated
+ *        population
  */
-void send(const std::string &line)
+void parse_uid_list(const std::string &list, std::vector<std::string> &uids)
 {
-    std::cout << line << std::endl;
-    std::cout.flush();
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos)
+            end = list.size();
+        if (end > start)
+            uids.push_back(list.substr(start, end - start));
+        start = end + 1;
+    }
 }
 
 /**
- *  self-explaining function name ;)
+ * @brief read charset assignments, one `<vendor>=<symbols>` per line
+ *        (blank lines and `#` comments skipped)
+ *
+ * @return false (with a message on stderr) if the file can't be read
+ *         or holds a malformed line
  */
-std::string send_and_recv(const std::string &line,
-    int timeout = POLL_TIMEOUT)
+bool read_charset_file(const std::string &path, SymbolPlan &plan)
 {
-    send(line);
-    return read_line(timeout);
+    std::string data;
+    std::FILE *f = std::fopen(path.c_str(), "r");
+    if (f) {
+        char buf[4096];
+        for (size_t n; (n = std::fread(buf, 1, sizeof(buf), f)) > 0;)
+            data.append(buf, n);
+        const int e = std::ferror(f) ? errno : 0;
+        std::fclose(f);
+        errno = e;
+    }
+    if (!f || errno) {
+        std::cerr << "Can't read charset file " << path << ": "
+            << std::strerror(errno) << std::endl;
+        return false;
+    }
+    size_t number = 0;
+    for (size_t at = 0; at < data.size();) {
+        size_t nl = data.find('\n', at);
+        if (nl == std::string::npos)
+            nl = data.size();
+        std::string line = data.substr(at, nl - at);
+        at = nl + 1;
+        ++number;
+        size_t b = line.find_first_not_of(" \t\r");
+        if (b == std::string::npos || line[b] == '#')
+            continue;
+        line = line.substr(b, line.find_last_not_of(" \t\r") - b + 1);
+        if (!plan.parse(line)) {
+            std::cerr << "Invalid charset in " << path << ":" << number
+                << ": " << line << std::endl;
+            return false;
+        }
+    }
+    return true;
 }
 
 /**
- *  @brief "assign" address: prevent uid from responding
+ * @brief save the inventory: all uids found, one per line. written to
+ *        a temporary file first and renamed, so a reader (or the next
+ *        run) never sees half of it
+ *
+ * @return false (with a message on stderr) if it can't be written
  */
-void mute(const std::string &uid)
+bool write_inventory(const std::string &path,
+    const std::set<std::string> &uids)
 {
-    // see `src/uidresp.cpp` for additional commands
-    send("SETADDR:" + uid);
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        out << "# uidscan inventory, " << uids.size() << " uids\n";
+        for (const auto &uid : uids)
+            out << uid << "\n";
+        out.flush();
+        if (!out) {
+            std::cerr << "Can't write inventory " << tmp << ": "
+                << std::strerror(errno) << std::endl;
+            return false;
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::cerr << "Can't write inventory " << path << ": "
+            << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
 }
 
 /**
- * @brief send command to enable all uids to respond
+ * @brief report the statistics of all buses together, to stderr or to
+ *        `path`
+ *
+ * @return false (with a message on stderr) if `path` can't be written
  */
-void reset_all()
+bool write_stats(const std::vector<Bus> &buses, const std::string &format,
+    const std::string &path, double seconds)
 {
-    send("RESETALL");
+    ScanStats all;
+    for (const auto &bus : buses)
+        all.merge(bus.stats);
+
+    std::ofstream file;
+    if (!path.empty()) {
+        file.open(path, std::ios::trunc);
+        if (!file) {
+            std::cerr << "Can't write stats " << path << ": "
+                << std::strerror(errno) << std::endl;
+            return false;
+        }
+    }
+    std::ostream &out = path.empty() ? std::cerr : file;
+    if (format == "json")
+        all.writeJson(out, seconds);
+    else
+        all.writeText(out, seconds);
+    out.flush();
+    return true;
 }
 
 /**
- * @brief detect collisions by "collision symbol" ("!"), length and by
- *        comparing with additional response
+ * @brief one link of a bus with what records its traffic: `stats`
+ *        counted in `counts`, then the `trace` (labelled `label`)
  */
-bool collision(const std::string &s)
-{
-    if ((s == "!") || (s.size() != MAXLEN+2))
-        return true;
-    mute(s);
-    std::string resp = read_line();
-    // uid length should be MAXLEN + 2 (prefix length)
-    if ((resp.size() != MAXLEN + 2) || (resp != s)) {
-        return true;
+struct Channel {
+    Channel(ScanLink &base, ScanObserver &observer, TraceSink *trace,
+        const std::string &label, ScanStats *counts) :
+        link(&base),
+        obs(&observer)
+    {
+        if (counts) {
+            link = &counted_link.emplace(*link, *counts);
+            obs = &counted_observer.emplace(*obs, *counts);
+        }
+        if (trace) {
+            link = &traced_link.emplace(*link, *trace, label);
+            obs = &traced_observer.emplace(*obs, *trace, label);
+        }
     }
 
-    return false;
-}
+    std::optional<StatsLink> counted_link;
+    std::optional<StatsObserver> counted_observer;
+    std::optional<TraceLink> traced_link;
+    std::optional<TraceObserver> traced_observer;
+    ScanLink *link;
+    ScanObserver *obs;
+};
 
 /**
- * the main magic is here: generate pattern, send it, check, recursively go
- * deeper in the case of collision
+ * @brief full discovery on one bus: every prefix, from "no address"
+ *        state back to it. the `known` uids (of the prefixes scanned)
+ *        are confirmed and muted first, so the walk only has to find
+ *        what changed. with a `trace` all traffic and events are
+ *        recorded there, too, with `stats` counted in bus.stats. a bus
+ *        with more channels has its subtrees walked on all of them at
+ *        once (see ParallelScan), each traced as `<spec>#<n>`
  *
- * this is a recurring funcion, i.e. it could call itself
- *
- * @returns 1. CHARSET.size() if nothing found
- *          2. the charset index where uid was found
+ * @return number of known uids confirmed
  */
-size_t scan(const std::string& s, const std::string& pfx,
-    std::set<std::string>& found_uids, size_t index)
+size_t scan_bus(Bus &bus, const std::vector<std::string> &prefixes,
+    ScanObserver &observer, TraceSink *trace, SymbolPlan &plan,
+    const std::vector<std::string> &known, bool stats)
 {
-    static int level = 0; // recursion level
-    std::cerr << "ENTER SCAN: level=" << level
-        << " index=" << index << std::endl;
+    std::vector<ScanStats> counts(bus.channels.size());
+    std::vector<std::unique_ptr<Channel>> channels;
+    channels.push_back(std::make_unique<Channel>(*bus.link, observer,
+        trace, bus.spec, stats ? &bus.stats : nullptr));
+    for (size_t i = 0; i < bus.channels.size(); ++i) {
+        channels.push_back(std::make_unique<Channel>(*bus.channels[i],
+            observer, trace, bus.spec + "#" + std::to_string(i + 1),
+            stats ? &counts[i] : nullptr));
+    }
+    ScanLink *link = channels[0]->link;
 
-    if (s.size() >= MAXLEN) {
-        std::cerr << "ERROR: length limit reached!" << level
-            << " index=" << index << std::endl;
-        level--;
-        return CHARSET.size();
+    link->resetAll(); // move all devices to "no address" state
+    if (gl_fast_collision) {
+        // every connection is a session of its own
+        for (const auto &c : channels) {
+            if (!c->link->setMode("FASTCOLLISION") &&
+                gl_log_level >= LOG_NORMAL)
+                std::cerr << "NOTE: " + bus.spec +
+                    " has no fast collisions, scanning without\n";
+        }
     }
 
-    size_t pos = index;
-    size_t inner_index = 0;
+    ScanEngine engine(*link, bus.found);
+    engine.setObserver(channels[0]->obs);
+    engine.setSymbolPlan(&plan);
+    engine.setCollisionHints(gl_hints);
+    engine.setConfirm(gl_confirm);
 
-    for (; pos < CHARSET.size(); pos++) {
-        std::string next;
-        if (level == 0) { // scan by prefix only on level 0
-            next = s;
-            pos = CHARSET.size(); // for return if no collisions
-        } else {
-            next = s + CHARSET[pos];
-        }
-        // see comments for reverse_string() above
-        std::string resp = send_and_recv(pfx + reverse_string(next),
-            gl_timeout);
+    std::optional<ParallelScan> parallel;
+    if (channels.size() > 1) {
+        std::vector<ParallelScan::Channel> workers;
+        for (const auto &c : channels)
+            workers.push_back({c->link, c->obs});
+        parallel.emplace(workers, bus.found);
+        parallel->setSymbolPlan(&plan);
+        parallel->setCollisionHints(gl_hints);
+        parallel->setConfirm(gl_confirm);
+    }
 
-        // timeout, i.e. no answer
-        if (resp.empty()) {
-            inner_index = 0;
-            continue;
-        }
+    std::optional<BisectScan> bisect;
+    if (gl_bisect) {
+        bisect.emplace(*link, bus.found);
+        bisect->setObserver(channels[0]->obs);
+        bisect->setSymbolPlan(&plan);
+        bisect->setConfirm(gl_confirm);
+    }
 
-        if (collision(resp)) {
-
-            char c = (inner_index < CHARSET.size())
-                ? CHARSET[inner_index] : '.';
-            char p = (pos < CHARSET.size())
-                ? CHARSET[pos] : '.';
-            std::cerr << "COLLISION: " << pfx + reverse_string(next)
-                << " inner_index=" << inner_index
-                << " (\"" << c << "\")"
-                << " level=" << level << " pos=" << pos
-                << " (\"" << p << "\")" << std::endl;
-
-            if (inner_index < CHARSET.size()) {
-                // go deeper into recursion
-                level++;
-                inner_index = scan(next, pfx, found_uids, inner_index);
-                level--;
-
-                char c1 = (inner_index < CHARSET.size())
-                    ? CHARSET[inner_index] : '.';
-                std::cerr << "RETURN FROM SCAN: inner_index="
-                    << inner_index
-                    << " (\"" << c1 << "\")"
-                    << " level=" << level << " pos=" << pos
-                    << " (\"" << p << "\")" << std::endl;
-
-                /*
-                 * need to check the same collision point: if only one uid
-                 * remains it will be found immediately
-                 */
-                pos--;
-            } else {
-                inner_index = 0;
-            }
-            continue;
-        }
+    std::vector<std::string> expected;
+    for (const auto &uid : known) {
+        if (std::find(prefixes.begin(), prefixes.end(),
+            uid.substr(0, AisgUid::PREFIX)) != prefixes.end())
+            expected.push_back(uid);
+    }
+    size_t confirmed = expected.empty() ? 0 : engine.verify(expected);
 
-        if (found_uids.insert(resp).second) {
-            std::cerr << "FOUND: " << resp << std::endl;
-            if (level > 1) {
-                return pos;
-            }
-            else {
-                inner_index = 0;
-            }
+    for (const auto &pfx : prefixes) {
+        if (trace)
+            trace->scan(bus.spec, pfx);
+        if (parallel) {
+            parallel->scan(pfx);
+        } else if (bisect) {
+            bisect->scan(pfx);
+            if (!bisect->classesKnown() && gl_log_level >= LOG_NORMAL)
+                std::cerr << "NOTE: " + bus.spec + " has no character " +
+                    "classes, " + pfx + " scanned without\n";
+        } else {
+            engine.scan(pfx);
         }
     }
-    return pos;
+    link->resetAll();
+    for (const auto &c : counts)
+        bus.stats.merge(c);
+    return confirmed;
 }
 
 /**
@@ -245,6 +530,70 @@ bool parse_timeout(const char* arg, int& value_out) {
     return true;
 }
 
+/**
+ * @brief a count of something (jobs, channels): a decimal number above
+ *        zero, nothing after it
+ */
+bool parse_count(const char *arg, unsigned &value_out)
+{
+    if (*arg < '0' || *arg > '9')
+        return false; // strtoul() would negate a "-1"
+    char *endptr = nullptr;
+    errno = 0;
+    unsigned long val = std::strtoul(arg, &endptr, 10);
+    if (errno != 0 || *endptr != '\0' || val == 0 || val > UINT_MAX)
+        return false;
+    value_out = static_cast<unsigned>(val);
+    return true;
+}
+
+/**
+ * @brief `none`, `mixed` or `or`, see ScanEngine::CollisionHints
+ */
+bool parse_hints(const std::string &arg, ScanEngine::CollisionHints &out)
+{
+    using Hints = ScanEngine::CollisionHints;
+    if (arg == "none")
+        out = Hints::None;
+    else if (arg == "mixed")
+        out = Hints::Mixed;
+    else if (arg == "or")
+        out = Hints::Or;
+    else
+        return false;
+    return true;
+}
+
+/**
+ * @brief `echo`, `none`, `crc` or `deferred`, see ScanEngine::Confirm
+ */
+bool parse_confirm(const std::string &arg, ScanEngine::Confirm &out)
+{
+    using Confirm = ScanEngine::Confirm;
+    if (arg == "echo")
+        out = Confirm::Echo;
+    else if (arg == "none")
+        out = Confirm::None;
+    else if (arg == "crc")
+        out = Confirm::Crc;
+    else if (arg == "deferred")
+        out = Confirm::Deferred;
+    else
+        return false;
+    return true;
+}
+
+/**
+ * @brief `text` or `json`
+ */
+bool parse_stats(const std::string &arg, std::string &out)
+{
+    if (arg != "text" && arg != "json")
+        return false;
+    out = arg;
+    return true;
+}
+
 /**
  * just for changing global variable
  */
@@ -259,16 +608,114 @@ void set_timeout(int timeout)
 void usage(char *progname)
 {
     std::cerr << "Usage: " << progname
-        << " [--timeout|-t <msec>] <prefix> [prefix ...]\n";
+        << " [--timeout|-t <msec>] [--pipeline|-P]"
+        << " [--adaptive|-a] [--min-timeout <msec>]"
+        << " [--bus|-b <endpoint> ...] [--jobs|-j <n>]"
+        << " [--channels <n>]"
+        << " [--quiet|-q] [--verbose|-v] [--trace <file>]"
+        << " [--simulate <uid,...>] [--simulate-file <file>]"
+        << " [--replay <trace>]"
+        << " [--charset <vendor>=<symbols> ...] [--charset-file <file>]"
+        << " [--learn] [--learn-file <file>]"
+        << " [--hints none|mixed|or] [--inventory <file>]"
+        << " [--confirm echo|none|crc|deferred] [--fast-collision]"
+        << " [--bisect]"
+        << " [--stats[=text|json]] [--stats-file <file>]"
+        << " <prefix> [prefix ...]\n";
 }
 
 /**
- * @brief the program accepts one optional parameter `-t <timeout in ms>`
- *        and at least one required parameter: vendor id (two characters)
+ * @brief the program accepts optional parameters `-t <timeout in ms>`
+ *        and `-P` (pipelined probes, needs a responder that supports the
+ *        tagged framing) and at least one required parameter: vendor id
+ *        (two characters)
+ *
+ *        `-a` makes the timeout adaptive: `-t` becomes the upper bound,
+ *        the wait actually used follows the measured reply latency
+ *        (never below `--min-timeout`, default 5 ms)
+ *
+ *        `-b <endpoint>` (repeatable, see open_bus()) replaces
+ *        stdin/stdout by one or more buses. they are scanned in parallel
+ *        by up to `-j <n>` threads (default: one per bus), so the
+ *        slowest bus sets the total time
+ *
+ *        `--channels <n>` opens every bus n times and walks the
+ *        subtrees of a prefix on all of them at once (see
+ *        ParallelScan): for `unix:` and `tcp:` endpoints of a
+ *        `uidresp --listen` server, which serves each connection in
+ *        turn, and for `--simulate`. the waits for replies and
+ *        timeouts of one channel overlap with the others' probes
+ *
+ *        `-q` leaves only errors and the final summary on stderr, `-v`
+ *        adds every collision. `--trace <file>` records all probes,
+ *        responses and events as JSON lines (see trace.h)
+ *
+ *        `--simulate <uid,...>` and `--simulate-file <file>` (a
+ *        population file of uidresp: text, packed or an image, see
+ *        uidfile.h) scan a simulated bus in-process instead of a real
+ *        one: the uidresp logic answers directly (see uidbus.h), so a
+ *        miss costs no timeout. `--bus` endpoints are scanned as well
+ *        if given
+ *
+ *        `--replay <trace>` scans the first bus of a `--trace` file
+ *        again (see ReplayLink): recorded responses and latencies as
+ *        long as the scan sends what was recorded, a simulated bus of
+ *        the uids found there once it takes another way. the summary
+ *        adds the time the scan would have taken on the recorded bus
+ *        (a probe without answer that the recording has no latency
+ *        for costs the `-t` timeout). the prefixes default to the
+ *        recorded ones
+ *
+ *        `--charset <vendor>=<symbols>` (repeatable, `*` for all other
+ *        vendors; e.g. `CB=0-9`) and `--charset-file <file>` limit the
+ *        symbols tried for a vendor's serial numbers. `--learn` probes
+ *        the symbols most frequent among the uids found so far first,
+ *        `--learn-file <file>` (a population file, like the inventory)
+ *        also counts the uids of an earlier scan
+ *
+ *        `--hints mixed` probes the symbol a collision response shows
+ *        first, where uidresp `mixed` copies it from a colliding uid.
+ *        `--hints or`, for buses where collisions OR the replies
+ *        together, only probes symbols the OR covers
+ *
+ *        `--inventory <file>` makes rescans incremental: the uids
+ *        listed there (if the file exists) are probed directly and
+ *        muted before the walk, which then finds only new devices.
+ *        afterwards the file is replaced by the uids found
+ *
+ *        `--confirm <mode>` chooses how a response that looks like a
+ *        uid is confirmed (see ScanEngine::Confirm): `echo` (default)
+ *        waits for the setaddr echo, `deferred` mutes at once and
+ *        checks all echoes at the end of the prefix (walking it again
+ *        if one was missing), `crc` does the same for uids that end in
+ *        a check symbol (AisgUid::checkSymbol()) and `none` does not
+ *        check at all
+ *
+ *        `--fast-collision` negotiates `MODE:FASTCOLLISION` with the
+ *        responder (see UidBus) on every channel: collisions come as
+ *        empty lines, which the responder builds at no cost, the line
+ *        carries in one byte and no scan mistakes for a uid. a
+ *        responder that does not answer costs one timeout and is
+ *        scanned as usual. collision hints need the collision
+ *        contents, so it does not go with `--hints`
+ *
+ *        `--bisect` probes a class of half of the symbols of a tree
+ *        level at a time, e.g. `CB[0-9A-V]`, and halves again what
+ *        collides (see BisectScan): a node with one branch costs at
+ *        most 6 timeouts instead of up to 63. the probes depend on each
+ *        other, so `--pipeline` only serves `--inventory`, and it does
+ *        not go with `--hints` or `--channels`. a responder without
+ *        classes has the prefix scanned the usual way
+ *
+ *        `--stats[=text|json]` reports, per prefix, probes, windows,
+ *        probes without answer, collisions, SETADDR confirmations,
+ *        probes per uid found and latency percentiles, after the
+ *        summary on stderr or in `--stats-file <file>`
  *
  * @example
  *
  *    uidscan -t 500 CB HS ZL
+ *    uidscan -b /dev/ttyS0 -b /dev/ttyS1 -b unix:/tmp/bus2 CB HS
  */
 int main(int argc, char **argv)
 {
@@ -278,12 +725,46 @@ int main(int argc, char **argv)
 
     const struct option long_opts[] = {
         {"timeout", required_argument, nullptr, 't'},
+        {"pipeline", no_argument, nullptr, 'P'},
+        {"bus", required_argument, nullptr, 'b'},
+        {"jobs", required_argument, nullptr, 'j'},
+        {"channels", required_argument, nullptr, 'N'},
+        {"adaptive", no_argument, nullptr, 'a'},
+        {"min-timeout", required_argument, nullptr, 'm'},
+        {"quiet", no_argument, nullptr, 'q'},
+        {"verbose", no_argument, nullptr, 'v'},
+        {"trace", required_argument, nullptr, 'T'},
+        {"simulate", required_argument, nullptr, 'S'},
+        {"simulate-file", required_argument, nullptr, 'F'},
+        {"replay", required_argument, nullptr, 'R'},
+        {"charset", required_argument, nullptr, 'C'},
+        {"charset-file", required_argument, nullptr, 'c'},
+        {"learn", no_argument, nullptr, 'L'},
+        {"learn-file", required_argument, nullptr, 'l'},
+        {"hints", required_argument, nullptr, 'H'},
+        {"inventory", required_argument, nullptr, 'I'},
+        {"confirm", required_argument, nullptr, 'K'},
+        {"fast-collision", no_argument, nullptr, 'O'},
+        {"bisect", no_argument, nullptr, 'B'},
+        {"stats", optional_argument, nullptr, 'x'},
+        {"stats-file", required_argument, nullptr, 'X'},
         {nullptr, 0, nullptr, 0}
     };
 
     int opt;
     int timeout = 0;
-    while ((opt = getopt_long(argc, argv, "t:",
+    unsigned jobs = 0; // 0: one per bus
+    unsigned channels = 1;
+    std::vector<std::string> bus_specs;
+    std::string trace_path;
+    std::string inventory_path;
+    std::string stats_format; // empty: no statistics
+    std::string stats_path;
+    bool simulate = false;
+    std::vector<std::string> sim_uids;
+    std::string replay_path;
+    SymbolPlan plan;
+    while ((opt = getopt_long(argc, argv, "t:Pb:j:aqv",
         long_opts, nullptr)) != -1) {
         switch (opt) {
         case 't':
@@ -294,29 +775,290 @@ int main(int argc, char **argv)
             }
             set_timeout(timeout);
             break;
+        case 'P':
+            gl_pipeline = true;
+            break;
+        case 'b':
+            bus_specs.push_back(optarg);
+            break;
+        case 'a':
+            if (gl_min_timeout < 0)
+                gl_min_timeout = MIN_TIMEOUT;
+            break;
+        case 'm':
+            if (!parse_timeout(optarg, gl_min_timeout)) {
+                std::cerr << "Invalid timeout value: " << optarg
+                    << std::endl;
+                return 1;
+            }
+            break;
+        case 'q':
+            gl_log_level = LOG_QUIET;
+            break;
+        case 'v':
+            gl_log_level = LOG_VERBOSE;
+            break;
+        case 'T':
+            trace_path = optarg;
+            break;
+        case 'S':
+            simulate = true;
+            parse_uid_list(optarg, sim_uids);
+            for (const auto &uid : sim_uids) {
+                if (uid.size() > UidArena::MAX_LEN) {
+                    std::cerr << "UID too long: " << uid.size()
+                        << " characters" << std::endl;
+                    return 1;
+                }
+            }
+            break;
+        case 'F':
+            simulate = true;
+            if (!UidFile::load(optarg, sim_uids)) {
+                std::cerr << "Can't read uid file " << optarg << ": "
+                    << std::strerror(errno) << std::endl;
+                return 1;
+            }
+            break;
+        case 'R':
+            replay_path = optarg;
+            break;
+        case 'C':
+            if (!plan.parse(optarg)) {
+                std::cerr << "Invalid charset: " << optarg << std::endl;
+                return 1;
+            }
+            break;
+        case 'c':
+            if (!read_charset_file(optarg, plan))
+                return 1;
+            break;
+        case 'L':
+            plan.setLearning(true);
+            break;
+        case 'l': {
+            std::vector<std::string> known;
+            if (!UidFile::load(optarg, known)) {
+                std::cerr << "Can't read uid file " << optarg << ": "
+                    << std::strerror(errno) << std::endl;
+                return 1;
+            }
+            for (const auto &uid : known)
+                plan.learn(uid);
+            plan.setLearning(true);
+            break;
+        }
+        case 'I':
+            inventory_path = optarg;
+            break;
+        case 'H':
+            if (!parse_hints(optarg, gl_hints)) {
+                std::cerr << "Invalid hints: " << optarg << std::endl;
+                return 1;
+            }
+            break;
+        case 'K':
+            if (!parse_confirm(optarg, gl_confirm)) {
+                std::cerr << "Invalid confirm mode: " << optarg
+                    << std::endl;
+                return 1;
+            }
+            break;
+        case 'O':
+            gl_fast_collision = true;
+            break;
+        case 'B':
+            gl_bisect = true;
+            break;
+        case 'x':
+            if (!parse_stats(optarg ? optarg : "text", stats_format)) {
+                std::cerr << "Invalid stats format: " << optarg
+                    << std::endl;
+                return 1;
+            }
+            break;
+        case 'X':
+            stats_path = optarg;
+            if (stats_format.empty())
+                stats_format = "text";
+            break;
+        case 'j':
+            if (!parse_count(optarg, jobs)) {
+                std::cerr << "Invalid number of jobs: " << optarg
+                    << std::endl;
+                return 1;
+            }
+            break;
+        case 'N':
+            if (!parse_count(optarg, channels)) {
+                std::cerr << "Invalid number of channels: " << optarg
+                    << std::endl;
+                return 1;
+            }
+            break;
         default:
             usage(argv[0]);
             return 1;
         }
     }
-    if (optind >= argc) {
+    if (optind >= argc && replay_path.empty()) {
         usage(argv[0]);
         return 1;
     }
+    if (gl_fast_collision &&
+        gl_hints != ScanEngine::CollisionHints::None) {
+        std::cerr << "--fast-collision leaves nothing for --hints"
+            << std::endl;
+        return 1;
+    }
+    if (gl_bisect && (gl_hints != ScanEngine::CollisionHints::None ||
+        channels > 1)) {
+        std::cerr << "--bisect goes with neither --hints nor --channels"
+            << std::endl;
+        return 1;
+    }
 
 // ---- scan logic starts here ----
 
-    reset_all(); // move all devices to "no address" state
+    std::vector<std::string> prefixes(argv + optind, argv + argc);
+    std::vector<Bus> buses;
+    if (!replay_path.empty()) {
+        if (channels > 1) {
+            std::cerr << "A replay has no channels" << std::endl;
+            return 1;
+        }
+        Bus bus{"replay", nullptr, {}, nullptr};
+        bus.recording = std::make_unique<Recording>();
+        if (!bus.recording->load(replay_path)) {
+            std::cerr << "Can't read trace " << replay_path << ": "
+                << std::strerror(errno) << std::endl;
+            return 1;
+        }
+        if (prefixes.empty())
+            prefixes = bus.recording->prefixes();
+        auto link = std::make_unique<ReplayLink>(*bus.recording);
+        if (gl_pipeline)
+            link->setPipelined(true);
+        link->setTimeoutUs(gl_timeout * 1000L);
+        bus.replay = link.get();
+        bus.link = std::move(link);
+        buses.push_back(std::move(bus));
+    }
+    if (simulate) {
+        // the population is the bus, answers come without any wait. a
+        // uid listed twice would be two devices that always collide
+        std::sort(sim_uids.begin(), sim_uids.end());
+        sim_uids.erase(std::unique(sim_uids.begin(), sim_uids.end()),
+            sim_uids.end());
+        Bus bus{"sim", nullptr, {},
+            std::make_unique<UidBus>(std::move(sim_uids))};
+        bus.sim->setLog(nullptr);
+        if (channels > 1)
+            bus.simLock = std::make_unique<std::mutex>();
+        bus.link = std::make_unique<SimLink>(*bus.sim, bus.simLock.get());
+        for (unsigned i = 1; i < channels; ++i) {
+            bus.channels.push_back(
+                std::make_unique<SimLink>(*bus.sim, bus.simLock.get()));
+        }
+        buses.push_back(std::move(bus));
+    } else if (bus_specs.empty() && buses.empty()) {
+        bus_specs.push_back("-");
+    }
+    for (const auto &spec : bus_specs) {
+        if (channels > 1 && spec.rfind("unix:", 0) != 0 &&
+            spec.rfind("tcp:", 0) != 0) {
+            std::cerr << "Only unix: and tcp: buses have channels: "
+                << spec << std::endl;
+            return 1;
+        }
+        Bus bus{spec, nullptr, {}, nullptr};
+        for (unsigned i = 0; i < channels; ++i) {
+            int in, out;
+            if (!open_bus(spec, in, out))
+                return 1;
+            auto link = std::make_unique<FdLink>(in, out, gl_timeout,
+                gl_pipeline);
+            if (gl_min_timeout >= 0)
+                link->setAdaptive(gl_min_timeout);
+            if (i == 0)
+                bus.link = std::move(link);
+            else
+                bus.channels.push_back(std::move(link));
+        }
+        buses.push_back(std::move(bus));
+    }
 
-    // iterate over prefixes
-    std::set<std::string> found_uids;
-    for (int i = optind; i < argc; ++i) {
-        std::string pfx = argv[i];
-        scan("", pfx, found_uids, 0);
+    // no inventory yet is fine: the first run creates it
+    std::vector<std::string> known;
+    if (!inventory_path.empty() && !UidFile::load(inventory_path, known) &&
+        errno != ENOENT) {
+        std::cerr << "Can't read inventory " << inventory_path << ": "
+            << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    std::atomic<size_t> confirmed{0};
+
+    std::unique_ptr<TraceSink> trace;
+    if (!trace_path.empty()) {
+        trace = std::make_unique<TraceSink>(trace_path);
+        if (!trace->ok()) {
+            std::cerr << "Can't open trace " << trace_path << ": "
+                << std::strerror(errno) << std::endl;
+            return 1;
+        }
     }
-    reset_all();
+
+    const bool stats = !stats_format.empty();
+    const auto started = std::chrono::steady_clock::now();
+    if (buses.size() == 1) {
+        StderrObserver observer(gl_log_level);
+        confirmed += scan_bus(buses[0], prefixes, observer, trace.get(),
+            plan, known, stats);
+    } else {
+        // a small pool: every worker takes the next bus not yet scanned
+        size_t workers = jobs > 0 ? static_cast<size_t>(jobs)
+                                  : buses.size();
+        std::atomic<size_t> next{0};
+        std::vector<std::thread> pool;
+        for (size_t w = 0; w < std::min(workers, buses.size()); ++w) {
+            pool.emplace_back([&]() {
+                for (size_t i; (i = next++) < buses.size();) {
+                    StderrObserver observer(gl_log_level,
+                        "[" + buses[i].spec + "] ");
+                    confirmed += scan_bus(buses[i], prefixes, observer,
+                        trace.get(), plan, known, stats);
+                }
+            });
+        }
+        for (auto &t : pool)
+            t.join();
+    }
+    const double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - started).count();
+
+    trace.reset(); // flushed
+
+    std::set<std::string> found_uids;
+    for (const auto &bus : buses)
+        found_uids.insert(bus.found.begin(), bus.found.end());
+
     std::cerr << std::endl;
     std::cerr << "== search complete ==" << std::endl;
+    if (buses.size() > 1) {
+        for (const auto &bus : buses)
+            std::cerr << "uids found on " << bus.spec << ": "
+                << bus.found.size() << std::endl;
+    }
+    for (const auto &bus : buses) {
+        if (bus.replay)
+            std::cerr << "replayed " << bus.replay->replayed() << " of "
+                << bus.recording->exchanges().size()
+                << " recorded exchanges, " << bus.replay->elapsedUs() / 1e6
+                << " s on the recorded bus" << std::endl;
+    }
+    if (!inventory_path.empty())
+        std::cerr << "known uids confirmed: " << confirmed << " of "
+            << known.size() << std::endl;
     std::cerr << "total uids found: " << found_uids.size() << std::endl;
     std::cerr << std::endl;
     for (auto uid: found_uids) {
@@ -324,6 +1066,13 @@ int main(int argc, char **argv)
     }
     std::cerr << std::endl;
 
+    if (stats && !write_stats(buses, stats_format, stats_path, seconds))
+        return 1;
+
+    if (!inventory_path.empty() &&
+        !write_inventory(inventory_path, found_uids))
+        return 1;
+
     return 0;
 }
 
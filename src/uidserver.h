@@ -0,0 +1,488 @@
+#pragma once
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "uidbus.h"
+
+/**
+ * @class UidServer
+ * @brief Serves one UidBus to many socket clients from a single epoll
+ *        loop.
+ *
+ * Every client speaks the uidresp line protocol (see UidBus). Lines are
+ * taken from the clients round-robin, one line per client and pass, and
+ * each one is a complete transaction on the bus before the next starts,
+ * as on a real half-duplex line: a scanner, a fault injector sending
+ * SETADDR/RESETADDR and a monitor all share the one population and see
+ * each other's effects in a well-defined order. A reply goes only to the
+ * client that sent the line.
+ *
+ * A client sending `MODE:MONITOR` (echoed back; no pattern holds a
+ * ':') gets, from then on, a copy of every transaction of the other
+ * clients:
+ * - `<id> > <line>`   the line client `<id>` put on the bus
+ * - `<id> < <reply>`  its reply, if it got one
+ * - `! <n> dropped`   the monitor fell behind by more than OUT_LIMIT
+ *                     bytes, so `<n>` lines were left out
+ *
+ * Every client has a session of its own (UidBus::Session), so a
+ * `MODE` one of them switches applies to its own lines only. Clients
+ * may not SNAPSHOT or RESTORE, which write and read files on the
+ * server, unless setSnapshots() allows it.
+ *
+ * Replies are collected while input is waiting and sent once a round is
+ * done. A client whose output backs up (more than OUT_LIMIT bytes) is not
+ * served until it drains, and a monitor that far behind loses lines, so
+ * a slow reader never stalls the others or grows the server. Nor does
+ * a client sending without a '\n': once the unfinished line is longer
+ * than LINE_LIMIT, it is discarded, the client gets `! line too long`
+ * after the replies to its earlier lines, and is disconnected.
+ *
+ * Errors are reported as false with errno set.
+ */
+class UidServer {
+public:
+    static constexpr size_t OUT_LIMIT = 1 << 20;
+    static constexpr size_t READ_CHUNK = 65536;
+    static constexpr size_t LINE_LIMIT = 65536;
+
+    explicit UidServer(UidBus &bus) :
+        bus_(bus)
+    {
+    }
+
+    ~UidServer()
+    {
+        for (auto &kv : conns_)
+            close(kv.first);
+        for (const Listener &l : listeners_) {
+            close(l.fd);
+            if (!l.path.empty())
+                unlink(l.path.c_str());
+        }
+        if (epfd_ >= 0)
+            close(epfd_);
+    }
+
+    UidServer(const UidServer &) = delete;
+    UidServer &operator=(const UidServer &) = delete;
+
+    /**
+     * @brief Accepts clients on an endpoint.
+     *
+     * - `unix:<path>`         UNIX stream socket; a stale socket file is
+     *                         replaced, and removed again on destruction
+     * - `tcp:[<host>:]<port>` TCP socket, on the loopback interface
+     *                         unless a host is given (`0.0.0.0` for all)
+     */
+    bool listen(const std::string &spec)
+    {
+        if (!ready())
+            return false;
+        int fd = -1;
+        std::string path;
+        if (spec.rfind("unix:", 0) == 0) {
+            path = spec.substr(5);
+            fd = listenUnix(path);
+        } else if (spec.rfind("tcp:", 0) == 0) {
+            fd = listenTcp(spec.substr(4));
+        } else {
+            errno = EINVAL;
+            return false;
+        }
+        if (fd < 0)
+            return false;
+        if (!watch(fd, EPOLLIN, EPOLL_CTL_ADD)) {
+            int e = errno;
+            close(fd);
+            errno = e;
+            return false;
+        }
+        listeners_.push_back({fd, path});
+        return true;
+    }
+
+    /**
+     * @brief Lets clients connecting from now on use SNAPSHOT and
+     *        RESTORE (in the bus' snapshot directory).
+     */
+    void setSnapshots(bool allow) { snapshots_ = allow; }
+
+    /**
+     * @brief Serves a connected socket, e.g. one end of a socketpair();
+     *        the server owns it from now on.
+     */
+    bool adopt(int fd)
+    {
+        if (!ready())
+            return false;
+        int flags = fcntl(fd, F_GETFL);
+        if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0 ||
+            !watch(fd, EPOLLIN, EPOLL_CTL_ADD)) {
+            int e = errno;
+            close(fd);
+            errno = e;
+            return false;
+        }
+        Conn &c = conns_[fd];
+        c.fd = fd;
+        c.id = ++lastId_;
+        c.session = bus_.defaultSession();
+        c.session.snapshots = snapshots_;
+        c.events = EPOLLIN;
+        return true;
+    }
+
+    /**
+     * @brief One round: waits for events, reads what arrived, puts the
+     *        complete lines on the bus and sends the replies.
+     *
+     * @param timeout_ms How long to wait for an event; negative waits
+     *                   forever.
+     * @return false if waiting failed; an interrupted wait is a round
+     *         without events
+     */
+    bool poll(int timeout_ms = -1)
+    {
+        if (!ready())
+            return false;
+        struct epoll_event ev[64];
+        int n = epoll_wait(epfd_, ev, 64, timeout_ms);
+        if (n < 0 && errno != EINTR)
+            return false;
+        for (int i = 0; i < n; ++i) {
+            const int fd = ev[i].data.fd;
+            if (isListener(fd)) {
+                acceptAll(fd);
+                continue;
+            }
+            auto it = conns_.find(fd);
+            if (it == conns_.end())
+                continue;
+            if (ev[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                receive(it->second);
+            if (ev[i].events & EPOLLOUT)
+                send(it->second);
+        }
+        serve();
+        for (auto &kv : conns_)
+            send(kv.second);
+        reap();
+        return true;
+    }
+
+    /**
+     * @return number of connected clients
+     */
+    size_t clients() const { return conns_.size(); }
+
+    /**
+     * @return monitor lines left out so far, of monitors not reading
+     */
+    size_t dropped() const { return dropped_; }
+
+private:
+    struct Listener {
+        int fd;
+        std::string path; // UNIX socket file to remove
+    };
+
+    struct Conn {
+        int fd = -1;
+        unsigned id = 0;
+        std::string in;
+        size_t used = 0; // consumed part of `in`
+        std::string out;
+        uint32_t events = 0; // what epoll watches for
+        bool eof = false;
+        bool dead = false;
+        bool monitor = false;
+        bool overlong = false; // sent a line past LINE_LIMIT
+        size_t dropped = 0; // monitor lines left out since the last notice
+        UidBus::Session session;
+    };
+
+    bool ready()
+    {
+        if (epfd_ < 0)
+            epfd_ = epoll_create1(EPOLL_CLOEXEC);
+        return epfd_ >= 0;
+    }
+
+    bool watch(int fd, uint32_t events, int op)
+    {
+        struct epoll_event ev = {};
+        ev.events = events;
+        ev.data.fd = fd;
+        return epoll_ctl(epfd_, op, fd, &ev) == 0;
+    }
+
+    bool isListener(int fd) const
+    {
+        for (const Listener &l : listeners_) {
+            if (l.fd == fd)
+                return true;
+        }
+        return false;
+    }
+
+    static int listenUnix(const std::string &path)
+    {
+        struct sockaddr_un addr = {};
+        if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        addr.sun_family = AF_UNIX;
+        std::copy(path.begin(), path.end(), addr.sun_path);
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+            unlink(path.c_str()); // left over by an earlier run
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK |
+            SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return -1;
+        if (bind(fd, reinterpret_cast<struct sockaddr *>(&addr),
+                sizeof(addr)) < 0 || ::listen(fd, SOMAXCONN) < 0) {
+            int e = errno;
+            close(fd);
+            errno = e;
+            return -1;
+        }
+        return fd;
+    }
+
+    static int listenTcp(const std::string &hostport)
+    {
+        size_t colon = hostport.rfind(':');
+        std::string host = colon == std::string::npos
+            ? "127.0.0.1" : hostport.substr(0, colon);
+        std::string port = colon == std::string::npos
+            ? hostport : hostport.substr(colon + 1);
+        if (host.size() > 2 && host.front() == '[' && host.back() == ']')
+            host = host.substr(1, host.size() - 2);
+
+        struct addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+        struct addrinfo *res = nullptr;
+        if (port.empty() ||
+            getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0) {
+            errno = EINVAL;
+            return -1;
+        }
+        int fd = -1;
+        int e = EADDRNOTAVAIL;
+        for (struct addrinfo *ai = res; ai && fd < 0; ai = ai->ai_next) {
+            fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK |
+                SOCK_CLOEXEC, ai->ai_protocol);
+            if (fd < 0) {
+                e = errno;
+                continue;
+            }
+            int on = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            if (bind(fd, ai->ai_addr, ai->ai_addrlen) < 0 ||
+                ::listen(fd, SOMAXCONN) < 0) {
+                e = errno;
+                close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(res);
+        if (fd < 0)
+            errno = e;
+        return fd;
+    }
+
+    void acceptAll(int lfd)
+    {
+        for (;;) {
+            int fd = accept4(lfd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0)
+                return; // EAGAIN, or a client that gave up already
+            adopt(fd);
+        }
+    }
+
+    /**
+     * one read() of what arrived; level-triggered epoll brings us back
+     * for the rest
+     */
+    void receive(Conn &c)
+    {
+        if (c.eof || c.dead)
+            return;
+        const size_t at = c.in.size();
+        c.in.resize(at + READ_CHUNK);
+        ssize_t n;
+        do {
+            n = ::read(c.fd, &c.in[at], READ_CHUNK);
+        } while (n < 0 && errno == EINTR);
+        c.in.resize(at + (n > 0 ? static_cast<size_t>(n) : 0));
+        if (n == 0)
+            c.eof = true;
+        else if (n < 0 && errno != EAGAIN)
+            c.dead = true;
+        // the unfinished line must not grow without bound: drop it and
+        // stop reading, the lines before it are still served
+        const size_t nl = c.in.rfind('\n');
+        const size_t done = nl == std::string::npos ? 0 : nl + 1;
+        if (c.in.size() - done > LINE_LIMIT) {
+            c.in.resize(std::max(done, c.used));
+            c.overlong = true;
+            c.eof = true;
+        }
+    }
+
+    /**
+     * next line of `c` without its '\n'; an unterminated last line
+     * counts once the client is done sending
+     */
+    bool takeLine(Conn &c, std::string &line)
+    {
+        if (c.dead)
+            return false;
+        size_t nl = c.in.find('\n', c.used);
+        if (nl == std::string::npos) {
+            if (c.overlong && c.used == c.in.size()) {
+                c.out.append("! line too long\n");
+                c.overlong = false;
+            }
+            if (!c.eof || c.used == c.in.size())
+                return false;
+            nl = c.in.size();
+        }
+        line.assign(c.in, c.used, nl - c.used);
+        c.used = std::min(nl + 1, c.in.size());
+        return true;
+    }
+
+    /**
+     * the half-duplex part: one line from each client in turn until
+     * no complete line is left
+     */
+    void serve()
+    {
+        round_.clear();
+        for (auto &kv : conns_)
+            round_.push_back(&kv.second);
+        while (!round_.empty()) {
+            size_t kept = 0;
+            for (Conn *c : round_) {
+                if (c->out.size() >= OUT_LIMIT || !takeLine(*c, line_))
+                    continue;
+                transact(*c, line_);
+                round_[kept++] = c;
+            }
+            round_.resize(kept);
+        }
+        for (auto &kv : conns_) {
+            Conn &c = kv.second;
+            c.in.erase(0, c.used);
+            c.used = 0;
+        }
+    }
+
+    void transact(Conn &c, const std::string &line)
+    {
+        if (line == "MODE:MONITOR") {
+            c.monitor = true;
+            c.out.append(line).push_back('\n');
+            return;
+        }
+        const bool answered = bus_.handle(line, reply_, c.session);
+        if (answered)
+            c.out.append(reply_).push_back('\n');
+        for (auto &kv : conns_) {
+            Conn &m = kv.second;
+            if (!m.monitor || &m == &c || m.dead)
+                continue;
+            // a monitor that doesn't read must not grow without bound
+            if (m.out.size() >= OUT_LIMIT) {
+                const size_t n = answered ? 2 : 1;
+                m.dropped += n;
+                dropped_ += n;
+                continue;
+            }
+            if (m.dropped) {
+                m.out.append("! ").append(std::to_string(m.dropped))
+                    .append(" dropped\n");
+                m.dropped = 0;
+            }
+            const std::string id = std::to_string(c.id);
+            m.out.append(id).append(" > ").append(line).push_back('\n');
+            if (answered)
+                m.out.append(id).append(" < ").append(reply_)
+                    .push_back('\n');
+        }
+    }
+
+    void send(Conn &c)
+    {
+        while (!c.out.empty() && !c.dead) {
+            ssize_t n = ::send(c.fd, c.out.data(), c.out.size(),
+                MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    c.dead = true;
+                break;
+            }
+            c.out.erase(0, static_cast<size_t>(n));
+        }
+    }
+
+    /**
+     * drops finished clients and adjusts what epoll watches for
+     */
+    void reap()
+    {
+        for (auto it = conns_.begin(); it != conns_.end();) {
+            Conn &c = it->second;
+            const bool idle = c.in.empty() && c.out.empty();
+            if (c.dead || (c.eof && idle)) {
+                epoll_ctl(epfd_, EPOLL_CTL_DEL, c.fd, nullptr);
+                close(c.fd);
+                it = conns_.erase(it);
+                continue;
+            }
+            uint32_t events = 0;
+            if (!c.eof && c.out.size() < OUT_LIMIT)
+                events |= EPOLLIN;
+            if (!c.out.empty())
+                events |= EPOLLOUT;
+            if (events != c.events && watch(c.fd, events, EPOLL_CTL_MOD))
+                c.events = events;
+            ++it;
+        }
+    }
+
+    UidBus &bus_;
+    int epfd_ = -1;
+    unsigned lastId_ = 0;
+    size_t dropped_ = 0;
+    bool snapshots_ = false;
+    std::vector<Listener> listeners_;
+    std::unordered_map<int, Conn> conns_;
+    std::vector<Conn *> round_;
+    std::string line_;
+    std::string reply_;
+};
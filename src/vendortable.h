@@ -0,0 +1,202 @@
+#pragma once
+
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "uidresp.h"
+
+/**
+ * @struct CollisionProfile
+ * @brief What a vendor's devices put on the line when several answer.
+ *
+ * `respond` fills `out` with the collision response for the matched
+ * UIDs; an empty `out` is sent as an empty line. A profile only draws
+ * from `rng` if its response is actually random. One that does not
+ * look at the participants at all clears `needsParticipants`, and the
+ * responder then skips collecting them.
+ */
+struct CollisionProfile {
+    using Participants = std::vector<std::string_view>;
+    using Respond = std::function<void(const Participants &matched,
+        std::mt19937 &rng, std::string &out)>;
+
+    std::string name;
+    Respond respond;
+    bool needsParticipants = true;
+};
+
+/**
+ * @class VendorTable
+ * @brief Collision behaviour per two-character vendor prefix.
+ *
+ * Every vendor not listed explicitly uses the default profile. The
+ * table starts out with the behaviour uidresp always had: `CB` devices
+ * answer a collision with an empty line, everybody else with a
+ * `mixed` collision string.
+ *
+ * Built-in profiles (see makeProfile()):
+ * - `mixed`          UidResponder::generateCollision()
+ * - `empty`          empty line, no randomness involved
+ * - `truncated[:n]`  mixed string cut to n characters (default 10)
+ * - `padded[:n]`     mixed string followed by n `0` characters
+ *                    (default 1)
+ * - `or`             bitwise OR of the UIDs, column by column, like
+ *                    open-drain drivers sharing a wire
+ */
+class VendorTable {
+public:
+    VendorTable() :
+        default_(mixed())
+    {
+        set("CB", empty());
+    }
+
+    /**
+     * @brief Assigns a profile to one vendor prefix.
+     */
+    void set(const std::string &prefix, CollisionProfile profile)
+    {
+        profiles_[prefix] = std::move(profile);
+    }
+
+    /**
+     * @brief Replaces the profile used for unlisted vendors.
+     */
+    void setDefault(CollisionProfile profile)
+    {
+        default_ = std::move(profile);
+    }
+
+    /**
+     * @brief Applies an assignment of the form `<prefix>=<profile>`;
+     *        the prefix `*` stands for the default profile.
+     *
+     * @return false if the assignment or the profile is malformed
+     */
+    bool parse(const std::string &assignment)
+    {
+        size_t eq = assignment.find('=');
+        if (eq == std::string::npos || eq == 0)
+            return false;
+        CollisionProfile profile;
+        if (!makeProfile(assignment.substr(eq + 1), profile))
+            return false;
+        std::string prefix = assignment.substr(0, eq);
+        if (prefix == "*")
+            setDefault(std::move(profile));
+        else
+            set(prefix, std::move(profile));
+        return true;
+    }
+
+    /**
+     * @return profile responsible for the vendor of `uid`
+     */
+    const CollisionProfile &lookup(std::string_view uid) const
+    {
+        auto it = profiles_.find(uid.substr(0, VENDOR_LEN));
+        return it != profiles_.end() ? it->second : default_;
+    }
+
+    /**
+     * @brief Creates a built-in profile from its `name[:arg]` spec.
+     *
+     * @return false for unknown names or invalid arguments
+     */
+    static bool makeProfile(const std::string &spec,
+        CollisionProfile &out)
+    {
+        size_t colon = spec.find(':');
+        std::string name = spec.substr(0, colon);
+        long arg = -1;
+        if (colon != std::string::npos) {
+            const char *s = spec.c_str() + colon + 1;
+            char *end = nullptr;
+            arg = std::strtol(s, &end, 10);
+            if (end == s || *end != '\0' || arg < 0)
+                return false;
+        }
+
+        if (name == "mixed" && arg < 0)
+            out = mixed();
+        else if (name == "empty" && arg < 0)
+            out = empty();
+        else if (name == "truncated")
+            out = truncated(arg < 0 ? 10 : static_cast<size_t>(arg));
+        else if (name == "padded")
+            out = padded(arg < 0 ? 1 : static_cast<size_t>(arg));
+        else if (name == "or" && arg < 0)
+            out = wiredOr();
+        else
+            return false;
+        return true;
+    }
+
+    static CollisionProfile mixed()
+    {
+        return {"mixed",
+            [](const CollisionProfile::Participants &matched,
+                std::mt19937 &rng, std::string &out) {
+                UidResponder::generateCollision(matched, rng, out);
+            }};
+    }
+
+    static CollisionProfile empty()
+    {
+        return {"empty",
+            [](const CollisionProfile::Participants &, std::mt19937 &,
+                std::string &out) {
+                out.clear();
+            },
+            false};
+    }
+
+    static CollisionProfile truncated(size_t len)
+    {
+        return {"truncated:" + std::to_string(len),
+            [len](const CollisionProfile::Participants &matched,
+                std::mt19937 &rng, std::string &out) {
+                UidResponder::generateCollision(matched, rng, out, len);
+            }};
+    }
+
+    static CollisionProfile padded(size_t extra)
+    {
+        return {"padded:" + std::to_string(extra),
+            [extra](const CollisionProfile::Participants &matched,
+                std::mt19937 &rng, std::string &out) {
+                UidResponder::generateCollision(matched, rng, out);
+                out.append(extra, '0');
+            }};
+    }
+
+    /**
+     * @brief every column the OR of the UIDs reaching it; as long as
+     *        the longest UID, no randomness
+     */
+    static CollisionProfile wiredOr()
+    {
+        return {"or",
+            [](const CollisionProfile::Participants &matched,
+                std::mt19937 &, std::string &out) {
+                out.clear();
+                for (std::string_view uid : matched) {
+                    if (out.size() < uid.size())
+                        out.resize(uid.size(), '\0');
+                    for (size_t i = 0; i < uid.size(); ++i)
+                        out[i] = static_cast<char>(out[i] | uid[i]);
+                }
+            }};
+    }
+
+private:
+    static constexpr size_t VENDOR_LEN = AisgUid::PREFIX;
+
+    CollisionProfile default_;
+    std::map<std::string, CollisionProfile, std::less<>> profiles_;
+};
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include <random>
+#include "batchmatch.h"
+#include "uidindex.h"
+#include "uidresp.h"
+
+namespace {
+
+using Isa = BatchMatcher::Isa;
+
+std::string randomString(std::mt19937 &rng, size_t len)
+{
+    static const char alphabet[] = "AB01";
+    std::uniform_int_distribution<size_t> dist(0, sizeof(alphabet) - 2);
+    std::string s;
+    for (size_t i = 0; i < len; ++i)
+        s.push_back(alphabet[dist(rng)]);
+    return s;
+}
+
+// mostly AISG-length UIDs, some shorter and longer ones among them
+std::vector<std::string> population(std::mt19937 &rng, size_t n)
+{
+    std::vector<std::string> uids;
+    for (size_t i = 0; i < n; ++i)
+        uids.push_back(randomString(rng, i % 9 == 0 ? 3 + i % 20 : 19));
+    return uids;
+}
+
+std::vector<Isa> supportedIsas()
+{
+    std::vector<Isa> isas;
+    for (Isa isa : {Isa::Scalar, Isa::Sse2, Isa::Avx2, Isa::Neon}) {
+        if (BatchMatcher::supported(isa))
+            isas.push_back(isa);
+    }
+    return isas;
+}
+
+} // namespace
+
+TEST(BatchMatcherTest, MatchesLikeReference)
+{
+    std::mt19937 rng(7);
+    const auto uids = population(rng, 300);
+    std::vector<uint64_t> muted((uids.size() + 63) / 64, 0);
+    for (size_t i = 0; i < uids.size(); i += 5)
+        muted[i / 64] |= uint64_t(1) << (i % 64);
+
+    for (Isa isa : supportedIsas()) {
+        BatchMatcher batch(uids);
+        ASSERT_TRUE(batch.setIsa(isa));
+        for (int k = 0; k < 300; ++k) {
+            std::string input = randomString(rng, k % 8);
+            for (const uint64_t *m : {(const uint64_t *)nullptr,
+                     (const uint64_t *)muted.data()}) {
+                std::vector<size_t> expected;
+                for (size_t i = 0; i < uids.size(); ++i) {
+                    bool hidden = m && ((m[i / 64] >> (i % 64)) & 1);
+                    if (!hidden && UidResponder::matches(input, uids[i]))
+                        expected.push_back(i);
+                }
+
+                std::vector<size_t> got;
+                batch.forEachMatch(input, m,
+                    [&](size_t i) { got.push_back(i); });
+                EXPECT_EQ(got, expected) << BatchMatcher::name(isa)
+                    << " input=" << input;
+
+                BatchMatcher::Result r = batch.match(input, m);
+                EXPECT_EQ(r.count, expected.size());
+                if (!expected.empty())
+                    EXPECT_EQ(r.first, expected[0]);
+            }
+        }
+    }
+}
+
+TEST(BatchMatcherTest, ParseIsa)
+{
+    Isa isa;
+    EXPECT_TRUE(BatchMatcher::parseIsa("scalar", isa));
+    EXPECT_EQ(isa, Isa::Scalar);
+    EXPECT_TRUE(BatchMatcher::parseIsa("avx2", isa));
+    EXPECT_EQ(isa, Isa::Avx2);
+    EXPECT_TRUE(BatchMatcher::parseIsa("auto", isa));
+    EXPECT_EQ(isa, BatchMatcher::best());
+    EXPECT_FALSE(BatchMatcher::parseIsa("mmx", isa));
+}
+
+TEST(BatchMatcherTest, IndexCountsAlikeWithTrieAndBatch)
+{
+    std::mt19937 rng(11);
+    const auto uids = population(rng, 200);
+    UidIndex index(uids);
+    for (size_t i = 0; i < uids.size(); i += 7)
+        index.mute(uids[i]);
+
+    for (Isa isa : supportedIsas()) {
+        for (int k = 0; k < 200; ++k) {
+            std::string input = randomString(rng, k % 7);
+            index.useTrie();
+            BatchMatcher::Result trie = index.countMatches(input);
+            std::vector<std::string> trieUids = index.match(input);
+
+            ASSERT_TRUE(index.useBatch(isa));
+            BatchMatcher::Result batch = index.countMatches(input);
+            EXPECT_EQ(batch.count, trie.count) << "input=" << input;
+            EXPECT_EQ(batch.count, trieUids.size());
+            if (trie.count) {
+                EXPECT_EQ(batch.first, trie.first);
+                EXPECT_EQ(index.uid(batch.first), trieUids[0]);
+            }
+            EXPECT_EQ(index.match(input), trieUids);
+        }
+    }
+}
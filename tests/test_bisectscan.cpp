@@ -0,0 +1,168 @@
+#include <gtest/gtest.h>
+#include <random>
+#include "bisectscan.h"
+#include "uidbus.h"
+
+namespace {
+
+// counts probes and misses; `classes` off plays an old responder
+class CountingLink : public ScanLink {
+public:
+    CountingLink(ScanLink &link, bool classes = true) :
+        link_(link),
+        classes_(classes)
+    {
+    }
+
+    std::string probe(const std::string &pattern) override
+    {
+        ++probes;
+        if (!classes_ && CharClass::hasClass(pattern)) {
+            ++misses;
+            return "";
+        }
+        std::string resp = link_.probe(pattern);
+        misses += resp.empty();
+        return resp;
+    }
+
+    std::string assign(const std::string &uid) override
+    {
+        return link_.assign(uid);
+    }
+
+    void resetAll() override { link_.resetAll(); }
+
+    size_t probes = 0;
+    size_t misses = 0;
+
+private:
+    ScanLink &link_;
+    bool classes_;
+};
+
+std::vector<std::string> population(size_t n, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<size_t> sym(0, AisgUid::SYMBOLS - 1);
+    std::set<std::string> uids;
+    while (uids.size() < n) {
+        std::string uid = uids.size() % 2 ? "AB" : "CB";
+        while (uid.size() < AisgUid::LENGTH)
+            uid.push_back(CHARSET[sym(rng)]);
+        uids.insert(uid);
+    }
+    return {uids.begin(), uids.end()};
+}
+
+} // namespace
+
+TEST(BisectScanTest, FindsWhatTheWalkFindsWithFewerMisses)
+{
+    const std::vector<std::string> uids = population(2000, 1);
+    const std::set<std::string> all(uids.begin(), uids.end());
+    UidBus bus(uids);
+    bus.setLog(nullptr);
+    SimLink sim(bus);
+
+    CountingLink linear(sim);
+    std::set<std::string> walked;
+    ScanEngine engine(linear, walked);
+    linear.resetAll();
+    engine.scan("AB");
+    engine.scan("CB");
+    EXPECT_EQ(walked, all);
+
+    CountingLink halved(sim);
+    std::set<std::string> found;
+    BisectScan bisect(halved, found);
+    halved.resetAll();
+    bisect.scan("AB");
+    bisect.scan("CB");
+    EXPECT_TRUE(bisect.classesKnown());
+    EXPECT_EQ(found, all);
+    EXPECT_LT(halved.misses * 3, linear.misses);
+    EXPECT_LT(halved.probes, linear.probes);
+}
+
+TEST(BisectScanTest, SingleBranchCostsLogProbes)
+{
+    // two uids apart in their first serial symbol only: every level
+    // but the last has one branch, the last CHARSET symbol
+    const std::string tail(AisgUid::BODY - 1, '_');
+    const std::vector<std::string> uids = {"CBx" + tail, "CBy" + tail};
+    UidBus bus(uids);
+    bus.setLog(nullptr);
+    SimLink sim(bus);
+
+    CountingLink halved(sim);
+    std::set<std::string> found;
+    BisectScan bisect(halved, found);
+    bisect.scan("CB");
+    EXPECT_EQ(found, std::set<std::string>(uids.begin(), uids.end()));
+    // the prefix and its class, 6 to 12 probes a level; a miss at most
+    // for every halving
+    EXPECT_LE(halved.probes, 2u + AisgUid::BODY * 12);
+    EXPECT_LE(halved.misses, AisgUid::BODY * 6u);
+
+    CountingLink linear(sim);
+    std::set<std::string> walked;
+    ScanEngine engine(linear, walked);
+    linear.resetAll();
+    engine.scan("CB");
+    EXPECT_GT(linear.misses, (AisgUid::BODY - 1) * 60u);
+}
+
+TEST(BisectScanTest, FallsBackWithoutClasses)
+{
+    const std::vector<std::string> uids = population(300, 2);
+    UidBus bus(uids);
+    bus.setLog(nullptr);
+    SimLink sim(bus);
+    CountingLink link(sim, false);
+    std::set<std::string> found;
+    BisectScan bisect(link, found);
+    bisect.scan("AB");
+    bisect.scan("CB");
+    EXPECT_FALSE(bisect.classesKnown());
+    EXPECT_EQ(found, std::set<std::string>(uids.begin(), uids.end()));
+}
+
+TEST(BisectScanTest, DeferredConfirmAndCharset)
+{
+    // AB collisions are mixed and may read as uids
+    const std::vector<std::string> uids = population(1000, 3);
+    UidBus bus(uids);
+    bus.setLog(nullptr);
+    SimLink sim(bus);
+    for (auto confirm : {ScanEngine::Confirm::Deferred,
+             ScanEngine::Confirm::Echo}) {
+        std::set<std::string> found;
+        BisectScan bisect(sim, found);
+        bisect.setConfirm(confirm);
+        sim.resetAll();
+        bisect.scan("AB");
+        bisect.scan("CB");
+        EXPECT_EQ(found, std::set<std::string>(uids.begin(), uids.end()));
+    }
+
+    // a vendor of decimal serial numbers: 10 symbols a level
+    std::vector<std::string> decimal;
+    for (int i = 0; i < 200; ++i) {
+        std::string n = std::to_string(1000003 * i);
+        decimal.push_back("ZL" + std::string(AisgUid::BODY - n.size(),
+            '0') + n);
+    }
+    UidBus zl(decimal);
+    zl.setLog(nullptr);
+    SimLink zsim(zl);
+    SymbolPlan plan;
+    ASSERT_TRUE(plan.parse("ZL=0-9"));
+    CountingLink link(zsim);
+    std::set<std::string> found;
+    BisectScan bisect(link, found);
+    bisect.setSymbolPlan(&plan);
+    bisect.scan("ZL");
+    EXPECT_EQ(found,
+        std::set<std::string>(decimal.begin(), decimal.end()));
+}
@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+#include "charclass.h"
+#include "uidformat.h"
+#include "uidresp.h"
+
+TEST(CharClassTest, ParsesPositions)
+{
+    EXPECT_EQ(CharClass::positions("AB7"), 3u);
+    EXPECT_EQ(CharClass::positions("AB[0-9]7"), 4u);
+    EXPECT_EQ(CharClass::positions("[AC]B[-_a]"), 3u);
+    EXPECT_EQ(CharClass::positions(""), 0u);
+    EXPECT_EQ(CharClass::positions("AB[0-9"), 0u);  // not closed
+    EXPECT_EQ(CharClass::positions("AB[]7"), 0u);   // empty
+    EXPECT_EQ(CharClass::positions("AB[9-0]"), 0u); // wrong way round
+
+    CharClass c;
+    size_t at = 2;
+    ASSERT_TRUE(c.parse("AB[-0-2a-]7", at));
+    EXPECT_EQ(at, 10u);
+    EXPECT_EQ(c.count(), 5u); // `-` twice
+    for (char ch : {'-', '0', '1', '2', 'a'})
+        EXPECT_TRUE(c.contains(static_cast<unsigned char>(ch))) << ch;
+    EXPECT_FALSE(c.contains('3'));
+    unsigned char single = 0;
+    EXPECT_FALSE(c.single(single));
+    EXPECT_TRUE(CharClass('x').single(single));
+    EXPECT_EQ(single, 'x');
+}
+
+TEST(CharClassTest, FormatsShortestClass)
+{
+    EXPECT_EQ(CharClass::format("7"), "7");
+    EXPECT_EQ(CharClass::format("ba"), "[ab]");
+    EXPECT_EQ(CharClass::format("0123456789"), "[0-9]");
+    EXPECT_EQ(CharClass::format(AisgUid::CHARSET), "[-0-9A-Z_a-z]");
+    EXPECT_EQ(CharClass::format("-01_"), "[-01_]");
+
+    // whatever goes in comes out of parse() again
+    for (std::string_view chars : {"ba", "0123456789", "-01_", "ACEGIK",
+             "0-9"}) {
+        CharClass c;
+        size_t at = 0;
+        const std::string pattern = CharClass::format(chars);
+        ASSERT_TRUE(c.parse(pattern, at)) << pattern;
+        EXPECT_EQ(at, pattern.size());
+        for (char ch : chars)
+            EXPECT_TRUE(c.contains(static_cast<unsigned char>(ch)));
+        EXPECT_EQ(c.count(), std::string(chars).size());
+    }
+}
+
+TEST(CharClassTest, MatchesLikeThePlainRule)
+{
+    const std::string uid = "AB12345678901234567";
+    EXPECT_TRUE(AisgUid::matches("AB[0-9]", uid));
+    EXPECT_TRUE(AisgUid::matches("AB[5-7]7", uid));
+    EXPECT_FALSE(AisgUid::matches("AB[7-9]7", uid));
+    EXPECT_TRUE(AisgUid::matches("[AC]B67", uid));
+    EXPECT_FALSE(AisgUid::matches("[CD]B67", uid));
+    EXPECT_TRUE(AisgUid::matches("[A-Z]", uid));
+    EXPECT_FALSE(AisgUid::matches("AB[0-9", uid));
+    EXPECT_TRUE(UidResponder::matches("A[A-C]", "ABC"));
+    EXPECT_TRUE(UidResponder::matches("AB[A-C]", "ABC"));
+    EXPECT_FALSE(UidResponder::matches("AB[A-C]C", "ABC"));
+
+    // a class of one character is that character
+    for (const char *p : {"A", "AB", "AB7", "AB8", "AB67", "AB57"}) {
+        std::string classes;
+        for (const char *c = p; *c; ++c)
+            classes += std::string("[") + *c + "]";
+        EXPECT_EQ(AisgUid::matches(classes, uid), AisgUid::matches(p, uid))
+            << p;
+    }
+}
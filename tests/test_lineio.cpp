@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <string>
+#include "lineio.h"
+
+namespace {
+
+struct Pipe {
+    Pipe() { EXPECT_EQ(pipe(fd), 0); }
+    ~Pipe()
+    {
+        closeWrite();
+        close(fd[0]);
+    }
+    void put(const std::string &s)
+    {
+        ASSERT_EQ(::write(fd[1], s.data(), s.size()),
+            static_cast<ssize_t>(s.size()));
+    }
+    void closeWrite()
+    {
+        if (fd[1] >= 0)
+            close(fd[1]);
+        fd[1] = -1;
+    }
+    std::string drain()
+    {
+        closeWrite();
+        std::string s;
+        char buf[4096];
+        ssize_t n;
+        while ((n = ::read(fd[0], buf, sizeof(buf))) > 0)
+            s.append(buf, static_cast<size_t>(n));
+        return s;
+    }
+    int fd[2];
+};
+
+} // namespace
+
+TEST(LineReaderTest, BufferedLinesDoNotNeedPoll)
+{
+    Pipe p;
+    LineReader in(p.fd[0]);
+    std::string line;
+
+    EXPECT_FALSE(in.buffered());
+    EXPECT_FALSE(in.readLine(line, 0));
+
+    p.put("one\ntwo\nthr");
+    ASSERT_TRUE(in.readLine(line, 100));
+    EXPECT_EQ(line, "one");
+    // "two" came with the same read, the descriptor itself is empty now
+    EXPECT_TRUE(in.buffered());
+    ASSERT_TRUE(in.readLine(line, 0));
+    EXPECT_EQ(line, "two");
+    EXPECT_FALSE(in.buffered());
+    EXPECT_FALSE(in.readLine(line, 0));
+
+    p.put("ee\n\n");
+    ASSERT_TRUE(in.readLine(line, 100));
+    EXPECT_EQ(line, "three");
+    ASSERT_TRUE(in.readLine(line, 0));
+    EXPECT_EQ(line, "");
+}
+
+TEST(LineReaderTest, WrapsAndGrows)
+{
+    Pipe p;
+    LineReader in(p.fd[0], 64);
+    std::string line;
+
+    // lines straddling the end of the ring
+    for (int i = 0; i < 100; ++i) {
+        std::string s = "line-" + std::to_string(i) + "-payload";
+        p.put(s + "\n");
+        ASSERT_TRUE(in.readLine(line, 100));
+        EXPECT_EQ(line, s);
+    }
+
+    // longer than the whole buffer
+    std::string big(1000, 'x');
+    p.put(big + "\nafter\n");
+    ASSERT_TRUE(in.readLine(line, 100));
+    EXPECT_EQ(line, big);
+    ASSERT_TRUE(in.readLine(line, 100));
+    EXPECT_EQ(line, "after");
+}
+
+TEST(LineReaderTest, EndOfInput)
+{
+    Pipe p;
+    LineReader in(p.fd[0]);
+    std::string line;
+
+    p.put("a\nlast");
+    p.closeWrite();
+    ASSERT_TRUE(in.readLine(line));
+    EXPECT_EQ(line, "a");
+    ASSERT_TRUE(in.readLine(line));
+    EXPECT_EQ(line, "last");
+    EXPECT_FALSE(in.readLine(line));
+    EXPECT_TRUE(in.eof());
+}
+
+TEST(LineWriterTest, PutWaitsForFlush)
+{
+    Pipe p;
+    {
+        LineWriter out(p.fd[1]);
+        out.put("@1:", "AB");
+        out.put("SYNC:1");
+        EXPECT_EQ(out.pending(), 13u);
+        EXPECT_TRUE(out.write("direct\n"));
+        EXPECT_EQ(out.pending(), 0u);
+        out.put("tail");
+    } // flushed on destruction
+    EXPECT_EQ(p.drain(), "@1:AB\nSYNC:1\ndirect\ntail\n");
+}
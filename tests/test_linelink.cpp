@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <thread>
+#include "linelink.h"
+
+namespace {
+
+// the other end of the link, driven line by line by the test
+class Peer : public FdLink {
+public:
+    explicit Peer(int fd) :
+        FdLink(fd, fd, 1000)
+    {
+    }
+
+    std::string read()
+    {
+        std::string line;
+        return readRaw(line, 1000) ? line : "<none>";
+    }
+
+    void write(const std::string &data) { writeLines(data); }
+};
+
+struct SocketPair {
+    SocketPair() { socketpair(AF_UNIX, SOCK_STREAM, 0, fd); }
+    ~SocketPair()
+    {
+        close(fd[0]);
+        close(fd[1]);
+    }
+    int fd[2];
+};
+
+} // namespace
+
+TEST(LineLinkTest, SerialProbeAndAssign)
+{
+    SocketPair sp;
+    FdLink link(sp.fd[0], sp.fd[0], 200);
+    Peer peer(sp.fd[1]);
+
+    std::thread t([&]() {
+        EXPECT_EQ(peer.read(), "AB");
+        peer.write("\n"); // collision
+        EXPECT_EQ(peer.read(), "AB1");
+        peer.write("AB12345678901234561\n");
+        EXPECT_EQ(peer.read(), "SETADDR:AB12345678901234561");
+        peer.write("AB12345678901234561\n");
+        EXPECT_EQ(peer.read(), "AB2"); // no answer
+        EXPECT_EQ(peer.read(), "RESETALL");
+    });
+
+    EXPECT_EQ(link.probe("AB"), "!");
+    EXPECT_EQ(link.probe("AB1"), "AB12345678901234561");
+    EXPECT_EQ(link.assign("AB12345678901234561"), "AB12345678901234561");
+    EXPECT_EQ(link.probe("AB2"), "");
+    link.resetAll();
+    t.join();
+}
+
+TEST(LineLinkTest, PipelinedWindow)
+{
+    SocketPair sp;
+    FdLink link(sp.fd[0], sp.fd[0], 200, true);
+    Peer peer(sp.fd[1]);
+
+    std::thread t([&]() {
+        EXPECT_EQ(peer.read(), "@1:AB0");
+        EXPECT_EQ(peer.read(), "@2:AB1");
+        EXPECT_EQ(peer.read(), "@3:AB2");
+        EXPECT_EQ(peer.read(), "SYNC:3");
+        // replies of an older window and untagged noise are dropped
+        peer.write("@0:AB00000000000000000\nnoise\n"
+                   "@3:\n@1:AB00000000000000001\nSYNC:3\n");
+    });
+
+    std::vector<std::string> resp =
+        link.probeWindow({"AB0", "AB1", "AB2"});
+    t.join();
+    ASSERT_EQ(resp.size(), 3u);
+    EXPECT_EQ(resp[0], "AB00000000000000001");
+    EXPECT_EQ(resp[1], "");  // miss
+    EXPECT_EQ(resp[2], "!"); // empty payload: collision
+}
+
+TEST(LineLinkTest, ParseTagged)
+{
+    unsigned long tag = 0;
+    std::string payload;
+    EXPECT_TRUE(LineLink::parseTagged("@12:AB1", tag, payload));
+    EXPECT_EQ(tag, 12u);
+    EXPECT_EQ(payload, "AB1");
+    EXPECT_FALSE(LineLink::parseTagged("AB1", tag, payload));
+    EXPECT_FALSE(LineLink::parseTagged("@x:AB1", tag, payload));
+    EXPECT_FALSE(LineLink::parseTagged("@12AB1", tag, payload));
+}
+
+TEST(LineLinkTest, DeferredAssign)
+{
+    SocketPair sp;
+    FdLink link(sp.fd[0], sp.fd[0], 200);
+    Peer peer(sp.fd[1]);
+
+    std::thread t([&]() {
+        EXPECT_EQ(peer.read(), "@1:SETADDR:AB12345678901234561");
+        EXPECT_EQ(peer.read(), "@2:SETADDR:AB12345678901234562");
+        EXPECT_EQ(peer.read(), "AB3");
+        // echo of 1, none of 2, then the probe's reply
+        peer.write("@1:AB12345678901234561\nAB12345678901234563\n");
+        EXPECT_EQ(peer.read(), "@3:SETADDR:AB12345678901234563");
+        EXPECT_EQ(peer.read(), "SYNC:4");
+        peer.write("@3:AB12345678901234569\nSYNC:4\n");
+    });
+
+    link.assignLater("AB12345678901234561");
+    link.assignLater("AB12345678901234562");
+    EXPECT_EQ(link.probe("AB3"), "AB12345678901234563");
+    EXPECT_EQ(link.settle(false),
+        std::vector<std::string>{"AB12345678901234562"});
+    link.assignLater("AB12345678901234563");
+    EXPECT_EQ(link.settle(),
+        std::vector<std::string>{"AB12345678901234563"});
+    EXPECT_TRUE(link.settle().empty());
+    t.join();
+}
@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include <random>
+#include "parallelscan.h"
+#include "uidbus.h"
+
+namespace {
+
+std::vector<std::string> population(const std::string &pfx, size_t n,
+    unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<size_t> sym(0, AisgUid::SYMBOLS - 1);
+    std::set<std::string> uids;
+    while (uids.size() < n) {
+        std::string uid = pfx;
+        while (uid.size() < AisgUid::LENGTH)
+            uid.push_back(CHARSET[sym(rng)]);
+        uids.insert(uid);
+    }
+    return {uids.begin(), uids.end()};
+}
+
+// one simulated bus, `n` SimLinks into it
+struct Channels {
+    Channels(const std::vector<std::string> &uids, size_t n) :
+        bus(uids)
+    {
+        bus.setLog(nullptr);
+        for (size_t i = 0; i < n; ++i) {
+            links.push_back(std::make_unique<SimLink>(bus, &lock));
+            channels.push_back({links.back().get()});
+        }
+    }
+
+    UidBus bus;
+    std::mutex lock;
+    std::vector<std::unique_ptr<SimLink>> links;
+    std::vector<ParallelScan::Channel> channels;
+};
+
+size_t tasks(const ParallelScan &scan)
+{
+    size_t n = 0;
+    for (const auto &w : scan.workerStats())
+        n += w.tasks;
+    return n;
+}
+
+} // namespace
+
+TEST(ParallelScanTest, FindsWholePopulation)
+{
+    using Confirm = ScanEngine::Confirm;
+    // AB answers collisions with `mixed` strings, which may look like
+    // a uid; CB with an empty line
+    for (const char *pfx : {"AB", "CB"}) {
+        std::vector<std::string> uids = population(pfx, 2000, 1);
+        for (Confirm confirm : {Confirm::Echo, Confirm::Deferred}) {
+            Channels c(uids, 4);
+            std::set<std::string> found;
+            ParallelScan scan(c.channels, found);
+            scan.setConfirm(confirm);
+            scan.scan(pfx);
+            EXPECT_EQ(found, std::set<std::string>(uids.begin(),
+                uids.end())) << pfx;
+            EXPECT_GT(tasks(scan), 64u);
+        }
+    }
+}
+
+TEST(ParallelScanTest, SplitsCollidedNodesOnly)
+{
+    Channels one({"CB00000000000000001"}, 3);
+    std::set<std::string> found;
+    ParallelScan a(one.channels, found);
+    a.scan("CB");
+    EXPECT_EQ(found.size(), 1u);
+    EXPECT_EQ(tasks(a), 1u); // the prefix answered
+
+    // the prefix collides, its 64 children are probed once each
+    Channels two({"CB00000000000000001", "CB00000000000000002"}, 3);
+    found.clear();
+    ParallelScan b(two.channels, found);
+    b.scan("CB");
+    EXPECT_EQ(found.size(), 2u);
+    EXPECT_EQ(tasks(b), 65u);
+
+    // no split: one task walks it all
+    found.clear();
+    two.bus.index().unmuteAll();
+    ParallelScan c(two.channels, found);
+    c.setSplitDepth(0);
+    c.scan("CB");
+    EXPECT_EQ(found.size(), 2u);
+    EXPECT_EQ(tasks(c), 1u);
+}
+
+TEST(ParallelScanTest, SplitHonoursCharset)
+{
+    std::vector<std::string> uids = {"CB00000000000000001",
+        "CB00000000000000002", "CB00000000000000012"};
+    Channels c(uids, 2);
+    SymbolPlan plan;
+    ASSERT_TRUE(plan.parse("CB=0-9"));
+    std::set<std::string> found;
+    ParallelScan scan(c.channels, found);
+    scan.setSymbolPlan(&plan);
+    scan.scan("CB");
+    EXPECT_EQ(found, std::set<std::string>(uids.begin(), uids.end()));
+    // root, 10 children, 10 below the collided `CB2`
+    EXPECT_EQ(tasks(scan), 21u);
+}
@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+#include <map>
+#include <set>
+#include "popgen.h"
+#include "scanengine.h"
+#include "uidbus.h"
+
+namespace {
+
+std::string body(const std::string &uid)
+{
+    return uid.substr(AisgUid::PREFIX);
+}
+
+} // namespace
+
+TEST(PopulationGeneratorTest, DistinctAndReproducible)
+{
+    PopulationGenerator a({"AB", "CB"}, 7);
+    ASSERT_TRUE(a.parse("runs=0.2,suffixes=0.2,clusters=0.1,head=3"));
+    const std::vector<std::string> uids = a.generate(5000);
+    ASSERT_EQ(uids.size(), 5000u);
+    EXPECT_EQ(std::set<std::string>(uids.begin(), uids.end()).size(),
+        uids.size());
+    size_t ab = 0;
+    for (const auto &uid : uids) {
+        EXPECT_TRUE(AisgUid::isUid(uid)) << uid;
+        ab += uid.compare(0, 2, "AB") == 0;
+    }
+    EXPECT_GT(ab, 2000u);
+    EXPECT_LT(ab, 3000u);
+
+    PopulationGenerator b({"AB", "CB"}, 7);
+    ASSERT_TRUE(b.parse("runs=0.2,suffixes=0.2,clusters=0.1,head=3"));
+    EXPECT_EQ(b.generate(5000), uids);
+    PopulationGenerator c({"AB", "CB"}, 8);
+    EXPECT_NE(c.generate(5000), uids);
+}
+
+TEST(PopulationGeneratorTest, Shapes)
+{
+    // runs: a random head, then consecutive serial numbers
+    PopulationGenerator runs;
+    ASSERT_TRUE(runs.parse("runs=1,run-length=10,digits=4"));
+    std::vector<std::string> uids = runs.generate(100);
+    ASSERT_EQ(uids.size(), 100u);
+    for (size_t i = 1; i < 10; ++i) {
+        EXPECT_EQ(uids[i].substr(0, AisgUid::LENGTH - 4),
+            uids[0].substr(0, AisgUid::LENGTH - 4));
+        EXPECT_EQ(std::stoi(uids[i].substr(AisgUid::LENGTH - 4)),
+            (std::stoi(uids[0].substr(AisgUid::LENGTH - 4)) + int(i)) %
+                10000);
+    }
+
+    // shared suffixes: two endings per vendor
+    PopulationGenerator tails;
+    ASSERT_TRUE(tails.parse("suffixes=1,tails=2,suffix-length=8"));
+    std::set<std::string> endings;
+    for (const auto &uid : tails.generate(200))
+        endings.insert(uid.substr(AisgUid::LENGTH - 8));
+    EXPECT_EQ(endings.size(), 2u);
+
+    // clusters: groups differing in their first serial symbol only
+    PopulationGenerator clusters;
+    ASSERT_TRUE(clusters.parse("clusters=1,cluster-size=4"));
+    uids = clusters.generate(40);
+    ASSERT_EQ(uids.size(), 40u);
+    for (size_t i = 0; i < uids.size(); i += 4) {
+        for (size_t j = i + 1; j < i + 4; ++j) {
+            EXPECT_EQ(body(uids[j]).substr(1), body(uids[i]).substr(1));
+            EXPECT_NE(uids[j], uids[i]);
+        }
+    }
+
+    // a shared head per vendor
+    PopulationGenerator head({"AB", "CB"});
+    ASSERT_TRUE(head.parse("head=5"));
+    std::map<std::string, std::set<std::string>> heads;
+    for (const auto &uid : head.generate(100))
+        heads[uid.substr(0, 2)].insert(body(uid).substr(0, 5));
+    ASSERT_EQ(heads.size(), 2u);
+    EXPECT_EQ(heads["AB"].size(), 1u);
+    EXPECT_EQ(heads["CB"].size(), 1u);
+
+    // no room for more than 64 uids: as many as there are
+    PopulationGenerator full;
+    ASSERT_TRUE(full.parse("head=16"));
+    EXPECT_EQ(full.generate(100).size(), 64u);
+}
+
+TEST(PopulationGeneratorTest, RejectsMalformedShapes)
+{
+    PopulationGenerator g;
+    EXPECT_TRUE(g.parse(""));
+    EXPECT_FALSE(g.parse("runs"));
+    EXPECT_FALSE(g.parse("runs=1.5"));
+    EXPECT_FALSE(g.parse("runs=-0.1"));
+    EXPECT_FALSE(g.parse("cluster-size=1"));
+    EXPECT_FALSE(g.parse("digits=10"));
+    EXPECT_FALSE(g.parse("head=18"));
+    EXPECT_FALSE(g.parse("deep=1"));
+    EXPECT_FALSE(g.parse("runs=0.5,"));
+    EXPECT_TRUE(g.parse("runs=0.5,run-length=20"));
+    EXPECT_EQ(g.shape().runs, 0.5);
+    EXPECT_EQ(g.shape().runLength, 20u);
+}
+
+TEST(PopulationGeneratorTest, ScanFindsEveryShape)
+{
+    const std::vector<std::string> vendors = {"AB", "CB", "ZL"};
+    PopulationGenerator gen(vendors, 3);
+    ASSERT_TRUE(gen.parse("runs=0.3,suffixes=0.3,clusters=0.05,head=4"));
+    const std::vector<std::string> uids = gen.generate(3000);
+    UidBus bus(uids);
+    bus.setLog(nullptr);
+    SimLink link(bus);
+    std::set<std::string> found;
+    ScanEngine engine(link, found);
+    for (const auto &pfx : vendors)
+        engine.scan(pfx);
+    EXPECT_EQ(found, std::set<std::string>(uids.begin(), uids.end()));
+}
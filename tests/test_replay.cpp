@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <random>
+#include "replay.h"
+#include "trace.h"
+
+namespace {
+
+std::string tempPath()
+{
+    char path[] = "/tmp/test_replayXXXXXX";
+    int fd = mkstemp(path);
+    close(fd);
+    return path;
+}
+
+std::vector<std::string> population(size_t n, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<size_t> sym(0, AisgUid::SYMBOLS - 1);
+    std::set<std::string> uids;
+    while (uids.size() < n) {
+        std::string uid = uids.size() % 2 ? "AB" : "CB";
+        while (uid.size() < AisgUid::LENGTH)
+            uid.push_back(CHARSET[sym(rng)]);
+        uids.insert(uid);
+    }
+    return {uids.begin(), uids.end()};
+}
+
+// a serial scan of `uids` recorded in `path`
+void record(const std::vector<std::string> &uids, const std::string &path)
+{
+    UidBus bus(uids);
+    bus.setLog(nullptr);
+    SimLink sim(bus);
+    TraceSink sink(path);
+    ASSERT_TRUE(sink.ok());
+    TraceLink link(sim, sink, "sim");
+    ScanObserver quiet;
+    TraceObserver observer(quiet, sink, "sim");
+    std::set<std::string> found;
+    ScanEngine engine(link, found);
+    engine.setObserver(&observer);
+    link.resetAll();
+    for (const char *pfx : {"AB", "CB"}) {
+        sink.scan("sim", pfx);
+        engine.scan(pfx);
+    }
+    link.resetAll();
+}
+
+std::set<std::string> scan(ReplayLink &link, const Recording &rec,
+    ScanEngine::Confirm confirm = ScanEngine::Confirm::Echo)
+{
+    std::set<std::string> found;
+    ScanEngine engine(link, found);
+    engine.setConfirm(confirm);
+    link.resetAll();
+    for (const auto &pfx : rec.prefixes())
+        engine.scan(pfx);
+    link.resetAll();
+    return found;
+}
+
+} // namespace
+
+TEST(ReplayTest, SameStrategyReplaysTheRecording)
+{
+    const std::vector<std::string> uids = population(300, 1);
+    const std::string path = tempPath();
+    record(uids, path);
+
+    Recording rec;
+    ASSERT_TRUE(rec.load(path));
+    unlink(path.c_str());
+    EXPECT_EQ(rec.bus(), "sim");
+    EXPECT_EQ(rec.uids(), uids);
+    EXPECT_EQ(rec.prefixes(), std::vector<std::string>({"AB", "CB"}));
+    EXPECT_FALSE(rec.pipelined());
+
+    ReplayLink link(rec);
+    const std::set<std::string> found = scan(link, rec);
+    EXPECT_EQ(found, std::set<std::string>(uids.begin(), uids.end()));
+    EXPECT_TRUE(link.inStep());
+    EXPECT_EQ(link.replayed(), rec.exchanges().size());
+    long us = 0;
+    for (const auto &e : rec.exchanges())
+        us += e.us;
+    EXPECT_EQ(link.elapsedUs(), us);
+}
+
+TEST(ReplayTest, OtherStrategiesLeaveTheRecording)
+{
+    const std::vector<std::string> uids = population(300, 2);
+    const std::string path = tempPath();
+    record(uids, path);
+    Recording rec;
+    ASSERT_TRUE(rec.load(path));
+    unlink(path.c_str());
+
+    using Confirm = ScanEngine::Confirm;
+    for (Confirm confirm : {Confirm::Echo, Confirm::Deferred}) {
+        ReplayLink link(rec);
+        link.setPipelined(true);
+        const std::set<std::string> found = scan(link, rec, confirm);
+        EXPECT_EQ(found, std::set<std::string>(uids.begin(), uids.end()));
+        EXPECT_FALSE(link.inStep());
+        EXPECT_LT(link.roundTrips(), rec.exchanges().size());
+    }
+}
+
+TEST(ReplayTest, ServesRecordedResponsesAndLatencies)
+{
+    const std::string uid = "CB00000000000000001";
+    Recording rec;
+    ASSERT_TRUE(rec.add("{\"t\":1,\"bus\":\"a\",\"ev\":\"scan\","
+        "\"prefix\":\"CB\"}"));
+    // what the bus said, not what a simulation of it would say
+    ASSERT_TRUE(rec.add("{\"t\":2,\"bus\":\"a\",\"ev\":\"probe\","
+        "\"pattern\":\"CB\",\"resp\":\"!\",\"us\":300}"));
+    ASSERT_TRUE(rec.add("{\"t\":3,\"bus\":\"a\",\"ev\":\"probe\","
+        "\"pattern\":\"CB1\",\"resp\":\"" + uid + "\",\"us\":100}"));
+    ASSERT_TRUE(rec.add("{\"t\":4,\"bus\":\"a\",\"ev\":\"assign\","
+        "\"uid\":\"" + uid + "\",\"resp\":\"" + uid + "\",\"us\":50}"));
+    ASSERT_TRUE(rec.add("{\"t\":5,\"bus\":\"a#2\",\"ev\":\"probe\","
+        "\"pattern\":\"CB2\",\"resp\":\"\",\"us\":20000}"));
+    ASSERT_TRUE(rec.add("{\"t\":6,\"bus\":\"b\",\"ev\":\"probe\","
+        "\"pattern\":\"CB\",\"resp\":\"\",\"us\":7}")); // another bus
+    EXPECT_FALSE(rec.add("{\"t\":7,\"bus\":\"a\",\"ev\":\"probe\"}"));
+    EXPECT_FALSE(rec.add("not json"));
+    rec.finish();
+    EXPECT_EQ(rec.uids(), std::vector<std::string>({uid}));
+    EXPECT_EQ(rec.exchanges().size(), 4u);
+    ASSERT_EQ(rec.latency().miss, 20000);
+
+    ReplayLink link(rec);
+    EXPECT_EQ(link.probe("CB"), "!");
+    EXPECT_EQ(link.probe("CB1"), uid);
+    EXPECT_EQ(link.assign(uid), uid);
+    EXPECT_EQ(link.elapsedUs(), 450);
+    EXPECT_TRUE(link.inStep());
+
+    // off the recording: the simulated bus answers
+    EXPECT_EQ(link.probe("CB3"), "");
+    EXPECT_FALSE(link.inStep());
+    EXPECT_EQ(link.elapsedUs(), 20450);
+    EXPECT_EQ(link.probe("CB2"), ""); // muted
+    link.resetAll();
+    EXPECT_EQ(link.probe("CB1"), uid);
+    EXPECT_EQ(link.replayed(), 3u);
+}
@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+#include "rtt.h"
+
+TEST(RttEstimatorTest, CeilingWhileWarmingUp)
+{
+    RttEstimator rtt(5, 200);
+    EXPECT_EQ(rtt.timeout(), 200);
+    for (int i = 0; i < 3; ++i)
+        rtt.sample(1.0);
+    EXPECT_EQ(rtt.timeout(), 200);
+}
+
+TEST(RttEstimatorTest, ShrinksToFloorOnFastLink)
+{
+    RttEstimator rtt(5, 200);
+    for (int i = 0; i < 100; ++i)
+        rtt.sample(0.1);
+    EXPECT_EQ(rtt.timeout(), 5);
+}
+
+TEST(RttEstimatorTest, FollowsLatencyWithMargin)
+{
+    RttEstimator rtt(1, 1000);
+    for (int i = 0; i < 200; ++i)
+        rtt.sample(20.0 + (i % 5));
+    EXPECT_GE(rtt.timeout(), 2 * 24);
+    EXPECT_LT(rtt.timeout(), 100);
+    EXPECT_NEAR(rtt.srtt(), 22.0, 1.5);
+}
+
+TEST(RttEstimatorTest, OutliersRaiseP99)
+{
+    RttEstimator rtt(1, 1000);
+    for (int i = 0; i < 128; ++i)
+        rtt.sample(i % 32 == 0 ? 40.0 : 2.0);
+    EXPECT_DOUBLE_EQ(rtt.p99(), 40.0);
+    EXPECT_GE(rtt.timeout(), 80);
+}
+
+TEST(RttEstimatorTest, LateRepliesBackOffAndDecay)
+{
+    RttEstimator rtt(1, 1000);
+    for (int i = 0; i < 100; ++i)
+        rtt.sample(2.0);
+    const int base = rtt.timeout();
+
+    rtt.late();
+    EXPECT_EQ(rtt.timeout(), std::min(1000, 2 * base));
+    rtt.late();
+    EXPECT_EQ(rtt.timeout(), std::min(1000, 4 * base));
+
+    for (int i = 0; i < 200; ++i)
+        rtt.sample(2.0);
+    EXPECT_EQ(rtt.timeout(), base);
+}
@@ -0,0 +1,320 @@
+#include <gtest/gtest.h>
+#include <random>
+#include "scanengine.h"
+#include "uidindex.h"
+#include "vendortable.h"
+
+namespace {
+
+// uidresp in-process: same index, same vendor profiles
+class FakeLink : public ScanLink {
+public:
+    explicit FakeLink(const std::vector<std::string> &uids,
+        bool pipelined = false) :
+        index_(uids),
+        pipelined_(pipelined),
+        rng_(1)
+    {
+    }
+
+    std::string probe(const std::string &pattern) override
+    {
+        ++probes;
+        std::vector<std::string> matched = index_.match(pattern);
+        if (matched.empty())
+            return "";
+        if (matched.size() == 1)
+            return matched[0];
+        std::string out;
+        vendors_.lookup(matched[0]).respond(
+            {matched.begin(), matched.end()}, rng_, out);
+        return out.empty() ? "!" : out;
+    }
+
+    std::vector<std::string> probeWindow(
+        const std::vector<std::string> &patterns) override
+    {
+        ++windows;
+        return ScanLink::probeWindow(patterns);
+    }
+
+    bool pipelined() const override { return pipelined_; }
+
+    std::string assign(const std::string &uid) override
+    {
+        return index_.mute(uid) ? uid : "";
+    }
+
+    void resetAll() override { index_.unmuteAll(); }
+
+    VendorTable &vendors() { return vendors_; }
+
+    size_t probes = 0;
+    size_t windows = 0;
+
+private:
+    UidIndex index_;
+    VendorTable vendors_;
+    bool pipelined_;
+    std::mt19937 rng_;
+};
+
+std::vector<std::string> population(const std::string &pfx, size_t n,
+    unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<size_t> sym(0, 3);
+    std::vector<std::string> uids;
+    while (uids.size() < n) {
+        // few distinct symbols near the end force deep collision trees
+        std::string uid = pfx + "1234567890123";
+        for (int i = 0; i < 4; ++i)
+            uid.push_back(CHARSET[sym(rng)]);
+        if (std::find(uids.begin(), uids.end(), uid) == uids.end())
+            uids.push_back(uid);
+    }
+    return uids;
+}
+
+std::set<std::string> asSet(const std::vector<std::string> &v)
+{
+    return std::set<std::string>(v.begin(), v.end());
+}
+
+} // namespace
+
+TEST(ScanEngineTest, FindsWholePopulation)
+{
+    for (const char *pfx : { "AB", "CB" }) {
+        std::vector<std::string> uids = population(pfx, 40, 3);
+        FakeLink link(uids);
+        std::set<std::string> found;
+        ScanEngine engine(link, found);
+        engine.scan(pfx);
+        EXPECT_EQ(found, asSet(uids)) << pfx;
+        EXPECT_TRUE(engine.done());
+    }
+}
+
+TEST(ScanEngineTest, PipelinedFindsTheSame)
+{
+    std::vector<std::string> uids = population("AB", 40, 4);
+    FakeLink serial(uids), pipelined(uids, true);
+    std::set<std::string> a, b;
+    ScanEngine(serial, a).scan("AB");
+    ScanEngine(pipelined, b).scan("AB");
+    EXPECT_EQ(a, asSet(uids));
+    EXPECT_EQ(b, a);
+    EXPECT_GT(pipelined.windows, 0u);
+    EXPECT_EQ(serial.windows, 0u);
+}
+
+TEST(ScanEngineTest, InterleavedPrefixes)
+{
+    std::vector<std::string> ab = population("AB", 20, 5);
+    std::vector<std::string> zl = population("ZL", 20, 6);
+    std::vector<std::string> all = ab;
+    all.insert(all.end(), zl.begin(), zl.end());
+
+    FakeLink link(all);
+    std::set<std::string> found;
+    ScanEngine e1(link, found), e2(link, found);
+    e1.start("AB");
+    e2.start("ZL");
+    bool more = true;
+    while (more) {
+        more = e1.step();
+        more = e2.step() || more;
+    }
+    EXPECT_EQ(found, asSet(all));
+}
+
+TEST(ScanEngineTest, CheckpointRestore)
+{
+    std::vector<std::string> uids = population("AB", 30, 7);
+    FakeLink link(uids);
+    std::set<std::string> found;
+    ScanEngine first(link, found);
+    first.start("AB");
+    for (int i = 0; i < 100 && first.step(); ++i) {
+    }
+    ASSERT_FALSE(first.done());
+
+    ScanEngine second(link, found);
+    ASSERT_TRUE(second.restore(first.checkpoint()));
+    second.run();
+    EXPECT_EQ(found, asSet(uids));
+}
+
+TEST(ScanEngineTest, DepthLimit)
+{
+    struct Limits : ScanObserver {
+        void depthLimit(const std::string &) override { ++hits; }
+        int hits = 0;
+    } observer;
+
+    std::vector<std::string> uids = {
+        "AB00000000000000000", "AB10000000000000000"
+    };
+    FakeLink link(uids);
+    std::set<std::string> found;
+    ScanEngine engine(link, found);
+    engine.setObserver(&observer);
+    engine.setDepthLimit(4);
+    engine.scan("AB");
+    EXPECT_TRUE(found.empty());
+    EXPECT_GT(observer.hits, 0);
+
+    engine.setDepthLimit(MAXLEN);
+    engine.scan("AB");
+    EXPECT_EQ(found, asSet(uids));
+}
+
+TEST(ScanEngineTest, CharsetPrunesProbes)
+{
+    std::vector<std::string> uids = population("CB", 30, 8);
+    FakeLink full(uids), pruned(uids);
+    std::set<std::string> a, b;
+    ScanEngine(full, a).scan("CB");
+
+    SymbolPlan plan;
+    ASSERT_TRUE(plan.parse("CB=0-3"));
+    ScanEngine engine(pruned, b);
+    engine.setSymbolPlan(&plan);
+    engine.scan("CB");
+    EXPECT_EQ(b, asSet(uids));
+    EXPECT_LT(pruned.probes * 3, full.probes * 2);
+}
+
+TEST(ScanEngineTest, LearnedOrderFindsFaster)
+{
+    // serial numbers ending in symbols late in CHARSET; CB answers a
+    // collision with an empty line, so the probe counts are exact
+    std::vector<std::string> uids;
+    for (const char *tail : {"xy", "yz", "z_", "_x", "xx"})
+        uids.push_back(std::string("CB00000000000000") + "1" + tail);
+
+    SymbolPlan plan;
+    FakeLink cold(uids), warm(uids);
+    std::set<std::string> a, b;
+    ScanEngine first(cold, a);
+    first.setSymbolPlan(&plan);
+    first.scan("CB");
+    EXPECT_EQ(a, asSet(uids));
+
+    plan.setLearning(true); // statistics of the first scan
+    ScanEngine second(warm, b);
+    second.setSymbolPlan(&plan);
+    second.scan("CB");
+    EXPECT_EQ(b, asSet(uids));
+    EXPECT_LT(warm.probes * 3, cold.probes * 2);
+}
+
+TEST(ScanEngineTest, CollisionHints)
+{
+    using Hints = ScanEngine::CollisionHints;
+    std::vector<std::string> uids = population("ZL", 40, 9);
+    for (const char *profile : {"ZL=or", "ZL=mixed"}) {
+        const Hints hints = profile[3] == 'o' ? Hints::Or : Hints::Mixed;
+        FakeLink bare(uids), hinted(uids);
+        ASSERT_TRUE(bare.vendors().parse(profile));
+        ASSERT_TRUE(hinted.vendors().parse(profile));
+
+        std::set<std::string> a, b;
+        ScanEngine(bare, a).scan("ZL");
+        ScanEngine engine(hinted, b);
+        engine.setCollisionHints(hints);
+        engine.scan("ZL");
+        EXPECT_EQ(b, asSet(uids)) << profile;
+        if (hints == Hints::Or) {
+            // without hints an OR response that aliases a uid hides
+            // the others behind it
+            EXPECT_LT(hinted.probes * 3, bare.probes * 2);
+        } else {
+            EXPECT_EQ(a, asSet(uids)) << profile;
+            EXPECT_LE(hinted.probes, bare.probes);
+        }
+    }
+}
+
+TEST(ScanEngineTest, OrHintsSurviveCheckpoint)
+{
+    std::vector<std::string> uids = population("ZL", 30, 10);
+    FakeLink link(uids);
+    ASSERT_TRUE(link.vendors().parse("ZL=or"));
+    std::set<std::string> found;
+    ScanEngine first(link, found);
+    first.setCollisionHints(ScanEngine::CollisionHints::Or);
+    first.start("ZL");
+    for (int i = 0; i < 20 && first.step(); ++i) {
+    }
+    ASSERT_FALSE(first.done());
+
+    ScanEngine second(link, found);
+    second.setCollisionHints(ScanEngine::CollisionHints::Or);
+    ASSERT_TRUE(second.restore(first.checkpoint()));
+    second.run();
+    EXPECT_EQ(found, asSet(uids));
+}
+
+TEST(ScanEngineTest, VerifyKnownThenScanTheRest)
+{
+    std::vector<std::string> uids = population("CB", 30, 11);
+    std::vector<std::string> known(uids.begin(), uids.begin() + 25);
+    known.push_back("CB00000000000000000"); // gone since the last scan
+
+    for (bool pipelined : {false, true}) {
+        FakeLink link(uids, pipelined);
+        std::set<std::string> found;
+        ScanEngine engine(link, found);
+        EXPECT_EQ(engine.verify(known), 25u);
+        EXPECT_EQ(found, asSet({uids.begin(), uids.begin() + 25}));
+        engine.scan("CB");
+        EXPECT_EQ(found, asSet(uids));
+    }
+}
+
+TEST(ScanEngineTest, SteadyStateRescan)
+{
+    std::vector<std::string> uids = population("CB", 30, 12);
+    FakeLink link(uids);
+    std::set<std::string> found;
+    ScanEngine engine(link, found);
+    EXPECT_EQ(engine.verify(uids), uids.size());
+    engine.scan("CB");
+    EXPECT_EQ(found, asSet(uids));
+    // one probe per known uid, then the prefix alone stays silent
+    EXPECT_EQ(link.probes, uids.size() + 1);
+}
+
+TEST(ScanEngineTest, DeferredConfirmRetractsFakes)
+{
+    using Confirm = ScanEngine::Confirm;
+    std::vector<std::string> uids = population("AB", 40, 13);
+    for (bool pipelined : {false, true}) {
+        // mixed collision strings from a few uids often are uids
+        // themselves, only the SETADDR echo tells
+        FakeLink link(uids, pipelined);
+        std::set<std::string> found;
+        ScanEngine engine(link, found);
+        engine.setConfirm(Confirm::Deferred);
+        engine.scan("AB");
+        EXPECT_EQ(found, asSet(uids)) << pipelined;
+    }
+}
+
+TEST(ScanEngineTest, CrcConfirm)
+{
+    std::set<std::string> checked;
+    for (std::string uid : population("CB", 40, 14)) {
+        uid.back() = AisgUid::checkSymbol(uid);
+        checked.insert(uid);
+    }
+    std::vector<std::string> uids(checked.begin(), checked.end());
+    FakeLink link(uids);
+    std::set<std::string> found;
+    ScanEngine engine(link, found);
+    engine.setConfirm(ScanEngine::Confirm::Crc);
+    engine.scan("CB");
+    EXPECT_EQ(found, checked);
+}
@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include <sstream>
+#include "scanstats.h"
+#include "uidbus.h"
+
+namespace {
+
+const std::vector<std::string> UIDS = {
+    "CB00000000000000001",
+    "CB00000000000000002",
+    "CB00000000000000013",
+    "ZL12345678901234567",
+};
+
+} // namespace
+
+TEST(HistogramTest, Percentiles)
+{
+    Histogram h;
+    EXPECT_EQ(h.percentile(50), 0u);
+    for (uint64_t v = 1; v <= 100; ++v)
+        h.record(v);
+    EXPECT_EQ(h.count(), 100u);
+    EXPECT_EQ(h.min(), 1u);
+    EXPECT_EQ(h.max(), 100u);
+    EXPECT_DOUBLE_EQ(h.mean(), 50.5);
+    EXPECT_EQ(h.percentile(0), 1u);
+    EXPECT_EQ(h.percentile(100), 100u);
+    // within the 1/8 bucket resolution
+    EXPECT_GE(h.percentile(50), 50u);
+    EXPECT_LE(h.percentile(50), 50u + 50u / 8);
+    EXPECT_GE(h.percentile(90), 90u);
+    EXPECT_LE(h.percentile(90), 90u + 90u / 8);
+
+    Histogram big;
+    big.record(uint64_t(1) << 40);
+    big.record(UINT64_MAX);
+    h.merge(big);
+    EXPECT_EQ(h.count(), 102u);
+    EXPECT_EQ(h.max(), UINT64_MAX);
+    EXPECT_LE(h.percentile(50), 57u);
+}
+
+TEST(ScanStatsTest, CountsAScan)
+{
+    UidBus bus(UIDS);
+    bus.setLog(nullptr);
+    SimLink sim(bus);
+    ScanStats stats;
+    StatsLink link(sim, stats);
+    ScanObserver quiet;
+    StatsObserver observer(quiet, stats);
+
+    std::set<std::string> found;
+    ScanEngine engine(link, found);
+    engine.setObserver(&observer);
+    link.resetAll();
+    engine.scan("CB");
+    engine.scan("ZL");
+    engine.scan("XY");
+
+    ASSERT_EQ(stats.prefixes().size(), 3u);
+    const ScanStats::Prefix &cb = stats.prefixes().at("CB");
+    EXPECT_EQ(cb.found, 3u);
+    EXPECT_GT(cb.collisions, 0u);
+    EXPECT_GT(cb.noAnswer, 0u);
+    EXPECT_EQ(cb.probeNs.count(), cb.probes - cb.noAnswer);
+    // CB collides with empty lines, so only real uids get a SETADDR
+    EXPECT_EQ(cb.confirmations, 3u);
+    EXPECT_EQ(cb.rejected, 0u);
+    const ScanStats::Prefix &zl = stats.prefixes().at("ZL");
+    EXPECT_EQ(zl.found, 1u);
+    EXPECT_EQ(zl.probes, 1u);
+    EXPECT_EQ(stats.prefixes().at("XY").noAnswer, 1u);
+
+    ScanStats::Prefix all = stats.total();
+    EXPECT_EQ(all.found, 4u);
+    EXPECT_EQ(all.probes, cb.probes + 2);
+
+    std::ostringstream json;
+    stats.writeJson(json, 1.5);
+    EXPECT_EQ(json.str().rfind("{\"seconds\":1.5,\"total\":{\"found\":4,",
+        0), 0u);
+    EXPECT_NE(json.str().find("\"ZL\":{\"found\":1,\"probes\":1,"),
+        std::string::npos);
+}
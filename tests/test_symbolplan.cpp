@@ -0,0 +1,43 @@
+#include <gtest/gtest.h>
+#include "symbolplan.h"
+
+TEST(SymbolPlanTest, ParseCharsets)
+{
+    SymbolPlan plan;
+    EXPECT_EQ(plan.charset("CB"), std::string(AisgUid::CHARSET));
+
+    EXPECT_TRUE(plan.parse("CB=0-9"));
+    EXPECT_EQ(plan.charset("CB"), "0123456789");
+    EXPECT_EQ(plan.charset("ZL"), std::string(AisgUid::CHARSET));
+
+    EXPECT_TRUE(plan.parse("*=A-F_-"));
+    EXPECT_EQ(plan.charset("ZL"), "ABCDEF-_");
+    EXPECT_TRUE(plan.parse("ZL=Z-az0"));
+    EXPECT_EQ(plan.charset("ZL"), "0Zaz_"); // `_` lies within Z-a
+
+    EXPECT_FALSE(plan.parse("CB"));
+    EXPECT_FALSE(plan.parse("=0-9"));
+    EXPECT_FALSE(plan.parse("CB="));
+    EXPECT_FALSE(plan.parse("CB=0-9!"));
+    EXPECT_FALSE(plan.parse("CB=9-0"));
+    EXPECT_EQ(plan.charset("CB"), "0123456789");
+}
+
+TEST(SymbolPlanTest, LearnedOrder)
+{
+    SymbolPlan plan;
+    ASSERT_TRUE(plan.parse("CB=0-9"));
+    plan.learn("CB00000000000000071");
+    plan.learn("CB00000000000000072");
+    plan.learn("CB00000000000000373");
+    plan.learn("CB0000000000000037"); // too short, ignored
+
+    // counted, but not used until learning is on
+    EXPECT_EQ(plan.symbols("CB", 0), "0123456789");
+
+    plan.setLearning(true);
+    EXPECT_EQ(plan.symbols("CB", 0), "3120745689");
+    EXPECT_EQ(plan.symbols("CB", 1), "7031245689");
+    EXPECT_EQ(plan.symbols("CB", 2), "0371245689");
+    EXPECT_EQ(plan.symbols("HS", 0), std::string(AisgUid::CHARSET));
+}
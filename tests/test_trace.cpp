@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include "trace.h"
+
+namespace {
+
+class EchoLink : public ScanLink {
+public:
+    std::string probe(const std::string &pattern) override
+    {
+        return pattern == "AB" ? "!" : "";
+    }
+    bool pipelined() const override { return true; }
+    std::string assign(const std::string &uid) override { return uid; }
+    void resetAll() override {}
+};
+
+std::string tempPath()
+{
+    char path[] = "/tmp/test_traceXXXXXX";
+    int fd = mkstemp(path);
+    close(fd);
+    return path;
+}
+
+std::vector<std::string> readLines(const std::string &path)
+{
+    std::ifstream in(path);
+    std::vector<std::string> lines;
+    for (std::string l; std::getline(in, l);) {
+        // timings vary from run to run
+        std::string s;
+        std::istringstream fields(l);
+        for (std::string f; std::getline(fields, f, ',');) {
+            if (f.rfind("{\"t\":", 0) == 0 || f.rfind("\"us\":", 0) == 0)
+                continue;
+            s += (s.empty() ? "" : ",") + f;
+        }
+        lines.push_back(s);
+    }
+    return lines;
+}
+
+} // namespace
+
+TEST(TraceTest, RecordsLinkTrafficAndEvents)
+{
+    const std::string path = tempPath();
+    {
+        TraceSink sink(path);
+        ASSERT_TRUE(sink.ok());
+        EchoLink echo;
+        TraceLink link(echo, sink, "b0");
+        ScanObserver quiet;
+        TraceObserver observer(quiet, sink, "b0");
+
+        EXPECT_TRUE(link.pipelined());
+        sink.scan("b0", "AB");
+        EXPECT_EQ(link.probe("AB"), "!");
+        observer.collision("AB", 0);
+        EXPECT_EQ(link.probeWindow({"AB0", "AB1"}),
+            std::vector<std::string>({"", ""}));
+        EXPECT_EQ(link.assign("AB\"x"), "AB\"x");
+        observer.found("AB\"x");
+        link.resetAll();
+    }
+
+    std::vector<std::string> expected = {
+        "\"bus\":\"b0\",\"ev\":\"scan\",\"prefix\":\"AB\"}",
+        "\"bus\":\"b0\",\"ev\":\"probe\",\"pattern\":\"AB\",\"resp\":\"!\"",
+        "\"bus\":\"b0\",\"ev\":\"collision\",\"pattern\":\"AB\","
+            "\"level\":0}",
+        "\"bus\":\"b0\",\"ev\":\"window\",\"patterns\":[\"AB0\",\"AB1\"],"
+            "\"resp\":[\"\",\"\"]",
+        "\"bus\":\"b0\",\"ev\":\"assign\",\"uid\":\"AB\\\"x\","
+            "\"resp\":\"AB\\\"x\"",
+        "\"bus\":\"b0\",\"ev\":\"found\",\"uid\":\"AB\\\"x\"}",
+        "\"bus\":\"b0\",\"ev\":\"reset\"}",
+    };
+    EXPECT_EQ(readLines(path), expected);
+    unlink(path.c_str());
+}
@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+#include <cerrno>
+#include <fstream>
+#include <memory>
+#include "uidarena.h"
+#include "uidfile.h"
+
+TEST(UidArenaTest, FixedWidthSlots)
+{
+    UidArena arena;
+    EXPECT_TRUE(arena.empty());
+    EXPECT_EQ(arena.width(), AisgUid::LENGTH);
+    arena.push_back("CB00000000000000001");
+    arena.push_back("ZL1");
+    ASSERT_EQ(arena.size(), 2u);
+    EXPECT_EQ(arena[0], "CB00000000000000001");
+    EXPECT_EQ(arena[1], "ZL1");
+    EXPECT_EQ(arena.slots().size(), 2 * AisgUid::LENGTH);
+    // the views point into the one block
+    EXPECT_EQ(arena[1].data(), arena[0].data() + arena.width());
+
+    // a longer uid widens every slot
+    arena.push_back("AB123456789012345678901");
+    EXPECT_EQ(arena.width(), 23u);
+    EXPECT_EQ(arena[0], "CB00000000000000001");
+    EXPECT_EQ(arena[1], "ZL1");
+    EXPECT_EQ(arena[2], "AB123456789012345678901");
+
+    arena.permute({2, 0, 1});
+    EXPECT_EQ(arena[0], "AB123456789012345678901");
+    EXPECT_EQ(arena[1], "CB00000000000000001");
+    EXPECT_EQ(arena[2], "ZL1");
+}
+
+TEST(UidArenaTest, PackedFileIsTheArena)
+{
+    const std::string path = testing::TempDir() + "uidarena_pack.bin";
+    UidArena arena(std::vector<std::string>{
+        "CB00000000000000001", "AB12345678901234567", "ZL1"});
+    ASSERT_TRUE(UidFile::writePacked(path, arena));
+
+    UidArena loaded;
+    loaded.push_back("HS00000000000000009");
+    ASSERT_TRUE(UidFile::load(path, loaded));
+    ASSERT_EQ(loaded.size(), 4u);
+    EXPECT_EQ(loaded[0], "HS00000000000000009");
+    EXPECT_EQ(loaded[1], "CB00000000000000001");
+    EXPECT_EQ(loaded[3], "ZL1");
+    EXPECT_EQ(loaded.slots().substr(loaded.width()), arena.slots());
+}
+
+TEST(UidArenaTest, RefusesUidsPastMaxLen)
+{
+    UidArena arena;
+    const std::string longest(UidArena::MAX_LEN, 'A');
+    ASSERT_TRUE(arena.push_back(longest));
+    errno = 0;
+    EXPECT_FALSE(arena.push_back(longest + "B"));
+    EXPECT_EQ(errno, EINVAL);
+    ASSERT_EQ(arena.size(), 1u);
+    EXPECT_EQ(arena[0], longest);
+
+    // nor is a length cut short on the way in from a file
+    const std::string path = testing::TempDir() + "uidarena_long.txt";
+    std::ofstream(path) << "ZL1\n" << longest << "B\n";
+    UidArena loaded;
+    errno = 0;
+    EXPECT_FALSE(UidFile::load(path, loaded));
+    EXPECT_EQ(errno, EINVAL);
+}
+
+TEST(UidArenaTest, ViewCopiesOnChange)
+{
+    const UidArena arena(std::vector<std::string>{
+        "CB00000000000000001", "ZL1"});
+    auto backing = std::make_shared<UidArena>(arena);
+    UidArena view = UidArena::view(backing, backing->slots().data(),
+        backing->lengths(), backing->width(), backing->size());
+    ASSERT_EQ(view.size(), 2u);
+    EXPECT_EQ(view[1], "ZL1");
+    EXPECT_EQ(view[0].data(), (*backing)[0].data()); // not copied
+
+    UidArena copy = view;
+    EXPECT_EQ(copy[0].data(), view[0].data());
+    view.push_back("AB12345678901234567");
+    ASSERT_EQ(view.size(), 3u);
+    EXPECT_NE(view[0].data(), (*backing)[0].data());
+    EXPECT_EQ(view[0], "CB00000000000000001");
+    EXPECT_EQ(view[2], "AB12345678901234567");
+    EXPECT_EQ(backing->size(), 2u);
+    EXPECT_EQ(copy.size(), 2u);
+}
@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+#include "uidbus.h"
+
+namespace {
+
+const std::vector<std::string> UIDS = {
+    "AB12345678901234567",
+    "AB12345678901234568",
+    "CB00000000000000001",
+    "CB00000000000000002",
+};
+
+std::string reply(UidBus &bus, const std::string &line)
+{
+    std::string r;
+    return bus.handle(line, r) ? r : "<none>";
+}
+
+} // namespace
+
+TEST(UidBusTest, AnswersPatternsAndCommands)
+{
+    UidBus bus(UIDS);
+    bus.setLog(nullptr);
+
+    EXPECT_EQ(reply(bus, ""), "<none>");
+    EXPECT_EQ(reply(bus, "AB7"), "AB12345678901234567");
+    EXPECT_EQ(reply(bus, "AB9"), "<none>");
+    EXPECT_EQ(reply(bus, "CB"), ""); // CB collides with an empty line
+    EXPECT_EQ(reply(bus, "SYNC:5"), "SYNC:5");
+    // a bare SYNC is a pattern: vendor SY, ending in NC
+    EXPECT_EQ(reply(bus, "SYNC"), "<none>");
+    UidBus sy(std::vector<std::string>{"SY000000000000000NC"});
+    EXPECT_EQ(reply(sy, "SYNC"), "SY000000000000000NC");
+
+    EXPECT_EQ(reply(bus, "SETADDR:AB12345678901234567"),
+        "AB12345678901234567");
+    EXPECT_EQ(reply(bus, "SETADDR:AB00000000000000000"), "<none>");
+    EXPECT_EQ(reply(bus, "AB7"), "<none>");
+    EXPECT_EQ(reply(bus, "AB"), "AB12345678901234568");
+
+    EXPECT_EQ(reply(bus, "RESETADDR:AB12345678901234567"), "<none>");
+    EXPECT_EQ(reply(bus, "AB7"), "AB12345678901234567");
+    EXPECT_EQ(reply(bus, "SETADDR:AB12345678901234568"),
+        "AB12345678901234568");
+    EXPECT_EQ(reply(bus, "RESETALL"), "<none>");
+    EXPECT_EQ(reply(bus, "AB8"), "AB12345678901234568");
+}
+
+TEST(UidBusTest, TaggedLines)
+{
+    UidBus bus(UIDS);
+    bus.setLog(nullptr);
+
+    EXPECT_EQ(reply(bus, "@3:AB7"), "@3:AB12345678901234567");
+    EXPECT_EQ(reply(bus, "@4:CB"), "@4:");
+    EXPECT_EQ(reply(bus, "@5:AB9"), "<none>");
+    EXPECT_EQ(reply(bus, "@6:"), "<none>");
+    EXPECT_EQ(reply(bus, "@7:SYNC:7"), "@7:SYNC:7");
+}
+
+TEST(UidBusTest, FastCollisionMode)
+{
+    UidBus bus(UIDS);
+    bus.setLog(nullptr);
+
+    EXPECT_NE(reply(bus, "AB"), ""); // a mix of both uids
+    EXPECT_EQ(reply(bus, "MODE:FASTCOLLISION"), "MODE:FASTCOLLISION");
+    EXPECT_EQ(reply(bus, "AB"), "");
+    EXPECT_EQ(reply(bus, "@2:AB"), "@2:");
+    EXPECT_EQ(reply(bus, "AB7"), "AB12345678901234567");
+    EXPECT_EQ(reply(bus, "MODE:QUIET"), "<none>");
+    EXPECT_EQ(reply(bus, "AB"), ""); // unchanged
+    EXPECT_EQ(reply(bus, "@3:MODE:NORMAL"), "@3:MODE:NORMAL");
+    EXPECT_NE(reply(bus, "AB"), "");
+
+    // what one session switches, another one does not see
+    UidBus::Session fast;
+    std::string r;
+    ASSERT_TRUE(bus.handle("MODE:FASTCOLLISION", r, fast));
+    EXPECT_TRUE(fast.fastCollision);
+    r.clear();
+    ASSERT_TRUE(bus.handle("AB", r, fast));
+    EXPECT_EQ(r, "");
+    EXPECT_NE(reply(bus, "AB"), "");
+
+    UidBus::Session preset;
+    preset.fastCollision = true;
+    bus.setDefaultSession(preset);
+    EXPECT_EQ(reply(bus, "AB"), "");
+
+    UidBus other(UIDS);
+    other.setLog(nullptr);
+    SimLink link(other);
+    EXPECT_TRUE(link.setMode("FASTCOLLISION"));
+    EXPECT_FALSE(link.setMode("QUIET"));
+    EXPECT_EQ(link.probe("AB"), "!");
+}
+
+TEST(UidBusTest, SimLinkScansThePopulation)
+{
+    UidBus bus(UIDS);
+    bus.setLog(nullptr);
+    SimLink link(bus);
+
+    EXPECT_EQ(link.probe("CB"), "!");
+    EXPECT_EQ(link.probe("XY"), "");
+
+    std::set<std::string> found;
+    ScanEngine engine(link, found);
+    link.resetAll();
+    engine.scan("AB");
+    engine.scan("CB");
+    EXPECT_EQ(found, std::set<std::string>(UIDS.begin(), UIDS.end()));
+}
+
+TEST(UidBusTest, Stats)
+{
+    VendorTable vendors;
+    ASSERT_TRUE(vendors.parse("AB=mixed"));
+    UidBus bus(UIDS, vendors);
+    bus.setLog(nullptr);
+    reply(bus, "AB9"); // before setStats(): not counted
+    bus.setStats(true);
+
+    reply(bus, "AB7");
+    reply(bus, "AB9");
+    reply(bus, "AB");
+    reply(bus, "CB");
+    reply(bus, "SYNC:1");
+
+    const UidBus::Stats &s = bus.stats();
+    EXPECT_EQ(s.lines, 5u);
+    EXPECT_EQ(s.patterns, 4u);
+    EXPECT_EQ(s.noMatch, 1u);
+    EXPECT_EQ(s.unique, 1u);
+    EXPECT_EQ(s.collisions, 2u);
+    EXPECT_EQ(s.collisionNs.count(), 2u);
+    // CB (empty) doesn't look at its participants
+    EXPECT_EQ(s.participants.count(), 1u);
+    EXPECT_EQ(s.participants.max(), 2u);
+}
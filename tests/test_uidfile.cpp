@@ -0,0 +1,238 @@
+#include <gtest/gtest.h>
+#include <cerrno>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <random>
+#include <set>
+#include "uidbus.h"
+#include "uidfile.h"
+
+namespace {
+
+std::string tempPath(const std::string &name)
+{
+    return testing::TempDir() + "uidfile_" + name;
+}
+
+const std::vector<std::string> UIDS = {
+    "CB00000000000000001",
+    "AB12345678901234567",
+    "CB00000000000000002",
+    "ZL1",
+};
+
+} // namespace
+
+TEST(UidFileTest, LoadsText)
+{
+    const std::string path = tempPath("text.txt");
+    std::ofstream(path) << "# population\n"
+                        << "CB00000000000000001\n"
+                        << "\n"
+                        << "  AB12345678901234567\t\r\n"
+                        << "CB00000000000000002"; // no final newline
+    std::vector<std::string> uids = {"ZL1"};
+    ASSERT_TRUE(UidFile::load(path, uids));
+    EXPECT_EQ(uids, (std::vector<std::string>{"ZL1",
+        "CB00000000000000001", "AB12345678901234567",
+        "CB00000000000000002"}));
+
+    errno = 0;
+    EXPECT_FALSE(UidFile::load(tempPath("missing"), uids));
+    EXPECT_EQ(errno, ENOENT);
+}
+
+TEST(UidFileTest, PackedRoundTrip)
+{
+    const std::string path = tempPath("packed.bin");
+    ASSERT_TRUE(UidFile::writePacked(path, UIDS));
+    std::vector<std::string> uids;
+    ASSERT_TRUE(UidFile::load(path, uids));
+    EXPECT_EQ(uids, UIDS);
+
+    // a count beyond the data is refused
+    std::string head(UidFile::PACK_MAGIC, 8);
+    uint32_t width = 19, count = 2;
+    head.append(reinterpret_cast<const char *>(&width), 4);
+    head.append(reinterpret_cast<const char *>(&count), 4);
+    std::ofstream(path, std::ios::trunc) << head << UIDS[0];
+    uids.clear();
+    errno = 0;
+    EXPECT_FALSE(UidFile::load(path, uids));
+    EXPECT_EQ(errno, EINVAL);
+}
+
+TEST(UidFileTest, ImageRoundTrip)
+{
+    const std::string path = tempPath("pop.img");
+    std::vector<std::string> uids = UIDS;
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<size_t> sym(0, AisgUid::SYMBOLS - 1);
+    for (int i = 0; i < 500; ++i) {
+        std::string uid = i % 2 ? "AB" : "CB";
+        while (uid.size() < AisgUid::LENGTH)
+            uid.push_back(CHARSET[sym(rng)]);
+        uids.push_back(uid);
+    }
+    const UidIndex built(uids);
+    ASSERT_TRUE(UidFile::writeImage(path, built));
+
+    std::optional<UidIndex> image;
+    ASSERT_TRUE(UidFile::loadImage(path, image));
+    ASSERT_EQ(image->size(), built.size());
+    EXPECT_EQ(image->fingerprint(), built.fingerprint());
+    for (size_t i = 0; i < built.size(); ++i) {
+        ASSERT_EQ(image->uid(i), built.uid(i));
+        EXPECT_EQ(image->match(built.uid(i).substr(0, 5)),
+            built.match(built.uid(i).substr(0, 5)));
+    }
+    for (const char *p : {"C", "AB", "CB0", "ZL1", "AB[0-9]7", "[AC]B_"})
+        EXPECT_EQ(image->match(p), built.match(p)) << p;
+
+    // muted state is per process, and snapshots fit either
+    ASSERT_TRUE(image->mute("ZL1"));
+    EXPECT_EQ(image->match("ZL"), std::vector<std::string>{});
+    ASSERT_TRUE(UidFile::saveMuted(tempPath("image.snap"), *image));
+    UidIndex restored(uids);
+    ASSERT_TRUE(UidFile::loadMuted(tempPath("image.snap"), restored));
+    EXPECT_TRUE(restored.isMuted("ZL1"));
+
+    // as a population file it is its uids
+    std::vector<std::string> loaded;
+    ASSERT_TRUE(UidFile::load(path, loaded));
+    EXPECT_EQ(std::set<std::string>(loaded.begin(), loaded.end()),
+        std::set<std::string>(uids.begin(), uids.end()));
+
+    // another version, or cut short
+    std::string data;
+    {
+        std::ifstream in(path, std::ios::binary);
+        data.assign(std::istreambuf_iterator<char>(in), {});
+    }
+    for (size_t cut : {size_t(8), data.size() - 1}) {
+        std::string bad = data;
+        if (cut == 8)
+            bad[8] ^= 2;
+        else
+            bad.resize(cut);
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << bad;
+        std::optional<UidIndex> rejected;
+        errno = 0;
+        EXPECT_FALSE(UidFile::loadImage(path, rejected));
+        EXPECT_EQ(errno, EINVAL);
+        EXPECT_FALSE(rejected);
+    }
+}
+
+TEST(UidFileTest, ImageOutOfBounds)
+{
+    const std::string path = tempPath("bounds.img");
+    ASSERT_TRUE(UidFile::writeImage(path, UidIndex(UIDS)));
+    std::string data;
+    {
+        std::ifstream in(path, std::ios::binary);
+        data.assign(std::istreambuf_iterator<char>(in), {});
+    }
+    // the sections as writeImage() places them, after a 40 byte header
+    auto align8 = [](size_t at) { return (at + 7) & ~size_t(7); };
+    const size_t width = data[16], count = data[24];
+    const size_t lengthsAt = align8(40 + count * width);
+    const size_t nodesAt = align8(lengthsAt + count * sizeof(uint16_t));
+
+    // a UID longer than its slot, a range past the UIDs, children past
+    // the nodes
+    for (size_t at : {lengthsAt, nodesAt + 4, nodesAt + 12}) {
+        std::string bad = data;
+        bad[at + 1] = '\x7f';
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << bad;
+        std::optional<UidIndex> rejected;
+        errno = 0;
+        EXPECT_FALSE(UidFile::loadImage(path, rejected)) << at;
+        EXPECT_EQ(errno, EINVAL) << at;
+        EXPECT_FALSE(rejected);
+    }
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << data;
+    std::optional<UidIndex> image;
+    EXPECT_TRUE(UidFile::loadImage(path, image));
+}
+
+TEST(UidFileTest, MutedSnapshot)
+{
+    const std::string path = tempPath("muted.snap");
+    UidIndex index(UIDS);
+    ASSERT_TRUE(index.mute("CB00000000000000002"));
+    ASSERT_TRUE(index.mute("ZL1"));
+    ASSERT_TRUE(UidFile::saveMuted(path, index));
+
+    UidIndex restored(UIDS);
+    ASSERT_TRUE(UidFile::loadMuted(path, restored));
+    EXPECT_EQ(restored.mutedWords(), index.mutedWords());
+    EXPECT_TRUE(restored.isMuted("ZL1"));
+    EXPECT_FALSE(restored.isMuted("CB00000000000000001"));
+    EXPECT_EQ(restored.match("CB"),
+        std::vector<std::string>{"CB00000000000000001"});
+
+    // not the same population
+    std::vector<std::string> other = UIDS;
+    other[3] = "ZL2";
+    UidIndex foreign(other);
+    errno = 0;
+    EXPECT_FALSE(UidFile::loadMuted(path, foreign));
+    EXPECT_EQ(errno, EINVAL);
+    EXPECT_FALSE(foreign.isMuted("ZL2"));
+}
+
+TEST(UidFileTest, BusCommands)
+{
+    UidBus bus(UIDS);
+    bus.setLog(nullptr);
+    bus.setSnapshotDir(testing::TempDir());
+    std::string reply;
+
+    ASSERT_TRUE(bus.handle("SETADDR:AB12345678901234567", reply));
+    ASSERT_TRUE(bus.handle("@1:SNAPSHOT:uidfile_bus.snap", reply));
+    EXPECT_EQ(reply, "@1:SNAPSHOT:uidfile_bus.snap");
+    EXPECT_TRUE(std::ifstream(tempPath("bus.snap")).good());
+
+    bus.handle("RESETALL", reply);
+    EXPECT_FALSE(bus.index().isMuted("AB12345678901234567"));
+    ASSERT_TRUE(bus.handle("RESTORE:uidfile_bus.snap", reply));
+    EXPECT_EQ(reply, "RESTORE:uidfile_bus.snap");
+    EXPECT_TRUE(bus.index().isMuted("AB12345678901234567"));
+    EXPECT_FALSE(bus.handle("AB7", reply));
+
+    EXPECT_FALSE(bus.handle("RESTORE:uidfile_missing", reply));
+}
+
+TEST(UidFileTest, BusSnapshotsStayInTheirDirectory)
+{
+    UidBus bus(UIDS);
+    bus.setLog(nullptr);
+    std::string reply;
+
+    // no directory, no snapshots
+    errno = 0;
+    EXPECT_FALSE(bus.handle("SNAPSHOT:uidfile_nodir.snap", reply));
+    EXPECT_EQ(errno, EPERM);
+    EXPECT_FALSE(std::ifstream(tempPath("nodir.snap")).good());
+
+    bus.setSnapshotDir(testing::TempDir());
+    for (const char *line : {"SNAPSHOT:", "SNAPSHOT:../uidfile_up.snap",
+             "SNAPSHOT:sub/uidfile.snap", "SNAPSHOT:/tmp/uidfile.snap",
+             "RESTORE:..", "RESTORE:a..b"}) {
+        errno = 0;
+        EXPECT_FALSE(bus.handle(line, reply)) << line;
+        EXPECT_EQ(errno, EINVAL) << line;
+    }
+    EXPECT_TRUE(reply.empty());
+
+    // nor in a session that may not
+    UidBus::Session session;
+    session.snapshots = false;
+    errno = 0;
+    EXPECT_FALSE(bus.handle("SNAPSHOT:uidfile_denied.snap", reply,
+        session));
+    EXPECT_EQ(errno, EPERM);
+    EXPECT_FALSE(std::ifstream(tempPath("denied.snap")).good());
+}
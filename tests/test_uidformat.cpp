@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include <random>
+#include "uidformat.h"
+#include "uidresp.h"
+
+TEST(UidFormatTest, IndexTable)
+{
+    static_assert(AisgUid::LENGTH == 19);
+    static_assert(AisgUid::SYMBOLS == 64);
+    static_assert(AisgUid::index('0') == 0);
+    static_assert(AisgUid::index('_') == 63);
+
+    for (size_t i = 0; i < AisgUid::SYMBOLS; ++i)
+        EXPECT_EQ(AisgUid::index(AisgUid::CHARSET[i]), int(i));
+    for (char c : {'!', ' ', '@', '\0', '\xff'})
+        EXPECT_FALSE(AisgUid::isSymbol(c)) << int(c);
+}
+
+TEST(UidFormatTest, IsUid)
+{
+    EXPECT_TRUE(AisgUid::isUid("CB00000000000000001"));
+    EXPECT_TRUE(AisgUid::isUid("ab-_zZ9000000000000"));
+    EXPECT_FALSE(AisgUid::isUid("CB0000000000000001"));
+    EXPECT_FALSE(AisgUid::isUid("CB000000000000000012"));
+    EXPECT_FALSE(AisgUid::isUid("CB00000000 00000001"));
+    EXPECT_FALSE(AisgUid::isUid("!"));
+}
+
+TEST(UidFormatTest, CheckSymbol)
+{
+    const std::string head = "AB1234567890123456";
+    std::string uid = head + AisgUid::checkSymbol(head);
+    EXPECT_TRUE(AisgUid::isChecked(uid));
+    // only the first LENGTH - 1 characters count
+    EXPECT_EQ(AisgUid::checkSymbol(uid), uid.back());
+    for (size_t i = 0; i < uid.size(); ++i) {
+        std::string bad = uid;
+        bad[i] = bad[i] == '0' ? '1' : '0';
+        EXPECT_FALSE(AisgUid::isChecked(bad)) << i;
+    }
+    EXPECT_FALSE(AisgUid::isChecked(head));
+}
+
+TEST(UidFormatTest, MatchesLikeResponder)
+{
+    const std::string uid = "AB12345678901234567";
+    for (const char *p : {"", "A", "AB", "AX", "AB7", "AB67", "AB8",
+             "AB12345678901234567", "AB123456789012345678"}) {
+        // reference rule, spelled out for a 19 character uid
+        std::string_view s(p);
+        bool expected = !s.empty() && s.size() <= uid.size() &&
+            uid.compare(0, std::min<size_t>(2, s.size()),
+                s.substr(0, 2)) == 0 &&
+            (s.size() <= 2 ||
+                uid.compare(uid.size() - (s.size() - 2), s.size() - 2,
+                    s.substr(2)) == 0);
+        EXPECT_EQ(AisgUid::matches(s, uid), expected) << p;
+        EXPECT_EQ(UidResponder::matches(s, uid), expected) << p;
+    }
+}
+
+TEST(UidFormatTest, MatchesAgreesWithReference)
+{
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<size_t> sym(0, 3); // few symbols: hits
+    std::uniform_int_distribution<size_t> len(0, AisgUid::LENGTH + 1);
+    for (int i = 0; i < 20000; ++i) {
+        std::string uid, p;
+        while (uid.size() < AisgUid::LENGTH)
+            uid.push_back(AisgUid::CHARSET[sym(rng)]);
+        for (size_t n = len(rng); p.size() < n;)
+            p.push_back(AisgUid::CHARSET[sym(rng)]);
+        if (i % 4 == 0 && p.size() > 2)
+            p.replace(2, 1, "[0-1]");
+        ASSERT_EQ(AisgUid::matches(p, uid), UidResponder::matches(p, uid))
+            << p << " " << uid;
+    }
+}
@@ -0,0 +1,244 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include "uidindex.h"
+#include "uidresp.h"
+
+namespace {
+
+// linear scan with the reference matcher
+std::vector<std::string> linearMatch(const std::vector<std::string> &uids,
+    const std::vector<std::string> &muted, const std::string &input)
+{
+    std::vector<std::string> result;
+    for (const auto &uid : uids) {
+        if (std::find(muted.begin(), muted.end(), uid) != muted.end())
+            continue;
+        if (UidResponder::matches(input, uid))
+            result.push_back(uid);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+std::vector<std::string> indexMatch(const UidIndex &index,
+    const std::string &input)
+{
+    std::vector<std::string> result = index.match(input);
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+std::string randomString(std::mt19937 &rng, size_t len)
+{
+    static const char alphabet[] = "ABC01";
+    std::uniform_int_distribution<size_t> dist(0, sizeof(alphabet) - 2);
+    std::string s;
+    for (size_t i = 0; i < len; ++i)
+        s.push_back(alphabet[dist(rng)]);
+    return s;
+}
+
+} // namespace
+
+TEST(UidIndexTest, MatchesLikeReference)
+{
+    std::vector<std::string> uids = {
+        "123456", "12abc56", "1299956", "13", "1", "12", "AB12345678901234567"
+    };
+    UidIndex index(uids);
+
+    for (const char *input : { "1", "12", "13", "1256", "12bc56", "1257",
+             "56", "123456", "1234567", "AB", "AB567", "", "2" })
+        EXPECT_EQ(indexMatch(index, input), linearMatch(uids, {}, input))
+            << "input=" << input;
+}
+
+TEST(UidIndexTest, MuteUnmute)
+{
+    UidIndex index({ "AB123", "AB223", "AB333" });
+
+    EXPECT_EQ(index.match("AB23").size(), 2u);
+    EXPECT_TRUE(index.mute("AB123"));
+    EXPECT_TRUE(index.mute("AB123")); // already muted: still known
+    EXPECT_TRUE(index.isMuted("AB123"));
+    EXPECT_EQ(index.match("AB23"), std::vector<std::string>{ "AB223" });
+
+    EXPECT_FALSE(index.mute("AB999"));
+    EXPECT_FALSE(index.unmute("AB223")); // active
+    EXPECT_TRUE(index.unmute("AB123"));
+    EXPECT_FALSE(index.isMuted("AB123"));
+    EXPECT_EQ(index.match("AB23").size(), 2u);
+
+    index.mute("AB123");
+    index.mute("AB223");
+    index.mute("AB333");
+    EXPECT_TRUE(index.match("AB").empty());
+    index.unmuteAll();
+    EXPECT_EQ(index.match("AB").size(), 3u);
+}
+
+TEST(UidIndexTest, DuplicatesMatchAndMuteTogether)
+{
+    UidIndex index({ "AB123", "AB123" });
+    EXPECT_EQ(index.match("AB3").size(), 2u);
+    index.mute("AB123");
+    EXPECT_TRUE(index.match("AB3").empty());
+}
+
+TEST(UidIndexTest, RandomPopulationAgainstReference)
+{
+    std::mt19937 rng(12345);
+    std::uniform_int_distribution<size_t> len(1, 8);
+
+    std::vector<std::string> uids;
+    for (int i = 0; i < 300; ++i)
+        uids.push_back(randomString(rng, len(rng)));
+    UidIndex index(uids);
+
+    std::vector<std::string> muted;
+    for (int round = 0; round < 2000; ++round) {
+        if (round % 7 == 0) {
+            const std::string &uid = uids[rng() % uids.size()];
+            index.mute(uid);
+            muted.push_back(uid);
+        }
+        if (round % 500 == 499) {
+            index.unmuteAll();
+            muted.clear();
+        }
+        std::string input = randomString(rng, len(rng));
+        ASSERT_EQ(indexMatch(index, input), linearMatch(uids, muted, input))
+            << "input=" << input;
+    }
+}
+
+TEST(UidIndexTest, ClassesAgainstReference)
+{
+    std::mt19937 rng(54321);
+    std::uniform_int_distribution<size_t> len(1, 8);
+    std::vector<std::string> uids;
+    for (int i = 0; i < 300; ++i)
+        uids.push_back(randomString(rng, len(rng)));
+    UidIndex index(uids);
+    std::vector<std::string> muted;
+    for (int i = 0; i < 30; ++i) {
+        muted.push_back(uids[rng() % uids.size()]);
+        index.mute(muted.back());
+    }
+
+    static const char *const classes[] = {"[AB]", "[0-1]", "[A-C0]",
+        "[B1]", "[-A]"};
+    for (int round = 0; round < 2000; ++round) {
+        std::string input;
+        for (size_t i = len(rng); i > 0; --i) {
+            if (rng() % 3 == 0)
+                input += classes[rng() % std::size(classes)];
+            else
+                input += randomString(rng, 1);
+        }
+        ASSERT_EQ(indexMatch(index, input), linearMatch(uids, muted, input))
+            << "input=" << input;
+        ASSERT_EQ(index.countMatches(input).count,
+            linearMatch(uids, muted, input).size()) << "input=" << input;
+    }
+
+    // what the bisecting scan sends: half of the symbols of a level
+    UidIndex aisg({"AB12345678901234567", "AB12345678901234568",
+        "AB1234567890123456x"});
+    EXPECT_EQ(aisg.countMatches("AB[0-9]", 2).count, 2u);
+    EXPECT_EQ(aisg.uid(aisg.countMatches("AB[a-z]", 2).first),
+        "AB1234567890123456x");
+    EXPECT_EQ(aisg.countMatches("AB[A-Z]", 2).count, 0u);
+}
+
+TEST(UidIndexTest, RefinementsAgainstReference)
+{
+    // the way the scan probes: siblings, one level below the last node
+    // that collided, muting what it finds
+    std::mt19937 rng(777);
+    std::vector<std::string> uids;
+    for (int i = 0; i < 400; ++i)
+        uids.push_back((i % 2 ? "AB" : "CB") + randomString(rng, 6));
+    UidIndex index(uids);
+    std::vector<std::string> muted;
+    for (int round = 0; round < 50; ++round) {
+        std::string node = round % 2 ? "AB" : "CB";
+        for (size_t depth = 0; depth < 6; ++depth) {
+            std::string next;
+            for (char c : std::string("ABC01")) {
+                const std::string input = node.substr(0, 2) + c +
+                    node.substr(2);
+                const std::vector<std::string> expected =
+                    linearMatch(uids, muted, input);
+                ASSERT_EQ(indexMatch(index, input), expected)
+                    << "input=" << input;
+                ASSERT_EQ(std::min<size_t>(
+                    index.countMatches(input, 2).count, 2),
+                    std::min<size_t>(expected.size(), 2));
+                if (expected.size() == 1) {
+                    index.mute(expected[0]);
+                    muted.push_back(expected[0]);
+                } else if (expected.size() > 1 && next.empty()) {
+                    next = input;
+                }
+                // the parent again, now with fewer active
+                ASSERT_EQ(indexMatch(index, node),
+                    linearMatch(uids, muted, node)) << "input=" << node;
+            }
+            if (next.empty())
+                break;
+            node = next;
+        }
+        if (round % 10 == 9) {
+            index.unmuteAll();
+            muted.clear();
+        }
+    }
+}
+
+TEST(UidIndexTest, OrdinalsAndWordBoundaries)
+{
+    std::vector<std::string> uids;
+    for (int i = 0; i < 200; ++i)
+        uids.push_back("AB" + std::to_string(1000 + i));
+    UidIndex index(uids);
+
+    std::vector<bool> seen(index.size());
+    for (const auto &uid : uids) {
+        size_t o = 0;
+        ASSERT_TRUE(index.ordinal(uid, o));
+        ASSERT_EQ(index.uid(o), uid);
+        seen[o] = true;
+    }
+    EXPECT_EQ(std::count(seen.begin(), seen.end(), true), 200);
+
+    // mute all but the last one: the scan has to cross muted words
+    for (size_t i = 0; i + 1 < uids.size(); ++i)
+        index.mute(uids[i]);
+    EXPECT_EQ(index.match("AB"), std::vector<std::string>{ uids.back() });
+    index.unmuteAll();
+    EXPECT_EQ(index.match("AB").size(), 200u);
+}
+
+TEST(UidIndexTest, CountMatchesWithLimit)
+{
+    std::vector<std::string> uids;
+    for (int i = 0; i < 200; ++i)
+        uids.push_back("AB" + std::to_string(1000 + i));
+    UidIndex index(uids);
+
+    EXPECT_EQ(index.countMatches("AB").count, 200u);
+    EXPECT_GE(index.countMatches("AB", 2).count, 2u);
+    EXPECT_EQ(index.countMatches("AB1199", 2).count, 1u);
+    EXPECT_EQ(index.uid(index.countMatches("AB1199", 2).first), "AB1199");
+    EXPECT_EQ(index.countMatches("ABX", 2).count, 0u);
+
+    // the only active uid sits behind a run of muted words
+    for (size_t i = 0; i + 1 < uids.size(); ++i)
+        index.mute(uids[i]);
+    BatchMatcher::Result r = index.countMatches("AB", 2);
+    EXPECT_EQ(r.count, 1u);
+    EXPECT_EQ(index.uid(r.first), uids.back());
+}
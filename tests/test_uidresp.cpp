@@ -47,3 +47,75 @@ TEST(UidResponderTest, CollisionWithFilthData)
     EXPECT_NE(result, "123456");
 }
 
+
+TEST(UidResponderTest, CollisionSeededIsReproducible)
+{
+    std::vector<std::string> uids = {
+        "AB12345678901234567",
+        "AB02345678901234567",
+        "AB92345678901234568"
+    };
+
+    std::mt19937 a(42), b(42);
+    std::string ra, rb;
+    for (int i = 0; i < 10; ++i) {
+        UidResponder::generateCollision(uids, a, ra);
+        UidResponder::generateCollision(uids, b, rb);
+        EXPECT_EQ(ra, rb);
+        EXPECT_EQ(ra.size(), 19u);
+    }
+}
+
+TEST(UidResponderTest, CollisionColumnsComeFromUids)
+{
+    std::vector<std::string> uids = { "ABCDEFGH", "abcdefghij" };
+    std::mt19937 rng(7);
+    std::string result = "previous content";
+
+    UidResponder::mixColumns(uids, rng, result);
+    ASSERT_EQ(result.size(), 10u);
+    for (size_t i = 0; i < 8; ++i)
+        EXPECT_TRUE(result[i] == uids[0][i] || result[i] == uids[1][i])
+            << i;
+    // past the shorter UID only the longer one contributes
+    EXPECT_EQ(result.substr(8), "ij");
+    // a shorter length cuts the columns off
+    UidResponder::mixColumns(uids, rng, result, 6);
+    ASSERT_EQ(result.size(), 6u);
+    for (size_t i = 0; i < 6; ++i)
+        EXPECT_TRUE(result[i] == uids[0][i] || result[i] == uids[1][i])
+            << i;
+
+    // generateCollision() keeps the first five columns, then randomizes
+    UidResponder::generateCollision(uids, rng, result);
+    ASSERT_EQ(result.size(), 10u);
+    for (size_t i = 0; i < 5; ++i)
+        EXPECT_TRUE(result[i] == uids[0][i] || result[i] == uids[1][i])
+            << i;
+    UidResponder::generateCollision(uids, rng, result, 6);
+    EXPECT_EQ(result.size(), 6u);
+    UidResponder::generateCollision(uids, rng, result, 3);
+    ASSERT_EQ(result.size(), 3u);
+    for (size_t i = 0; i < 3; ++i)
+        EXPECT_TRUE(result[i] == uids[0][i] || result[i] == uids[1][i])
+            << i;
+}
+
+TEST(UidResponderTest, CountMatchesStopsAtLimit)
+{
+    std::vector<std::string> uids = { "AB1", "AB21", "CD1", "AB31" };
+    size_t first = 99;
+
+    EXPECT_EQ(UidResponder::countMatches("AB1", uids), 3u);
+    EXPECT_EQ(UidResponder::countMatches("AB1", uids, 2, &first), 2u);
+    EXPECT_EQ(first, 0u);
+    EXPECT_EQ(UidResponder::countMatches("CD", uids, 2, &first), 1u);
+    EXPECT_EQ(first, 2u);
+    EXPECT_EQ(UidResponder::countMatches("EF", uids, 2, &first), 0u);
+
+    std::vector<std::string_view> views;
+    UidResponder::collectMatches("AB1", uids, views);
+    ASSERT_EQ(views.size(), 3u);
+    EXPECT_EQ(views[2], "AB31");
+    EXPECT_EQ(views[2].data(), uids[3].data()); // no copies
+}
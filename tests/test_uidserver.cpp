@@ -0,0 +1,255 @@
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include "uidserver.h"
+
+namespace {
+
+const std::vector<std::string> UIDS = {
+    "AB12345678901234567",
+    "AB12345678901234568",
+    "CB00000000000000001",
+};
+
+/**
+ * client end of a socketpair served by `server`
+ */
+int attach(UidServer &server)
+{
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+        return -1;
+    if (!server.adopt(sv[1])) {
+        close(sv[0]);
+        return -1;
+    }
+    return sv[0];
+}
+
+void say(int fd, const std::string &data)
+{
+    ASSERT_EQ(::write(fd, data.data(), data.size()),
+        static_cast<ssize_t>(data.size()));
+}
+
+/**
+ * runs the server until `fd` got `lines` more lines
+ */
+std::string hear(UidServer &server, int fd, size_t lines)
+{
+    std::string got;
+    for (int round = 0; round < 50; ++round) {
+        if (static_cast<size_t>(
+                std::count(got.begin(), got.end(), '\n')) >= lines)
+            break;
+        server.poll(10);
+        struct pollfd pfd = {fd, POLLIN, 0};
+        while (::poll(&pfd, 1, 0) > 0) {
+            char buf[4096];
+            ssize_t n = ::read(fd, buf, sizeof(buf));
+            if (n <= 0)
+                return got;
+            got.append(buf, static_cast<size_t>(n));
+        }
+    }
+    return got;
+}
+
+} // namespace
+
+TEST(UidServerTest, ClientsShareTheBus)
+{
+    UidBus bus(UIDS);
+    bus.setLog(nullptr);
+    UidServer server(bus);
+    int a = attach(server);
+    int b = attach(server);
+    ASSERT_GE(a, 0);
+    ASSERT_GE(b, 0);
+    EXPECT_EQ(server.clients(), 2u);
+
+    say(a, "AB7\n@3:AB8\nAB9\nSYNC:1\n");
+    EXPECT_EQ(hear(server, a, 3),
+        "AB12345678901234567\n@3:AB12345678901234568\nSYNC:1\n");
+
+    // what one client mutes, the other one no longer hears
+    say(b, "SETADDR:AB12345678901234567\n");
+    EXPECT_EQ(hear(server, b, 1), "AB12345678901234567\n");
+    say(a, "AB\nCB"); // unterminated, waits for more
+    EXPECT_EQ(hear(server, a, 1), "AB12345678901234568\n");
+    say(a, "1\n");
+    EXPECT_EQ(hear(server, a, 1), "CB00000000000000001\n");
+
+    close(a);
+    server.poll(10);
+    EXPECT_EQ(server.clients(), 1u);
+    close(b);
+}
+
+TEST(UidServerTest, ModesArePerClient)
+{
+    UidBus bus(UIDS);
+    bus.setLog(nullptr);
+    UidServer server(bus);
+    int a = attach(server);
+    int b = attach(server);
+
+    say(a, "MODE:FASTCOLLISION\nAB\n");
+    EXPECT_EQ(hear(server, a, 2), "MODE:FASTCOLLISION\n\n");
+    say(b, "AB\n");
+    EXPECT_NE(hear(server, b, 1), "\n"); // still the mixed reply
+
+    close(a);
+    close(b);
+}
+
+TEST(UidServerTest, MonitorSeesOtherClients)
+{
+    UidBus bus(UIDS);
+    bus.setLog(nullptr);
+    UidServer server(bus);
+    int scanner = attach(server);
+    int monitor = attach(server);
+
+    say(monitor, "MODE:MONITOR\n");
+    EXPECT_EQ(hear(server, monitor, 1), "MODE:MONITOR\n");
+    say(scanner, "AB9\nAB7\n");
+    EXPECT_EQ(hear(server, scanner, 1), "AB12345678901234567\n");
+    EXPECT_EQ(hear(server, monitor, 3),
+        "1 > AB9\n1 > AB7\n1 < AB12345678901234567\n");
+
+    close(scanner);
+    close(monitor);
+}
+
+TEST(UidServerTest, MonitorThatNeverReads)
+{
+    UidBus bus(UIDS);
+    bus.setLog(nullptr);
+    UidServer server(bus);
+    int scanner = attach(server);
+    int monitor = attach(server);
+    say(monitor, "MODE:MONITOR\n");
+    hear(server, monitor, 1);
+
+    // MONITOR is a pattern like any other, for vendor MO
+    say(scanner, "MONITOR\n");
+    EXPECT_EQ(hear(server, scanner, 1), "");
+
+    // 8 bytes a line for the monitor, some 3 MB in all
+    std::string window;
+    for (int i = 0; i < 10000; ++i)
+        window += "AB9\n";
+    const size_t lines = 40 * 10000;
+    for (int i = 0; i < 40; ++i) {
+        say(scanner, window);
+        server.poll(10);
+        server.poll(10);
+    }
+    EXPECT_EQ(server.clients(), 2u);
+    EXPECT_GT(server.dropped(), 0u);
+
+    // what it reads at last is bounded, and says what it missed
+    std::string seen = hear(server, monitor, SIZE_MAX);
+    const size_t kept = static_cast<size_t>(
+        std::count(seen.begin(), seen.end(), '\n'));
+    EXPECT_LE(seen.size(), 2 * UidServer::OUT_LIMIT);
+    say(scanner, "AB7\n");
+    EXPECT_EQ(hear(server, scanner, 1), "AB12345678901234567\n");
+    EXPECT_EQ(hear(server, monitor, 3),
+        "! " + std::to_string(server.dropped()) + " dropped\n" +
+        "1 > AB7\n1 < AB12345678901234567\n");
+    EXPECT_EQ(kept + server.dropped(), lines + 1); // and MONITOR
+
+    close(scanner);
+    close(monitor);
+}
+
+TEST(UidServerTest, LineTooLong)
+{
+    UidBus bus(UIDS);
+    bus.setLog(nullptr);
+    UidServer server(bus);
+    int a = attach(server);
+    ASSERT_GE(a, 0);
+
+    // the earlier line is answered, the endless one is not kept
+    say(a, "AB7\n" + std::string(UidServer::LINE_LIMIT + 10, 'A'));
+    EXPECT_EQ(hear(server, a, 3),
+        "AB12345678901234567\n! line too long\n");
+    EXPECT_EQ(server.clients(), 0u);
+    close(a);
+}
+
+TEST(UidServerTest, SnapshotsOnlyWhenAllowed)
+{
+    UidBus bus(UIDS);
+    bus.setLog(nullptr);
+    bus.setSnapshotDir(testing::TempDir());
+    UidServer server(bus);
+    int a = attach(server);
+    ASSERT_GE(a, 0);
+    say(a, "SNAPSHOT:uidserver.snap\nSYNC:1\n");
+    EXPECT_EQ(hear(server, a, 1), "SYNC:1\n");
+
+    server.setSnapshots(true);
+    int b = attach(server);
+    ASSERT_GE(b, 0);
+    say(b, "SNAPSHOT:uidserver.snap\n");
+    EXPECT_EQ(hear(server, b, 1), "SNAPSHOT:uidserver.snap\n");
+    close(a);
+    close(b);
+}
+
+TEST(UidServerTest, TakesLinesInTurn)
+{
+    UidBus bus(UIDS);
+    bus.setLog(nullptr);
+    UidServer server(bus);
+    int a = attach(server);
+    int b = attach(server);
+    int monitor = attach(server);
+    say(monitor, "MODE:MONITOR\n");
+    hear(server, monitor, 1);
+
+    // both windows arrive before the server looks at either one
+    say(a, "SYNC:a1\nSYNC:a2\nSYNC:a3\n");
+    say(b, "SYNC:b1\nSYNC:b2\n");
+    std::string seen = hear(server, monitor, 10);
+    std::vector<std::string> order;
+    for (size_t at = 0; (at = seen.find(" > ", at)) != std::string::npos;)
+        order.push_back(seen.substr(at + 3, 7)), at += 3;
+    ASSERT_EQ(order.size(), 5u);
+    // a line of each client in turn, whichever comes first
+    EXPECT_NE(order[0].substr(5, 1), order[1].substr(5, 1));
+    EXPECT_NE(order[2].substr(5, 1), order[3].substr(5, 1));
+    EXPECT_EQ(order[4], "SYNC:a3");
+
+    close(a);
+    close(b);
+    close(monitor);
+}
+
+TEST(UidServerTest, ListensOnUnixSocket)
+{
+    const std::string path = testing::TempDir() + "uidserver.sock";
+    UidBus bus(UIDS);
+    bus.setLog(nullptr);
+    {
+        UidServer server(bus);
+        ASSERT_TRUE(server.listen("unix:" + path));
+        EXPECT_FALSE(server.listen("serial:/dev/null"));
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        struct sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        std::copy(path.begin(), path.end(), addr.sun_path);
+        ASSERT_EQ(connect(fd, reinterpret_cast<struct sockaddr *>(&addr),
+            sizeof(addr)), 0);
+        say(fd, "AB8\n");
+        EXPECT_EQ(hear(server, fd, 1), "AB12345678901234568\n");
+        close(fd);
+    }
+    EXPECT_NE(access(path.c_str(), F_OK), 0); // removed again
+}
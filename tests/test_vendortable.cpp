@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include "vendortable.h"
+
+namespace {
+
+const CollisionProfile::Participants matched = {
+    "AB12345678901234567",
+    "AB02345678901234567"
+};
+
+std::string respond(const VendorTable &table, const std::string &uid,
+    std::mt19937 &rng)
+{
+    std::string out = "stale";
+    table.lookup(uid).respond(matched, rng, out);
+    return out;
+}
+
+} // namespace
+
+TEST(VendorTableTest, DefaultBehaviour)
+{
+    VendorTable table;
+    std::mt19937 rng(1);
+
+    EXPECT_EQ(table.lookup("CB12345678901234567").name, "empty");
+    EXPECT_EQ(table.lookup("AB12345678901234567").name, "mixed");
+    EXPECT_FALSE(table.lookup("CB12345678901234567").needsParticipants);
+    EXPECT_TRUE(table.lookup("AB12345678901234567").needsParticipants);
+    EXPECT_EQ(respond(table, "AB12345678901234567", rng).size(), 19u);
+}
+
+TEST(VendorTableTest, EmptyProfileLeavesRngAlone)
+{
+    VendorTable table;
+    std::mt19937 rng(1), untouched(1);
+
+    EXPECT_EQ(respond(table, "CB12345678901234567", rng), "");
+    EXPECT_EQ(rng, untouched);
+}
+
+TEST(VendorTableTest, ParseAssignments)
+{
+    VendorTable table;
+    std::mt19937 rng(1);
+
+    EXPECT_TRUE(table.parse("AB=truncated:7"));
+    EXPECT_TRUE(table.parse("ZL=padded"));
+    EXPECT_TRUE(table.parse("*=empty"));
+    EXPECT_TRUE(table.parse("CB=mixed"));
+
+    EXPECT_EQ(respond(table, "AB12345678901234567", rng).size(), 7u);
+    EXPECT_EQ(respond(table, "ZL12345678901234567", rng).size(), 20u);
+    EXPECT_EQ(respond(table, "HS12345678901234567", rng), "");
+    EXPECT_EQ(respond(table, "CB12345678901234567", rng).size(), 19u);
+
+    EXPECT_FALSE(table.parse("AB"));
+    EXPECT_FALSE(table.parse("=mixed"));
+    EXPECT_FALSE(table.parse("AB=unknown"));
+    EXPECT_FALSE(table.parse("AB=truncated:x"));
+    EXPECT_FALSE(table.parse("AB=mixed:3"));
+}
+
+TEST(VendorTableTest, PaddedPadsTheMixedString)
+{
+    std::mt19937 rng(7), same(7);
+    std::string mixed, padded;
+    VendorTable::mixed().respond(matched, rng, mixed);
+    VendorTable::padded(3).respond(matched, same, padded);
+
+    EXPECT_EQ(padded, mixed + "000");
+    EXPECT_EQ(rng, same);
+}
+
+TEST(VendorTableTest, WiredOr)
+{
+    VendorTable table;
+    std::mt19937 rng(1), untouched(1);
+    ASSERT_TRUE(table.parse("ZL=or"));
+
+    // '1' | '0' == '1'
+    EXPECT_EQ(respond(table, "ZL12345678901234567", rng),
+        "AB12345678901234567");
+    CollisionProfile::Participants three = {"AB1", "AB2", "AB45"};
+    std::string out;
+    table.lookup("ZL").respond(three, rng, out);
+    EXPECT_EQ(out, "AB75"); // '1' | '2' | '4' == '7'
+    EXPECT_EQ(rng, untouched);
+    EXPECT_FALSE(table.parse("ZL=or:1"));
+}